@@ -0,0 +1,41 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bench.h"
+#include "rbtree.h"
+
+// cold start: build a tree from pre-sorted keys with rbtree_insert vs
+// rbtree_from_sorted_array
+int main(int argc, char *argv[]) {
+  const size_t n = bench_arg(argc, argv, 1, 10000000);
+
+  key_t *arr = malloc(n * sizeof(key_t));
+  for (size_t i = 0; i < n; i++) {
+    arr[i] = (key_t)i;
+  }
+
+  uint64_t start = now_ns();
+  rbtree *t = new_rbtree();
+  for (size_t i = 0; i < n; i++) {
+    rbtree_insert(t, arr[i]);
+  }
+  uint64_t insert_ns = now_ns() - start;
+  delete_rbtree(t);
+
+  start = now_ns();
+  t = rbtree_from_sorted_array(arr, n);
+  uint64_t bulk_ns = now_ns() - start;
+  if (t == NULL) {
+    fprintf(stderr, "bulk load failed\n");
+    return 1;
+  }
+  delete_rbtree(t);
+
+  printf("{\"bench\": \"bulk_load\", \"size\": %zu, \"insert_ns\": %llu, "
+         "\"from_sorted_ns\": %llu, \"ns_per_key\": %.2f}\n",
+         n, (unsigned long long)insert_ns, (unsigned long long)bulk_ns,
+         (double)bulk_ns / n);
+
+  free(arr);
+  return 0;
+}
@@ -0,0 +1,31 @@
+#include "rbtree_compact.h"
+
+#define IMPL_NAME "rbtree_compact"
+typedef rbtree_compact impl_t;
+
+static impl_t *impl_new(void) { return new_rbtree_compact(); }
+static void impl_delete(impl_t *t) { delete_rbtree_compact(t); }
+static void impl_insert(impl_t *t, key_t key) {
+  rbtree_compact_insert(t, key);
+}
+static int impl_find(impl_t *t, key_t key) {
+  return rbtree_compact_find(t, key) != RBTREE_COMPACT_NIL;
+}
+static int impl_erase(impl_t *t, key_t key) {
+  node_idx_t p = rbtree_compact_find(t, key);
+  if (p == RBTREE_COMPACT_NIL) {
+    return 0;
+  }
+  rbtree_compact_erase(t, p);
+  return 1;
+}
+static key_t impl_min(impl_t *t) {
+  return rbtree_compact_key(t, rbtree_compact_min(t));
+}
+static key_t impl_max(impl_t *t) {
+  return rbtree_compact_key(t, rbtree_compact_max(t));
+}
+
+#include "bench-suite.h"
+
+int main(int argc, char *argv[]) { return bench_suite_main(argc, argv); }
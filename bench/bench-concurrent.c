@@ -0,0 +1,102 @@
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bench.h"
+#include "rbtree.h"
+#include "rbtree_concurrent.h"
+
+// 1..64 threads doing 90% finds and 10% insert/erase on one shared tree:
+// every call under one global mutex vs rbtree_concurrent's lock-free readers
+
+typedef struct {
+  rbtree_concurrent *c;  // NULL means the global-mutex baseline
+  rbtree *t;
+  pthread_mutex_t *lock;
+  size_t ops;
+  key_t range;
+  uint64_t seed;
+  size_t hits;
+} worker;
+
+static void *run_worker(void *arg) {
+  worker *w = (worker *)arg;
+  for (size_t i = 0; i < w->ops; i++) {
+    uint64_t r = bench_rand(&w->seed);
+    key_t key = (key_t)((r >> 33) % (uint64_t)w->range);
+    int write = r % 10 == 0;
+    if (w->c != NULL) {
+      if (!write) {
+        w->hits += rbtree_concurrent_find(w->c, key);
+      } else if (rbtree_concurrent_erase(w->c, key) != 0) {
+        rbtree_concurrent_insert(w->c, key);
+      }
+      continue;
+    }
+    pthread_mutex_lock(w->lock);
+    if (!write) {
+      w->hits += rbtree_find(w->t, key) != NULL;
+    } else {
+      node_t *p = rbtree_find(w->t, key);
+      if (p != NULL) {
+        rbtree_erase(w->t, p);
+      } else {
+        rbtree_insert(w->t, key);
+      }
+    }
+    pthread_mutex_unlock(w->lock);
+  }
+  return NULL;
+}
+
+// runs ops operations split across threads and returns the elapsed time
+static uint64_t run(rbtree_concurrent *c, rbtree *t, pthread_mutex_t *lock,
+                    int threads, size_t ops, key_t range) {
+  worker *w = calloc(threads, sizeof(worker));
+  pthread_t *tid = calloc(threads, sizeof(pthread_t));
+  for (int i = 0; i < threads; i++) {
+    w[i] = (worker){c, t, lock, ops / threads, range, 11 + i, 0};
+  }
+  uint64_t start = now_ns();
+  for (int i = 0; i < threads; i++) {
+    pthread_create(&tid[i], NULL, run_worker, &w[i]);
+  }
+  for (int i = 0; i < threads; i++) {
+    pthread_join(tid[i], NULL);
+  }
+  uint64_t ns = now_ns() - start;
+  free(tid);
+  free(w);
+  return ns;
+}
+
+int main(int argc, char *argv[]) {
+  const size_t n = bench_arg(argc, argv, 1, 1000000);
+  const size_t ops = bench_arg(argc, argv, 2, 4000000);
+  const key_t range = (key_t)(2 * n);
+
+  // both trees start with the same n keys out of [0, 2n)
+  rbtree_concurrent *c = new_rbtree_concurrent();
+  rbtree *t = new_rbtree();
+  pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+  uint64_t seed = 7;
+  for (size_t i = 0; i < n; i++) {
+    key_t key = (key_t)((bench_rand(&seed) >> 33) % (uint64_t)range);
+    rbtree_concurrent_insert(c, key);
+    rbtree_insert(t, key);
+  }
+
+  for (int threads = 1; threads <= 64; threads *= 2) {
+    uint64_t mutex_ns = run(NULL, t, &lock, threads, ops, range);
+    uint64_t seqlock_ns = run(c, NULL, NULL, threads, ops, range);
+    printf("{\"bench\": \"concurrent\", \"size\": %zu, \"threads\": %d, "
+           "\"ops\": %zu, \"mutex_ops_per_sec\": %.0f, "
+           "\"seqlock_ops_per_sec\": %.0f, \"speedup\": %.2f}\n",
+           n, threads, ops, ops * 1e9 / mutex_ns, ops * 1e9 / seqlock_ns,
+           (double)mutex_ns / seqlock_ns);
+  }
+
+  delete_rbtree_concurrent(c);
+  delete_rbtree(t);
+  return 0;
+}
@@ -0,0 +1,65 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bench.h"
+#include "rbtree.h"
+#include "rbtree_counted.h"
+
+// n zipf-distributed keys over only `distinct` values: rbtree with one node
+// per copy versus rbtree_counted with one node per distinct key. Reports
+// insert and count() cost and the bytes held in nodes by each
+
+int main(int argc, char *argv[]) {
+  const size_t n = bench_arg(argc, argv, 1, 10000000);
+  const size_t distinct = bench_arg(argc, argv, 2, 1000);
+
+  key_t *keys = malloc(n * sizeof(key_t));
+  zipf_gen z;
+  zipf_init(&z, distinct, 0.99, 47);
+  for (size_t i = 0; i < n; i++) {
+    keys[i] = (key_t)zipf_next(&z);
+  }
+  const size_t queries = 1000000;
+  size_t check = 0;
+
+  uint64_t start = now_ns();
+  rbtree_counted *c = new_rbtree_counted();
+  for (size_t i = 0; i < n; i++) {
+    rbtree_counted_insert(c, keys[i]);
+  }
+  uint64_t counted_insert_ns = now_ns() - start;
+  start = now_ns();
+  for (size_t i = 0; i < queries; i++) {
+    check += rbtree_counted_count(c, keys[i % n]);
+  }
+  uint64_t counted_count_ns = now_ns() - start;
+  const size_t counted_bytes =
+      rbtree_counted_distinct(c) * sizeof(counted_tree_node);
+  delete_rbtree_counted(c);
+
+  start = now_ns();
+  rbtree *t = new_rbtree();
+  for (size_t i = 0; i < n; i++) {
+    rbtree_insert(t, keys[i]);
+  }
+  uint64_t plain_insert_ns = now_ns() - start;
+  start = now_ns();
+  for (size_t i = 0; i < queries; i++) {
+    check -= rbtree_count(t, keys[i % n]);
+  }
+  uint64_t plain_count_ns = now_ns() - start;
+  const size_t plain_bytes = n * sizeof(node_t);
+  delete_rbtree(t);
+
+  printf("{\"bench\": \"counted\", \"size\": %zu, \"distinct\": %zu, "
+         "\"rbtree_insert_ns_per_op\": %.2f, \"counted_insert_ns_per_op\": %.2f, "
+         "\"rbtree_count_ns_per_op\": %.2f, \"counted_count_ns_per_op\": %.2f, "
+         "\"rbtree_node_bytes\": %zu, \"counted_node_bytes\": %zu, "
+         "\"mismatch\": %zu}\n",
+         n, distinct, (double)plain_insert_ns / n, (double)counted_insert_ns / n,
+         (double)plain_count_ns / queries, (double)counted_count_ns / queries,
+         plain_bytes, counted_bytes, check);
+
+  free(keys);
+  return 0;
+}
@@ -0,0 +1,69 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bench.h"
+#include "rbtree.h"
+
+// TTL expiry on a tree of n timestamps: each round drops the oldest 10%
+// and appends as many new timestamps, so the tree stays at n keys.
+// Dropping one key at a time with rbtree_pop_min versus cutting the prefix
+// out with rbtree_truncate_below (one split plus a bulk free)
+
+// builds the tree of timestamps [0, n) and returns it
+static rbtree *build(size_t n) {
+  key_t *keys = malloc(n * sizeof(key_t));
+  for (size_t i = 0; i < n; i++) {
+    keys[i] = (key_t)i;
+  }
+  rbtree *t = rbtree_from_sorted_array(keys, n);
+  free(keys);
+  return t;
+}
+
+// runs the rounds and returns the nanoseconds spent dropping keys
+static uint64_t run(rbtree *t, size_t n, int rounds, int bulk) {
+  const size_t drop = n / 10;
+  key_t oldest = 0, next = (key_t)n;
+  uint64_t drop_ns = 0;
+  for (int r = 0; r < rounds; r++) {
+    uint64_t start = now_ns();
+    if (bulk) {
+      rbtree_truncate_below(t, oldest + (key_t)drop);
+    } else {
+      key_t key;
+      for (size_t i = 0; i < drop; i++) {
+        rbtree_pop_min(t, &key);
+      }
+    }
+    drop_ns += now_ns() - start;
+    oldest += (key_t)drop;
+
+    node_t *last = rbtree_max(t);
+    for (size_t i = 0; i < drop; i++) {
+      last = rbtree_insert_hint(t, last, next++);
+    }
+  }
+  return drop_ns;
+}
+
+int main(int argc, char *argv[]) {
+  const size_t n = bench_arg(argc, argv, 1, 50000000);
+  const int rounds = (int)bench_arg(argc, argv, 2, 5);
+
+  rbtree *t = build(n);
+  uint64_t single_ns = run(t, n, rounds, 0);
+  delete_rbtree(t);
+
+  t = build(n);
+  uint64_t bulk_ns = run(t, n, rounds, 1);
+  delete_rbtree(t);
+
+  const double dropped = (double)(n / 10) * rounds;
+  printf("{\"bench\": \"expire\", \"size\": %zu, \"rounds\": %d, "
+         "\"pop_min_ms_per_round\": %.2f, \"truncate_ms_per_round\": %.2f, "
+         "\"pop_min_ns_per_key\": %.2f, \"truncate_ns_per_key\": %.2f, "
+         "\"peak_rss_kb\": %ld}\n",
+         n, rounds, single_ns / 1e6 / rounds, bulk_ns / 1e6 / rounds,
+         single_ns / dropped, bulk_ns / dropped, peak_rss_kb());
+  return 0;
+}
@@ -0,0 +1,86 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bench.h"
+#include "rbtree.h"
+#include "rbtree_frozen.h"
+
+// groups of 8..64 random lookups: a loop of single finds vs the batched
+// lookups, on both the pointer tree and a frozen snapshot
+int main(int argc, char *argv[]) {
+  const size_t n = bench_arg(argc, argv, 1, 4000000);
+  const size_t ops = bench_arg(argc, argv, 2, 4000000);
+
+  rbtree *t = new_rbtree();
+  uint64_t seed = 5;
+  for (size_t i = 0; i < n; i++) {
+    rbtree_insert(t, (key_t)(bench_rand(&seed) >> 33));
+  }
+  rbtree_frozen *f = rbtree_freeze(t);
+  key_t *probe = malloc(ops * sizeof(key_t));
+  for (size_t i = 0; i < ops; i++) {
+    probe[i] = (key_t)(bench_rand(&seed) >> 33);
+  }
+  node_t **nodes = malloc(64 * sizeof(node_t *));
+  size_t *pos = malloc(64 * sizeof(size_t));
+
+  for (size_t group = 8; group <= 64; group *= 2) {
+    const size_t total = ops / group * group;
+    size_t hits[4] = {0};
+    uint64_t ns[4];
+
+    uint64_t start = now_ns();
+    for (size_t i = 0; i < total; i += group) {
+      for (size_t j = 0; j < group; j++) {
+        hits[0] += rbtree_find(t, probe[i + j]) != NULL;
+      }
+    }
+    ns[0] = now_ns() - start;
+
+    start = now_ns();
+    for (size_t i = 0; i < total; i += group) {
+      rbtree_find_many(t, probe + i, group, nodes);
+      for (size_t j = 0; j < group; j++) {
+        hits[1] += nodes[j] != NULL;
+      }
+    }
+    ns[1] = now_ns() - start;
+
+    start = now_ns();
+    for (size_t i = 0; i < total; i += group) {
+      for (size_t j = 0; j < group; j++) {
+        hits[2] += rbtree_frozen_find(f, probe[i + j]) != 0;
+      }
+    }
+    ns[2] = now_ns() - start;
+
+    start = now_ns();
+    for (size_t i = 0; i < total; i += group) {
+      rbtree_frozen_find_many(f, probe + i, group, pos);
+      for (size_t j = 0; j < group; j++) {
+        hits[3] += pos[j] != 0;
+      }
+    }
+    ns[3] = now_ns() - start;
+
+    if (hits[0] != hits[1] || hits[0] != hits[2] || hits[0] != hits[3]) {
+      fprintf(stderr, "batched lookups disagree with single lookups\n");
+      return 1;
+    }
+    printf("{\"bench\": \"find_many\", \"size\": %zu, \"group\": %zu, "
+           "\"ops\": %zu, \"tree_ns_per_op\": %.2f, "
+           "\"tree_many_ns_per_op\": %.2f, \"frozen_ns_per_op\": %.2f, "
+           "\"frozen_many_ns_per_op\": %.2f, \"tree_speedup\": %.2f, "
+           "\"frozen_speedup\": %.2f}\n",
+           n, group, total, (double)ns[0] / total, (double)ns[1] / total,
+           (double)ns[2] / total, (double)ns[3] / total,
+           (double)ns[0] / ns[1], (double)ns[2] / ns[3]);
+  }
+
+  free(pos);
+  free(nodes);
+  free(probe);
+  delete_rbtree_frozen(f);
+  delete_rbtree(t);
+  return 0;
+}
@@ -0,0 +1,54 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bench.h"
+#include "rbtree.h"
+#include "rbtree_frozen.h"
+
+// random lookups on the mutable tree vs a frozen Eytzinger snapshot
+int main(int argc, char *argv[]) {
+  const size_t n = bench_arg(argc, argv, 1, 10000000);
+  const size_t ops = bench_arg(argc, argv, 2, 10000000);
+
+  rbtree *t = new_rbtree();
+  uint64_t seed = 3;
+  for (size_t i = 0; i < n; i++) {
+    rbtree_insert(t, (key_t)(bench_rand(&seed) >> 33));
+  }
+  key_t *probe = malloc(ops * sizeof(key_t));
+  for (size_t i = 0; i < ops; i++) {
+    probe[i] = (key_t)(bench_rand(&seed) >> 33);
+  }
+
+  uint64_t start = now_ns();
+  rbtree_frozen *f = rbtree_freeze(t);
+  uint64_t freeze_ns = now_ns() - start;
+
+  size_t hits_tree = 0, hits_frozen = 0;
+  start = now_ns();
+  for (size_t i = 0; i < ops; i++) {
+    hits_tree += rbtree_find(t, probe[i]) != NULL;
+  }
+  uint64_t tree_ns = now_ns() - start;
+
+  start = now_ns();
+  for (size_t i = 0; i < ops; i++) {
+    hits_frozen += rbtree_frozen_find(f, probe[i]) != 0;
+  }
+  uint64_t frozen_ns = now_ns() - start;
+
+  if (hits_tree != hits_frozen) {
+    fprintf(stderr, "frozen lookups disagree with the tree\n");
+    return 1;
+  }
+  printf("{\"bench\": \"frozen_find\", \"size\": %zu, \"ops\": %zu, "
+         "\"freeze_ns\": %llu, \"tree_ns_per_op\": %.2f, "
+         "\"frozen_ns_per_op\": %.2f, \"speedup\": %.2f}\n",
+         n, ops, (unsigned long long)freeze_ns, (double)tree_ns / ops,
+         (double)frozen_ns / ops, (double)tree_ns / frozen_ns);
+
+  free(probe);
+  delete_rbtree_frozen(f);
+  delete_rbtree(t);
+  return 0;
+}
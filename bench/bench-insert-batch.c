@@ -0,0 +1,78 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bench.h"
+#include "rbtree.h"
+
+static int key_cmp(const void *p1, const void *p2) {
+  const key_t a = *(const key_t *)p1;
+  const key_t b = *(const key_t *)p2;
+  return (a > b) - (a < b);
+}
+
+// insert a sorted batch into a tree that already holds `base` random keys,
+// once with a loop over rbtree_insert and once with rbtree_insert_batch
+static void run(const char *name, size_t base, key_t *batch, size_t n) {
+  uint64_t seed = 7;
+  rbtree *a = new_rbtree();
+  rbtree *b = new_rbtree();
+  for (size_t i = 0; i < base; i++) {
+    key_t key = (key_t)(bench_rand(&seed) >> 33);
+    rbtree_insert(a, key);
+    rbtree_insert(b, key);
+  }
+
+  uint64_t start = now_ns();
+  for (size_t i = 0; i < n; i++) {
+    rbtree_insert(a, batch[i]);
+  }
+  uint64_t loop_ns = now_ns() - start;
+
+  start = now_ns();
+  if (rbtree_insert_batch(b, batch, n) != 0) {
+    fprintf(stderr, "batch insert failed\n");
+    exit(1);
+  }
+  uint64_t batch_ns = now_ns() - start;
+
+  printf("{\"bench\": \"insert_batch\", \"batch\": \"%s\", \"base\": %zu, "
+         "\"size\": %zu, \"loop_ns\": %llu, \"batch_ns\": %llu, "
+         "\"speedup\": %.2f}\n",
+         name, base, n, (unsigned long long)loop_ns,
+         (unsigned long long)batch_ns, (double)loop_ns / batch_ns);
+
+  delete_rbtree(a);
+  delete_rbtree(b);
+}
+
+int main(int argc, char *argv[]) {
+  const size_t n = bench_arg(argc, argv, 1, 1000000);
+  const size_t base = bench_arg(argc, argv, 2, 1000000);
+
+  // an empty tree, a small one, and the large existing tree from the command line
+  const size_t bases[] = {0, 1000, base};
+  const size_t nbases = sizeof(bases) / sizeof(bases[0]);
+
+  key_t *batch = malloc(n * sizeof(key_t));
+  uint64_t seed = 99;
+
+  // a dense run of increasing ids appended after the existing keys
+  for (size_t i = 0; i < n; i++) {
+    batch[i] = (key_t)(0x7fff0000 - n + i);
+  }
+  for (size_t i = 0; i < nbases; i++) {
+    run("sequential", bases[i], batch, n);
+  }
+
+  // random keys sorted by the caller
+  for (size_t i = 0; i < n; i++) {
+    batch[i] = (key_t)(bench_rand(&seed) >> 33);
+  }
+  qsort(batch, n, sizeof(key_t), key_cmp);
+  for (size_t i = 0; i < nbases; i++) {
+    run("sorted_random", bases[i], batch, n);
+  }
+
+  free(batch);
+  return 0;
+}
@@ -0,0 +1,55 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bench.h"
+#include "rbtree.h"
+
+// appending timestamps one at a time: rbtree_insert descending from the
+// root every time versus rbtree_insert_hint with the previously inserted
+// node as the hint. "jittered" delivers 1 in 20 timestamps late, so those
+// miss the hint and take the normal descent
+static void run(const char *name, const key_t *keys, size_t n) {
+  rbtree *a = new_rbtree();
+  uint64_t start = now_ns();
+  for (size_t i = 0; i < n; i++) {
+    rbtree_insert(a, keys[i]);
+  }
+  uint64_t plain_ns = now_ns() - start;
+
+  rbtree *b = new_rbtree();
+  node_t *last = NULL;
+  start = now_ns();
+  for (size_t i = 0; i < n; i++) {
+    last = rbtree_insert_hint(b, last, keys[i]);
+  }
+  uint64_t hint_ns = now_ns() - start;
+
+  printf("{\"bench\": \"insert_hint\", \"keys\": \"%s\", \"size\": %zu, "
+         "\"insert_ns_per_op\": %.2f, \"hint_ns_per_op\": %.2f, "
+         "\"speedup\": %.2f}\n",
+         name, n, (double)plain_ns / n, (double)hint_ns / n,
+         (double)plain_ns / hint_ns);
+
+  delete_rbtree(a);
+  delete_rbtree(b);
+}
+
+int main(int argc, char *argv[]) {
+  const size_t n = bench_arg(argc, argv, 1, 1000000);
+
+  key_t *keys = calloc(n, sizeof(key_t));
+  uint64_t seed = 43;
+  for (size_t i = 0; i < n; i++) {
+    keys[i] = (key_t)(i * 3);
+  }
+  run("sequential", keys, n);
+
+  for (size_t i = 0; i < n; i++) {
+    uint64_t r = bench_rand(&seed);
+    keys[i] = (key_t)(i * 3) - (r % 20 == 0 ? (key_t)(r >> 40) % 3000 : 0);
+  }
+  run("jittered", keys, n);
+
+  free(keys);
+  return 0;
+}
@@ -0,0 +1,62 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bench.h"
+#include "rbtree.h"
+#include "rbtree_compact.h"
+
+// restart cost: rebuilding a tree by inserting every key versus opening a
+// saved file with mmap (header check only, and with the full checksum),
+// then random finds straight from the mapping
+int main(int argc, char *argv[]) {
+  const size_t n = bench_arg(argc, argv, 1, 1000000);
+  const char *path = argc > 2 ? argv[2] : "bench-mmap.bin";
+
+  key_t *keys = malloc(n * sizeof(key_t));
+  uint64_t seed = 23;
+  for (size_t i = 0; i < n; i++) {
+    keys[i] = (key_t)(bench_rand(&seed) >> 33);
+  }
+
+  uint64_t start = now_ns();
+  rbtree *t = new_rbtree();
+  for (size_t i = 0; i < n; i++) {
+    rbtree_insert(t, keys[i]);
+  }
+  uint64_t rebuild_ns = now_ns() - start;
+
+  start = now_ns();
+  if (rbtree_save(t, path) != 0) {
+    fprintf(stderr, "cannot write %s\n", path);
+    return 1;
+  }
+  uint64_t save_ns = now_ns() - start;
+  delete_rbtree(t);
+
+  start = now_ns();
+  rbtree_compact *m = rbtree_compact_open_mmap(path, 1);
+  uint64_t verify_ns = now_ns() - start;
+  delete_rbtree_compact(m);
+
+  start = now_ns();
+  m = rbtree_compact_open_mmap(path, 0);
+  uint64_t open_ns = now_ns() - start;
+
+  size_t found = 0;
+  start = now_ns();
+  for (size_t i = 0; i < n; i++) {
+    found += rbtree_compact_find(m, keys[(i * 7919) % n]) != RBTREE_COMPACT_NIL;
+  }
+  uint64_t find_ns = now_ns() - start;
+  delete_rbtree_compact(m);
+  remove(path);
+
+  printf("{\"bench\": \"mmap\", \"size\": %zu, \"rebuild_ms\": %.2f, "
+         "\"save_ms\": %.2f, \"open_ms\": %.3f, \"open_verify_ms\": %.2f, "
+         "\"mapped_find_ns_per_op\": %.2f, \"found\": %zu}\n",
+         n, rebuild_ns / 1e6, save_ns / 1e6, open_ns / 1e6, verify_ns / 1e6,
+         (double)find_ns / n, found);
+
+  free(keys);
+  return 0;
+}
@@ -0,0 +1,63 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bench.h"
+#include "rbtree.h"
+#include "rbtree_persistent.h"
+
+// random inserts then erases: the pointer tree, the persistent tree with no
+// snapshots (updates in place), and the persistent tree with a snapshot
+// taken before every update (full path copying)
+static uint64_t run_persistent(const key_t *keys, size_t n, int snapshot_every_op) {
+  rbtree_persistent *t = new_rbtree_persistent();
+  rbtree_snapshot s = {NULL, 0};
+  uint64_t start = now_ns();
+  for (size_t i = 0; i < 2 * n; i++) {
+    if (snapshot_every_op) {
+      rbtree_snapshot_release(&s);
+      rbtree_persistent_snapshot(t, &s);
+    }
+    if (i < n) {
+      rbtree_persistent_insert(t, keys[i]);
+    } else {
+      rbtree_persistent_erase(t, keys[i - n]);
+    }
+  }
+  uint64_t ns = now_ns() - start;
+  rbtree_snapshot_release(&s);
+  delete_rbtree_persistent(t);
+  return ns;
+}
+
+int main(int argc, char *argv[]) {
+  const size_t n = bench_arg(argc, argv, 1, 1000000);
+
+  key_t *keys = malloc(n * sizeof(key_t));
+  uint64_t seed = 17;
+  for (size_t i = 0; i < n; i++) {
+    keys[i] = (key_t)(bench_rand(&seed) >> 33);
+  }
+
+  rbtree *t = new_rbtree();
+  uint64_t start = now_ns();
+  for (size_t i = 0; i < n; i++) {
+    rbtree_insert(t, keys[i]);
+  }
+  for (size_t i = 0; i < n; i++) {
+    rbtree_erase(t, rbtree_find(t, keys[i]));
+  }
+  uint64_t tree_ns = now_ns() - start;
+  delete_rbtree(t);
+
+  uint64_t inplace_ns = run_persistent(keys, n, 0);
+  uint64_t copying_ns = run_persistent(keys, n, 1);
+
+  printf("{\"bench\": \"persistent\", \"size\": %zu, \"ops\": %zu, "
+         "\"tree_ns_per_op\": %.2f, \"persistent_ns_per_op\": %.2f, "
+         "\"persistent_snapshot_every_op_ns_per_op\": %.2f}\n",
+         n, 2 * n, (double)tree_ns / (2 * n), (double)inplace_ns / (2 * n),
+         (double)copying_ns / (2 * n));
+
+  free(keys);
+  return 0;
+}
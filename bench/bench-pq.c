@@ -0,0 +1,116 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bench.h"
+#include "rbtree.h"
+
+// hold model of a scheduler queue: n pending deadlines, then repeatedly
+// take the earliest and push a later one. rbtree_pop_min with the cached
+// leftmost node versus walking the left spine from the root before every
+// erase (what rbtree_min used to do) versus an array binary heap
+
+typedef struct {
+  key_t *a;
+  size_t n;
+} heap;
+
+static void heap_push(heap *h, key_t key) {
+  size_t i = h->n++;
+  while (i > 0 && key < h->a[(i - 1) / 2]) {
+    h->a[i] = h->a[(i - 1) / 2];
+    i = (i - 1) / 2;
+  }
+  h->a[i] = key;
+}
+
+static key_t heap_pop(heap *h) {
+  key_t top = h->a[0];
+  key_t last = h->a[--h->n];
+  size_t i = 0;
+  for (;;) {
+    size_t c = 2 * i + 1;
+    if (c >= h->n) {
+      break;
+    }
+    if (c + 1 < h->n && h->a[c + 1] < h->a[c]) {
+      c++;
+    }
+    if (!(h->a[c] < last)) {
+      break;
+    }
+    h->a[i] = h->a[c];
+    i = c;
+  }
+  h->a[i] = last;
+  return top;
+}
+
+// the next deadline: the popped one plus a random delay
+static key_t next_deadline(key_t now, uint64_t *seed) {
+  return now + (key_t)(bench_rand(seed) % 1000);
+}
+
+int main(int argc, char *argv[]) {
+  const size_t n = bench_arg(argc, argv, 1, 100000);
+  const size_t ops = bench_arg(argc, argv, 2, 2000000);
+
+  key_t *init = malloc(n * sizeof(key_t));
+  uint64_t seed = 37;
+  for (size_t i = 0; i < n; i++) {
+    init[i] = (key_t)(bench_rand(&seed) % 1000000);
+  }
+  uint64_t check[3] = {0, 0, 0};
+
+  rbtree *t = new_rbtree();
+  rbtree_insert_batch(t, init, n);
+  seed = 41;
+  uint64_t start = now_ns();
+  for (size_t i = 0; i < ops; i++) {
+    key_t key;
+    rbtree_pop_min(t, &key);
+    check[0] += key;
+    rbtree_insert(t, next_deadline(key, &seed));
+  }
+  uint64_t pop_ns = now_ns() - start;
+  delete_rbtree(t);
+
+  t = new_rbtree();
+  rbtree_insert_batch(t, init, n);
+  seed = 41;
+  start = now_ns();
+  for (size_t i = 0; i < ops; i++) {
+    node_t *p = t->root;
+    while (p->left != t->nil) {
+      p = p->left;
+    }
+    key_t key = p->key;
+    rbtree_erase(t, p);
+    check[1] += key;
+    rbtree_insert(t, next_deadline(key, &seed));
+  }
+  uint64_t walk_ns = now_ns() - start;
+  delete_rbtree(t);
+
+  heap h = {malloc(n * sizeof(key_t)), 0};
+  for (size_t i = 0; i < n; i++) {
+    heap_push(&h, init[i]);
+  }
+  seed = 41;
+  start = now_ns();
+  for (size_t i = 0; i < ops; i++) {
+    key_t key = heap_pop(&h);
+    check[2] += key;
+    heap_push(&h, next_deadline(key, &seed));
+  }
+  uint64_t heap_ns = now_ns() - start;
+  free(h.a);
+
+  printf("{\"bench\": \"pq\", \"size\": %zu, \"ops\": %zu, "
+         "\"pop_min_ns_per_op\": %.2f, \"walk_erase_ns_per_op\": %.2f, "
+         "\"binary_heap_ns_per_op\": %.2f, \"same_order\": %d}\n",
+         n, ops, (double)pop_ns / ops, (double)walk_ns / ops,
+         (double)heap_ns / ops, check[0] == check[1] && check[1] == check[2]);
+
+  free(init);
+  return 0;
+}
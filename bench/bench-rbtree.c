@@ -0,0 +1,25 @@
+#include "rbtree.h"
+
+#define IMPL_NAME "rbtree"
+typedef rbtree impl_t;
+
+static impl_t *impl_new(void) { return new_rbtree(); }
+static void impl_delete(impl_t *t) { delete_rbtree(t); }
+static void impl_insert(impl_t *t, key_t key) { rbtree_insert(t, key); }
+static int impl_find(impl_t *t, key_t key) {
+  return rbtree_find(t, key) != NULL;
+}
+static int impl_erase(impl_t *t, key_t key) {
+  node_t *p = rbtree_find(t, key);
+  if (p == NULL) {
+    return 0;
+  }
+  rbtree_erase(t, p);
+  return 1;
+}
+static key_t impl_min(impl_t *t) { return rbtree_min(t)->key; }
+static key_t impl_max(impl_t *t) { return rbtree_max(t)->key; }
+
+#include "bench-suite.h"
+
+int main(int argc, char *argv[]) { return bench_suite_main(argc, argv); }
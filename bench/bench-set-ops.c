@@ -0,0 +1,73 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bench.h"
+#include "rbtree.h"
+
+// a base tree of n keys and a delta tree of m keys in the same pool
+static void build(node_pool_t *pool, const key_t *keys, size_t n, size_t m,
+                  rbtree **base, rbtree **delta) {
+  *base = new_rbtree_with_allocator(pool);
+  *delta = new_rbtree_with_allocator(pool);
+  rbtree_insert_batch(*base, keys, n);
+  rbtree_insert_batch(*delta, keys + n, m);
+}
+
+// merging a delta tree into a base tree and removing the delta again:
+// one key at a time through insert/erase versus rbtree_union and
+// rbtree_difference, plus split/join round trips at random keys
+int main(int argc, char *argv[]) {
+  const size_t n = bench_arg(argc, argv, 1, 1000000);
+  const size_t m = bench_arg(argc, argv, 2, 10000);
+
+  key_t *keys = malloc((n + m) * sizeof(key_t));
+  uint64_t seed = 19;
+  for (size_t i = 0; i < n + m; i++) {
+    keys[i] = (key_t)(bench_rand(&seed) >> 33);
+  }
+  node_pool_t *pool = new_node_pool(0);
+  rbtree *base, *delta;
+
+  build(pool, keys, n, m, &base, &delta);
+  uint64_t start = now_ns();
+  for (size_t i = n; i < n + m; i++) {
+    rbtree_insert(base, keys[i]);
+  }
+  for (size_t i = n; i < n + m; i++) {
+    rbtree_erase(base, rbtree_find(base, keys[i]));
+  }
+  uint64_t single_ns = now_ns() - start;
+  delete_rbtree(delta);
+  delete_rbtree(base);
+
+  build(pool, keys, n, m, &base, &delta);
+  rbtree *removed = new_rbtree_with_allocator(pool);
+  rbtree_insert_batch(removed, keys + n, m);
+  start = now_ns();
+  rbtree_union(base, delta);
+  rbtree_difference(base, removed);
+  uint64_t bulk_ns = now_ns() - start;
+  delete_rbtree(removed);
+
+  const size_t rounds = 100000;
+  start = now_ns();
+  for (size_t i = 0; i < rounds; i++) {
+    rbtree *lo, *hi;
+    const key_t key = (key_t)(bench_rand(&seed) >> 33);
+    rbtree_split(base, key, &lo, &hi);
+    rbtree_join(lo, key, hi);
+    rbtree_erase(lo, rbtree_find(lo, key));
+  }
+  uint64_t split_ns = now_ns() - start;
+  delete_rbtree(base);
+
+  printf("{\"bench\": \"set-ops\", \"size\": %zu, \"delta\": %zu, "
+         "\"insert_erase_each_ns\": %llu, \"union_difference_ns\": %llu, "
+         "\"split_join_ns_per_op\": %.2f}\n",
+         n, m, (unsigned long long)single_ns, (unsigned long long)bulk_ns,
+         (double)split_ns / rounds);
+
+  delete_node_pool(pool);
+  free(keys);
+  return 0;
+}
@@ -0,0 +1,77 @@
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bench.h"
+#include "rbtree.h"
+#include "rbtree_sharded.h"
+
+// 1..16 threads inserting random keys: one tree under a global mutex vs a
+// 16-way range-sharded tree, each starting empty
+
+#define SHARDS 16
+
+typedef struct {
+  rbtree_sharded *s;  // NULL means the global-mutex baseline
+  rbtree *t;
+  pthread_mutex_t *lock;
+  size_t ops;
+  uint64_t seed;
+} worker;
+
+static void *run_worker(void *arg) {
+  worker *w = (worker *)arg;
+  for (size_t i = 0; i < w->ops; i++) {
+    key_t key = (key_t)(bench_rand(&w->seed) >> 33);
+    if (w->s != NULL) {
+      rbtree_sharded_insert(w->s, key);
+      continue;
+    }
+    pthread_mutex_lock(w->lock);
+    rbtree_insert(w->t, key);
+    pthread_mutex_unlock(w->lock);
+  }
+  return NULL;
+}
+
+// runs ops inserts split across threads and returns the elapsed time
+static uint64_t run(rbtree_sharded *s, rbtree *t, int threads, size_t ops) {
+  pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+  worker *w = calloc(threads, sizeof(worker));
+  pthread_t *tid = calloc(threads, sizeof(pthread_t));
+  for (int i = 0; i < threads; i++) {
+    w[i] = (worker){s, t, &lock, ops / threads, 13 + i};
+  }
+  uint64_t start = now_ns();
+  for (int i = 0; i < threads; i++) {
+    pthread_create(&tid[i], NULL, run_worker, &w[i]);
+  }
+  for (int i = 0; i < threads; i++) {
+    pthread_join(tid[i], NULL);
+  }
+  uint64_t ns = now_ns() - start;
+  free(tid);
+  free(w);
+  return ns;
+}
+
+int main(int argc, char *argv[]) {
+  const size_t ops = bench_arg(argc, argv, 1, 4000000);
+
+  for (int threads = 1; threads <= 16; threads *= 2) {
+    rbtree *t = new_rbtree();
+    uint64_t mutex_ns = run(NULL, t, threads, ops);
+    delete_rbtree(t);
+
+    rbtree_sharded *s = new_rbtree_sharded(SHARDS, 0, 1 << 30);
+    uint64_t sharded_ns = run(s, NULL, threads, ops);
+    delete_rbtree_sharded(s);
+
+    printf("{\"bench\": \"sharded_insert\", \"shards\": %d, \"threads\": %d, "
+           "\"ops\": %zu, \"mutex_ops_per_sec\": %.0f, "
+           "\"sharded_ops_per_sec\": %.0f, \"speedup\": %.2f}\n",
+           SHARDS, threads, ops, ops * 1e9 / mutex_ns,
+           ops * 1e9 / sharded_ns, (double)mutex_ns / sharded_ns);
+  }
+  return 0;
+}
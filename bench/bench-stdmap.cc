@@ -0,0 +1,29 @@
+#include <set>
+
+extern "C" {
+#include "rbtree.h"
+}
+
+// std::multiset is the standard library's red-black tree with the same
+// multiset semantics as rbtree
+#define IMPL_NAME "std::multiset"
+typedef std::multiset<key_t> impl_t;
+
+static impl_t *impl_new(void) { return new impl_t(); }
+static void impl_delete(impl_t *t) { delete t; }
+static void impl_insert(impl_t *t, key_t key) { t->insert(key); }
+static int impl_find(impl_t *t, key_t key) { return t->find(key) != t->end(); }
+static int impl_erase(impl_t *t, key_t key) {
+  impl_t::iterator it = t->find(key);
+  if (it == t->end()) {
+    return 0;
+  }
+  t->erase(it);
+  return 1;
+}
+static key_t impl_min(impl_t *t) { return *t->begin(); }
+static key_t impl_max(impl_t *t) { return *t->rbegin(); }
+
+#include "bench-suite.h"
+
+int main(int argc, char *argv[]) { return bench_suite_main(argc, argv); }
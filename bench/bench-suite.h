@@ -0,0 +1,172 @@
+#ifndef _BENCH_SUITE_H_
+#define _BENCH_SUITE_H_
+
+// Workloads shared by every implementation in the suite. The including file
+// provides IMPL_NAME, impl_t and the impl_* operations below, then calls
+// bench_suite_main().
+//
+//   impl_t *impl_new(void);
+//   void impl_delete(impl_t *);
+//   void impl_insert(impl_t *, key_t);
+//   int impl_find(impl_t *, key_t);      // nonzero if found
+//   int impl_erase(impl_t *, key_t);     // erase one copy, nonzero if found
+//   key_t impl_min(impl_t *);
+//   key_t impl_max(impl_t *);
+
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "bench.h"
+
+#define BENCH_MAX_SAMPLES 100000
+
+enum { DIST_RANDOM, DIST_SEQUENTIAL, DIST_ZIPF, DIST_COUNT };
+static const char *dist_names[DIST_COUNT] = {"random", "sequential", "zipf"};
+
+// n keys for a distribution; zipf draws ranks over n distinct keys and
+// scatters them so that the popular keys are not adjacent
+static key_t *make_keys(int dist, size_t n, uint64_t seed) {
+  key_t *keys = (key_t *)malloc(n * sizeof(key_t));
+  uint64_t state = seed;
+  zipf_gen z = {0};
+  if (dist == DIST_ZIPF) {
+    zipf_init(&z, n, 0.99, seed);
+  }
+  for (size_t i = 0; i < n; i++) {
+    switch (dist) {
+      case DIST_RANDOM:
+        keys[i] = (key_t)(bench_rand(&state) >> 33);
+        break;
+      case DIST_SEQUENTIAL:
+        keys[i] = (key_t)i;
+        break;
+      default:
+        keys[i] = (key_t)((zipf_next(&z) * 2654435761u) & 0x7fffffff);
+        break;
+    }
+  }
+  return keys;
+}
+
+// insert, find, min/max and erase over one key distribution
+static void run_basic(size_t size, int dist) {
+  const char *name = dist_names[dist];
+  key_t *keys = make_keys(dist, size, 17 + dist);
+  key_t *probe = make_keys(dist, size, 91 + dist);
+  impl_t *t = impl_new();
+  bench_lat lat;
+  uint64_t start;
+  volatile long sink = 0;
+
+  lat_init(&lat, size, BENCH_MAX_SAMPLES);
+  start = now_ns();
+  for (size_t i = 0; i < size; i++) {
+    BENCH_OP(&lat, i, impl_insert(t, keys[i]));
+  }
+  bench_report(IMPL_NAME, "insert", name, size, size, now_ns() - start, &lat);
+
+  lat_init(&lat, size, BENCH_MAX_SAMPLES);
+  start = now_ns();
+  for (size_t i = 0; i < size; i++) {
+    BENCH_OP(&lat, i, sink += impl_find(t, probe[i]));
+  }
+  bench_report(IMPL_NAME, "find", name, size, size, now_ns() - start, &lat);
+
+  lat_init(&lat, size, BENCH_MAX_SAMPLES);
+  start = now_ns();
+  for (size_t i = 0; i < size; i++) {
+    BENCH_OP(&lat, i, sink += (i & 1) ? impl_max(t) : impl_min(t));
+  }
+  bench_report(IMPL_NAME, "minmax", name, size, size, now_ns() - start, &lat);
+
+  // erase in a different order than insertion
+  for (size_t i = size; i > 1; i--) {
+    uint64_t state = i;
+    size_t j = bench_rand(&state) % i;
+    key_t tmp = keys[i - 1];
+    keys[i - 1] = keys[j];
+    keys[j] = tmp;
+  }
+  lat_init(&lat, size, BENCH_MAX_SAMPLES);
+  start = now_ns();
+  for (size_t i = 0; i < size; i++) {
+    BENCH_OP(&lat, i, sink += impl_erase(t, keys[i]));
+  }
+  bench_report(IMPL_NAME, "erase", name, size, size, now_ns() - start, &lat);
+
+  impl_delete(t);
+  free(probe);
+  free(keys);
+}
+
+// reads mixed with writes at a fixed percentage; each write erases a live
+// key and inserts a fresh one so the size stays constant
+static void run_mixed(size_t size, int read_pct) {
+  key_t *keys = make_keys(DIST_RANDOM, size, 5);
+  impl_t *t = impl_new();
+  for (size_t i = 0; i < size; i++) {
+    impl_insert(t, keys[i]);
+  }
+
+  char name[32];
+  snprintf(name, sizeof(name), "mixed_%d_%d", read_pct, 100 - read_pct);
+  const size_t ops = size;
+  uint64_t state = 77;
+  volatile long sink = 0;
+  bench_lat lat;
+  lat_init(&lat, ops, BENCH_MAX_SAMPLES);
+  uint64_t start = now_ns();
+  for (size_t i = 0; i < ops; i++) {
+    uint64_t r = bench_rand(&state);
+    size_t slot = (size_t)((r >> 8) % size);
+    if ((int)(r % 100) < read_pct) {
+      BENCH_OP(&lat, i, sink += impl_find(t, keys[slot]));
+    } else {
+      key_t fresh = (key_t)(r >> 33);
+      BENCH_OP(&lat, i, {
+        impl_erase(t, keys[slot]);
+        impl_insert(t, fresh);
+      });
+      keys[slot] = fresh;
+    }
+  }
+  bench_report(IMPL_NAME, name, "random", size, ops, now_ns() - start, &lat);
+
+  impl_delete(t);
+  free(keys);
+}
+
+static void run_size(size_t size) {
+  for (int dist = 0; dist < DIST_COUNT; dist++) {
+    run_basic(size, dist);
+  }
+  run_mixed(size, 90);
+  run_mixed(size, 50);
+}
+
+// usage: ./bench-xxx [size ...]; each size runs in its own process so that
+// peak_rss_kb belongs to that size alone
+static int bench_suite_main(int argc, char *argv[]) {
+  static const size_t defaults[] = {1000, 10000, 100000, 1000000};
+  const size_t nsizes = argc > 1 ? (size_t)argc - 1 : 4;
+
+  for (size_t i = 0; i < nsizes; i++) {
+    size_t size = argc > 1 ? (size_t)strtoull(argv[i + 1], NULL, 10)
+                           : defaults[i];
+    pid_t pid = fork();
+    if (pid == 0) {
+      run_size(size);
+      exit(0);
+    }
+    int status;
+    waitpid(pid, &status, 0);
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+      fprintf(stderr, "%s: size %zu failed\n", IMPL_NAME, size);
+      return 1;
+    }
+  }
+  return 0;
+}
+
+#endif  // _BENCH_SUITE_H_
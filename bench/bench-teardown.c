@@ -0,0 +1,59 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bench.h"
+#include "rbtree.h"
+
+// the previous teardown: recurse into both subtrees, then release the node
+// (here onto a local free list, which is what the pool does)
+static void legacy_free(node_t *node, node_t *nil, node_t **free_list) {
+  if (node == nil) {
+    return;
+  }
+  legacy_free(node->left, nil, free_list);
+  legacy_free(node->right, nil, free_list);
+  node->right = *free_list;
+  *free_list = node;
+}
+
+static rbtree *build(size_t n, node_pool_t *pool) {
+  rbtree *t = new_rbtree_with_allocator(pool);
+  uint64_t seed = 1234;
+  for (size_t i = 0; i < n; i++) {
+    rbtree_insert(t, (key_t)(bench_rand(&seed) >> 33));
+  }
+  return t;
+}
+
+int main(int argc, char *argv[]) {
+  const size_t n = bench_arg(argc, argv, 1, 10000000);
+
+  // recursive walk over a tree with the same insertion history
+  rbtree *t = build(n, NULL);
+  node_t *free_list = NULL;
+  uint64_t start = now_ns();
+  legacy_free(t->root, t->nil, &free_list);
+  uint64_t legacy_ns = now_ns() - start;
+  t->root = t->nil;
+  delete_rbtree(t);
+
+  // iterative walk returning every node to a shared pool
+  node_pool_t *pool = new_node_pool(0);
+  t = build(n, pool);
+  start = now_ns();
+  delete_rbtree(t);
+  uint64_t walk_ns = now_ns() - start;
+  delete_node_pool(pool);
+
+  // exclusively owned pool: drop the slabs
+  t = build(n, NULL);
+  start = now_ns();
+  delete_rbtree(t);
+  uint64_t slab_ns = now_ns() - start;
+
+  printf("{\"bench\": \"teardown\", \"size\": %zu, \"legacy_recursive_ns\": "
+         "%llu, \"iterative_walk_ns\": %llu, \"slab_drop_ns\": %llu}\n",
+         n, (unsigned long long)legacy_ns, (unsigned long long)walk_ns,
+         (unsigned long long)slab_ns);
+  return 0;
+}
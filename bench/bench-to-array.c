@@ -0,0 +1,57 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bench.h"
+#include "rbtree.h"
+
+// the previous implementation: walk the whole tree, then check n
+static void legacy_inorder(const rbtree *t, node_t *node, key_t *arr,
+                           size_t *index) {
+  if (node != t->nil) {
+    legacy_inorder(t, node->left, arr, index);
+    arr[(*index)++] = node->key;
+    legacy_inorder(t, node->right, arr, index);
+  }
+}
+
+int main(int argc, char *argv[]) {
+  const size_t n = bench_arg(argc, argv, 1, 10000000);
+  const size_t top = bench_arg(argc, argv, 2, 100);
+  const int rounds = 5;
+
+  rbtree *t = new_rbtree();
+  uint64_t seed = 42;
+  for (size_t i = 0; i < n; i++) {
+    rbtree_insert(t, (key_t)(bench_rand(&seed) >> 33));
+  }
+
+  key_t *arr = malloc(n * sizeof(key_t));
+  uint64_t best_top = UINT64_MAX, best_full = UINT64_MAX,
+           best_legacy = UINT64_MAX;
+  for (int r = 0; r < rounds; r++) {
+    uint64_t start = now_ns();
+    size_t got = rbtree_to_array(t, arr, top);
+    uint64_t mid = now_ns();
+    rbtree_to_array(t, arr, n);
+    uint64_t end = now_ns();
+    size_t index = 0;
+    legacy_inorder(t, t->root, arr, &index);
+    uint64_t legacy = now_ns();
+    if (got != (top < n ? top : n) || index != n) {
+      fprintf(stderr, "unexpected key count\n");
+      return 1;
+    }
+    if (mid - start < best_top) best_top = mid - start;
+    if (end - mid < best_full) best_full = end - mid;
+    if (legacy - end < best_legacy) best_legacy = legacy - end;
+  }
+
+  printf("{\"bench\": \"to_array\", \"size\": %zu, \"top\": %zu, "
+         "\"top_ns\": %llu, \"full_ns\": %llu, \"legacy_full_ns\": %llu}\n",
+         n, top, (unsigned long long)best_top, (unsigned long long)best_full,
+         (unsigned long long)best_legacy);
+
+  free(arr);
+  delete_rbtree(t);
+  return 0;
+}
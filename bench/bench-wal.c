@@ -0,0 +1,82 @@
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench.h"
+#include "rbtree.h"
+#include "rbtree_wal.h"
+
+// durable inserts per second with 1..64 writer threads when every write
+// waits for its own fsync (0 us) versus group commit windows of 1 ms and
+// 10 ms, then the time to rebuild the tree from the snapshot and log
+
+typedef struct {
+  rbtree_wal *w;
+  size_t ops;
+  uint64_t seed;
+} worker;
+
+static void *run_worker(void *arg) {
+  worker *w = (worker *)arg;
+  for (size_t i = 0; i < w->ops; i++) {
+    rbtree_wal_insert(w->w, (key_t)(bench_rand(&w->seed) >> 33));
+  }
+  return NULL;
+}
+
+static void remove_files(const char *path) {
+  const char *suffixes[] = {".snap", ".log0", ".log1"};
+  char file[4096];
+  for (int i = 0; i < 3; i++) {
+    snprintf(file, sizeof(file), "%s%s", path, suffixes[i]);
+    remove(file);
+  }
+}
+
+int main(int argc, char *argv[]) {
+  const size_t ops = bench_arg(argc, argv, 1, 2000);
+  const char *path = argc > 2 ? argv[2] : "bench-wal";
+  const unsigned windows[] = {0, 1000, 10000};
+  const int threads[] = {1, 8, 64};
+
+  for (size_t i = 0; i < sizeof(windows) / sizeof(windows[0]); i++) {
+    for (size_t j = 0; j < sizeof(threads) / sizeof(threads[0]); j++) {
+      const int n = threads[j];
+      remove_files(path);
+      rbtree_wal *wal = rbtree_wal_open(path, windows[i]);
+      if (wal == NULL) {
+        fprintf(stderr, "cannot open %s\n", path);
+        return 1;
+      }
+      worker *w = calloc(n, sizeof(worker));
+      pthread_t *tid = calloc(n, sizeof(pthread_t));
+      uint64_t start = now_ns();
+      for (int k = 0; k < n; k++) {
+        w[k] = (worker){wal, ops / n, 31 + k};
+        pthread_create(&tid[k], NULL, run_worker, &w[k]);
+      }
+      for (int k = 0; k < n; k++) {
+        pthread_join(tid[k], NULL);
+      }
+      uint64_t ns = now_ns() - start;
+      size_t done = (ops / n) * n;
+      rbtree_wal_close(wal);
+
+      start = now_ns();
+      wal = rbtree_wal_open(path, windows[i]);
+      uint64_t replay_ns = now_ns() - start;
+      rbtree_wal_close(wal);
+
+      printf("{\"bench\": \"wal\", \"commit_us\": %u, \"threads\": %d, "
+             "\"ops\": %zu, \"ops_per_sec\": %.0f, \"us_per_op\": %.2f, "
+             "\"replay_ms\": %.2f}\n",
+             windows[i], n, done, done / (ns / 1e9), ns / 1e3 / done,
+             replay_ns / 1e6);
+      free(tid);
+      free(w);
+    }
+  }
+  remove_files(path);
+  return 0;
+}
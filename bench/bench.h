@@ -0,0 +1,131 @@
+#ifndef _BENCH_H_
+#define _BENCH_H_
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/resource.h>
+#include <time.h>
+
+// monotonic clock in nanoseconds
+static inline uint64_t now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+// xorshift64* so that runs are reproducible and cheap to generate
+static inline uint64_t bench_rand(uint64_t *state) {
+  uint64_t x = *state;
+  x ^= x >> 12;
+  x ^= x << 25;
+  x ^= x >> 27;
+  *state = x;
+  return x * 2685821657736338717ull;
+}
+
+// size argument from argv[i] or the given default
+static inline size_t bench_arg(int argc, char *argv[], int i, size_t def) {
+  return argc > i ? (size_t)strtoull(argv[i], NULL, 10) : def;
+}
+
+// peak resident set size of this process in KiB
+static inline long peak_rss_kb(void) {
+  struct rusage ru;
+  getrusage(RUSAGE_SELF, &ru);
+  return ru.ru_maxrss;
+}
+
+// Zipfian ranks in [0, n) (Gray et al., "Quickly generating billion-record
+// synthetic databases"); rank 0 is the most popular
+typedef struct {
+  uint64_t n;
+  double theta, alpha, zetan, eta, half_pow_theta;
+  uint64_t state;
+} zipf_gen;
+
+static inline void zipf_init(zipf_gen *z, uint64_t n, double theta,
+                             uint64_t seed) {
+  double zetan = 0, zeta2 = 1 + pow(0.5, theta);
+  for (uint64_t i = 1; i <= n; i++) {
+    zetan += 1 / pow((double)i, theta);
+  }
+  z->n = n;
+  z->theta = theta;
+  z->alpha = 1 / (1 - theta);
+  z->zetan = zetan;
+  z->eta = (1 - pow(2.0 / n, 1 - theta)) / (1 - zeta2 / zetan);
+  z->half_pow_theta = pow(0.5, theta);
+  z->state = seed;
+}
+
+static inline uint64_t zipf_next(zipf_gen *z) {
+  double u = (double)(bench_rand(&z->state) >> 11) / 9007199254740992.0;
+  double uz = u * z->zetan;
+  if (uz < 1) {
+    return 0;
+  }
+  if (uz < 1 + z->half_pow_theta) {
+    return 1;
+  }
+  uint64_t rank =
+      (uint64_t)(z->n * pow(z->eta * u - z->eta + 1, z->alpha));
+  return rank < z->n ? rank : z->n - 1;
+}
+
+// latency samples of every stride-th operation
+typedef struct {
+  uint64_t *samples;
+  size_t count, cap, stride;
+} bench_lat;
+
+static inline void lat_init(bench_lat *l, size_t ops, size_t max_samples) {
+  l->stride = ops / max_samples + 1;
+  l->cap = ops / l->stride + 1;
+  l->count = 0;
+  l->samples = (uint64_t *)malloc(l->cap * sizeof(uint64_t));
+}
+
+static inline int u64_cmp(const void *p1, const void *p2) {
+  const uint64_t a = *(const uint64_t *)p1;
+  const uint64_t b = *(const uint64_t *)p2;
+  return (a > b) - (a < b);
+}
+
+static inline uint64_t lat_percentile(bench_lat *l, double p) {
+  if (l->count == 0) {
+    return 0;
+  }
+  return l->samples[(size_t)(p * (l->count - 1))];
+}
+
+// run `op` for operation i, timing it when i falls on the sampling stride
+#define BENCH_OP(lat, i, op)                           \
+  do {                                                 \
+    if ((i) % (lat)->stride == 0) {                    \
+      uint64_t start_ = now_ns();                      \
+      op;                                              \
+      (lat)->samples[(lat)->count++] = now_ns() - start_; \
+    } else {                                           \
+      op;                                              \
+    }                                                  \
+  } while (0)
+
+// print one JSON line for a finished workload and release its samples
+static inline void bench_report(const char *impl, const char *workload,
+                                const char *dist, size_t size, size_t ops,
+                                uint64_t total_ns, bench_lat *l) {
+  qsort(l->samples, l->count, sizeof(uint64_t), u64_cmp);
+  printf("{\"impl\": \"%s\", \"workload\": \"%s\", \"dist\": \"%s\", "
+         "\"size\": %zu, \"ops\": %zu, \"ns_per_op\": %.2f, "
+         "\"ops_per_sec\": %.0f, \"p50_ns\": %llu, \"p99_ns\": %llu, "
+         "\"peak_rss_kb\": %ld}\n",
+         impl, workload, dist, size, ops, (double)total_ns / ops,
+         ops * 1e9 / total_ns, (unsigned long long)lat_percentile(l, 0.50),
+         (unsigned long long)lat_percentile(l, 0.99), peak_rss_kb());
+  fflush(stdout);
+  free(l->samples);
+}
+
+#endif  // _BENCH_H_
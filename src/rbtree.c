@@ -1,10 +1,163 @@
 #include "rbtree.h"
 
 #include <stdlib.h>
+#include <string.h>
 
+//합집합/교집합/차집합을 나눠서 수행할 스레드 수. 1이면 스레드를 만들지 않고,
+//2 이상이면 pthread를 사용하므로 -lpthread로 링크해야 한다.
+#ifndef RBTREE_SET_OP_THREADS
+#define RBTREE_SET_OP_THREADS 1
+#endif
 
-//새로운 레드-블랙 트리를 생성하고 초기화 하는 함수.
-rbtree *new_rbtree(void) {
+#if RBTREE_SET_OP_THREADS > 1
+#include <pthread.h>
+#endif
+
+//풀이 처음 할당하는 slab의 노드 수와 slab이 커질 수 있는 최대 노드 수
+#define NODE_POOL_DEFAULT_SLAB 64
+#define NODE_POOL_MAX_SLAB (1 << 16)
+
+//레드-블랙 트리의 높이는 2 * log2(N + 1)을 넘지 않으므로 64비트 주소 공간의 어떤 트리도 이 깊이 안에 들어간다
+#define RBTREE_MAX_HEIGHT 128
+
+//rbtree_concurrent의 reader는 쓰기 잠금 없이 root와 노드의 key, 링크를 __atomic_load_n으로 읽으므로
+//삽입/삭제 경로는 그 필드들을 relaxed atomic store로 쓴다. 일반 store와 같은 명령으로 컴파일된다.
+#define STORE(field, value) __atomic_store_n(&(field), (value), __ATOMIC_RELAXED)
+
+#if RBTREE_STATS
+//트리의 통계 카운터를 하나 늘린다. rbtree_find 같은 읽기 함수도 세야 하므로 const를 벗겨서 쓴다.
+#define STAT(t, field) (((rbtree *)(t))->stats.field++)
+#define STAT_DEPTH(t, hist, depth) STAT(t, hist[(depth) < RBTREE_STATS_DEPTHS ? (depth) : RBTREE_STATS_DEPTHS - 1])
+#else
+#define STAT(t, field) ((void)0)
+#define STAT_DEPTH(t, hist, depth) ((void)(depth))
+#endif
+
+//집합 연산에서 검은 높이가 이보다 낮은 (노드가 수천 개 이하일 수 있는) 부분 문제는 스레드를 나누지 않는다
+#define SET_OP_FORK_BH 10
+
+//노드들을 연속으로 담고 있는 메모리 덩어리. 풀은 slab들을 연결 리스트로 관리한다.
+typedef struct slab_t {
+  struct slab_t *next;
+  size_t n;
+  node_t nodes[];
+} slab_t;
+
+struct node_pool_t {
+  slab_t *slabs;        //할당된 slab 리스트
+  node_t *free_list;    //반환된 노드들 (node->right로 연결)
+  node_t *cursor;       //현재 slab에서 아직 나눠주지 않은 첫 노드
+  node_t *end;          //현재 slab의 끝
+  size_t slab_nodes;    //다음에 할당할 slab의 노드 수
+  size_t refs;          //풀을 참조하는 트리와 호출자의 수
+  int external;         //노드를 호출자가 가지고 있는 (intrusive) 트리의 풀이면 1. nil만 제공하고 노드를 할당하거나 회수하지 않는다.
+  node_t nil;           //풀을 쓰는 트리들이 공유하는 sentinel. 같은 풀의 트리끼리는 노드를 그대로 옮길 수 있다.
+};
+
+//새로운 노드 풀을 생성하는 함수. slab_nodes가 0이면 기본값을 사용
+node_pool_t *new_node_pool(const size_t slab_nodes) {
+  node_pool_t *pool = (node_pool_t *)calloc(1, sizeof(node_pool_t));
+  if(pool == NULL){
+    return NULL;
+  }
+  pool->slab_nodes = slab_nodes ? slab_nodes : NODE_POOL_DEFAULT_SLAB;
+  pool->refs = 1;
+  pool->nil.color = RBTREE_BLACK;
+  return pool;
+}
+
+//풀의 참조를 하나 해제하고, 마지막 참조였다면 slab 단위로 전부 반환하는 함수
+static void node_pool_release(node_pool_t *pool) {
+  if(--pool->refs > 0){
+    return;
+  }
+  slab_t *slab = pool->slabs;
+  while(slab != NULL){
+    slab_t *next = slab->next;
+    free(slab);
+    slab = next;
+  }
+  free(pool);
+}
+
+//호출자가 가진 풀의 참조를 해제하는 함수. 풀을 쓰는 트리가 남아있으면 그 트리가 삭제될 때 반환된다.
+void delete_node_pool(node_pool_t *pool) {
+  if(pool != NULL){
+    node_pool_release(pool);
+  }
+}
+
+//새 slab을 할당해서 현재 slab으로 설정하는 함수.
+//slab을 0으로 채워 두면 풀 노드의 포인터 필드는 언제나 NULL, nil 또는 풀의 노드 중 하나이므로
+//잠금 없이 읽는 rbtree_concurrent의 reader가 쓰는 중인 노드를 따라가도 풀 밖으로 나가지 않는다.
+static int node_pool_grow(node_pool_t *pool) {
+  if(pool->external){
+    return -1;
+  }
+  slab_t *slab = (slab_t *)calloc(1, sizeof(slab_t) + pool->slab_nodes * sizeof(node_t));
+  if(slab == NULL){
+    return -1;
+  }
+  slab->n = pool->slab_nodes;
+  slab->next = pool->slabs;
+  pool->slabs = slab;
+  pool->cursor = slab->nodes;
+  pool->end = slab->nodes + slab->n;
+
+  //다음 slab은 두 배로 키워서 slab 수를 O(log N)으로 유지
+  if(pool->slab_nodes < NODE_POOL_MAX_SLAB){
+    pool->slab_nodes *= 2;
+  }
+  return 0;
+}
+
+//풀에서 노드 하나를 꺼내는 함수. free list를 먼저 사용하고, 없으면 slab에서 잘라낸다.
+static node_t *node_pool_alloc(node_pool_t *pool) {
+  node_t *node = pool->free_list;
+  if(node != NULL){
+    pool->free_list = node->right;
+    return node;
+  }
+  if(pool->cursor == pool->end && node_pool_grow(pool) != 0){
+    return NULL;
+  }
+  return pool->cursor++;
+}
+
+//풀에서 메모리상 연속된 노드 n개를 한 번에 꺼내는 함수.
+//현재 slab에 자리가 부족하면 정확히 n개짜리 slab을 따로 할당한다.
+static node_t *node_pool_alloc_block(node_pool_t *pool, const size_t n) {
+  if((size_t)(pool->end - pool->cursor) >= n){
+    node_t *block = pool->cursor;
+    pool->cursor += n;
+    return block;
+  }
+  if(pool->external){
+    return NULL;
+  }
+  slab_t *slab = (slab_t *)calloc(1, sizeof(slab_t) + n * sizeof(node_t));
+  if(slab == NULL){
+    return NULL;
+  }
+  slab->n = n;
+  slab->next = pool->slabs;
+  pool->slabs = slab;
+  return slab->nodes;
+}
+
+//노드를 풀의 free list로 반환하는 함수
+static void node_pool_free(node_pool_t *pool, node_t *node) {
+  //호출자의 노드는 free list에 넣으면 다음 할당에서 재사용되므로 그대로 둔다
+  if(pool->external){
+    return;
+  }
+  STORE(node->right, pool->free_list);
+  pool->free_list = node;
+}
+
+//주어진 풀을 사용하는 레드-블랙 트리를 생성하고 초기화 하는 함수.
+//풀이 NULL이면 트리 전용 풀을 새로 만든다.
+rbtree *new_rbtree_with_allocator(node_pool_t *pool) {
 
   // rbtree 구조체에 대한 메모리를 할당
   rbtree *new = (rbtree *)calloc(1, sizeof(rbtree));
@@ -12,50 +165,83 @@ rbtree *new_rbtree(void) {
     return NULL;
   }
 
-  // 'nil'노드를 위한 메모리를 할당
-  node_t *nil = (node_t *)calloc(1, sizeof(node_t));
-  if(nil == NULL){
-    free(new);
-    return NULL;
+  // 풀이 주어지면 참조를 추가하고, 아니면 트리 전용 풀을 생성
+  if(pool != NULL){
+    pool->refs++;
+  } else {
+    pool = new_node_pool(0);
+    if(pool == NULL){
+      free(new);
+      return NULL;
+    }
   }
-  
-  // 'nil' 노드의 색을 검은색으로 변경
-  nil->color = RBTREE_BLACK;
 
-  // 트리 초기화
-  new->root = nil;
-  new->nil = nil;
+  // 트리 초기화. 'nil' 노드는 풀이 가지고 있는 검은색 노드를 사용
+  new->root = &pool->nil;
+  new->nil = &pool->nil;
+  new->leftmost = &pool->nil;
+  new->rightmost = &pool->nil;
+  new->pool = pool;
   return new;
 }
 
-//재귀적으로 노드를 해제하는 보조 함수
-void free_rbtree_nodes(node_t *node, node_t *nil) {
+//새로운 레드-블랙 트리를 생성하고 초기화 하는 함수.
+rbtree *new_rbtree(void) {
+  return new_rbtree_with_allocator(NULL);
+}
 
-  //nil 노드에 도달 시 반환
-  if(node == nil){
-    return;
+//노드를 호출자가 제공하는 트리를 생성하는 함수. rbtree_insert_node로만 노드를 넣을 수 있고,
+//트리는 노드를 할당하거나 해제하지 않으므로 rbtree_erase와 delete_rbtree는 노드를 떼어내기만 한다.
+rbtree *new_rbtree_intrusive(void) {
+  rbtree *t = new_rbtree();
+  if(t != NULL){
+    t->pool->external = 1;
   }
+  return t;
+}
 
-  //왼쪽 서브 트리를 재귀적으로 해제
-  free_rbtree_nodes(node->left, nil);
+//서브 트리의 노드들을 풀에 반환하고 그 수를 반환하는 보조 함수.
+//재귀 대신 아직 방문하지 않은 오른쪽 서브 트리만 고정 크기 스택에 쌓으며 전위 순회한다.
+//스택에는 트리 높이만큼만 쌓이므로 RBTREE_MAX_HEIGHT를 넘지 않는다.
+size_t free_rbtree_nodes(node_t *node, node_t *nil, node_pool_t *pool) {
+  node_t *stack[RBTREE_MAX_HEIGHT];
+  int top = 0;
+  size_t n = 0;
 
-  //오른쪽 서브 트리를 재귀적으로 해제
-  free_rbtree_nodes(node->right, nil);
+  while(node != nil){
+    node_t *left = node->left;
+    node_t *right = node->right;
 
-  //현재 노드를 해제
-  free(node);
+    //풀에 반환하면 node->right가 덮어써지므로 자식을 먼저 읽고 반환
+    node_pool_free(pool, node);
+    n++;
+
+    //왼쪽 자식으로 내려가고, 오른쪽 자식은 나중에 방문하도록 스택에 쌓음
+    if(left != nil){
+      if(right != nil){
+        stack[top++] = right;
+      }
+      node = left;
+    }
+    else if(right != nil){
+      node = right;
+    }
+    else {
+      node = top > 0 ? stack[--top] : nil;
+    }
+  }
+  return n;
 }
 
 //RB 트리를 해제 하는 함수
 void delete_rbtree(rbtree *t) {
 
-  //루트 노드가 nil노드가 아니라면 모든 노드의 메모리를 해제
-  if (t->root != t->nil){
-    free_rbtree_nodes(t->root, t->nil);
+  //풀을 다른 트리나 호출자와 공유하고 있으면 노드들을 하나씩 풀에 돌려준다.
+  //트리 전용 풀이면 풀을 해제할 때 slab 단위로 한 번에 반환되므로 순회가 필요 없다.
+  if (t->pool->refs > 1 && !t->pool->external && t->root != t->nil){
+    free_rbtree_nodes(t->root, t->nil, t->pool);
   }
-
-  //nil 노드에 할당된 메모리를 해제
-  free(t->nil);
+  node_pool_release(t->pool);
 
   //RB 트리 구조체에 할당된 메모리를 해제
   free(t);
@@ -66,33 +252,41 @@ void left_rotate(rbtree *t, node_t *node){
   //node의 오른쪽 자식으로 right_child를 선언하고 초기화
   node_t *right_child = node->right;
 
+  STAT(t, left_rotations);
+
   //right_child의 왼쪽 서브 트리를 node의 오른쪽 서브 트리로 이동
-  node->right = right_child->left;
+  STORE(node->right, right_child->left);
   
   //y의 왼쪽 서브트리가 nil이 아니면, 그 부모를 node로 설정
   if(right_child->left != t->nil){
-    right_child->left->parent = node;
+    STORE(right_child->left->parent, node);
   }
 
   //right_child의 부모를 node의 부모로 설정
-  right_child->parent = node->parent;
+  STORE(right_child->parent, node->parent);
 
   //node가 루트면 루트를 right_child로 설정
   if(node->parent == t->nil){
-    t->root = right_child;
+    STORE(t->root, right_child);
   } 
   //node가 부모의 왼쪽 자식이면 그것을 right_child로 설정
   else if ( node == node->parent->left){
-    node->parent->left = right_child;
+    STORE(node->parent->left, right_child);
   } 
   //node가 부모의 오른쪽 자식이면 그것을 right_child로 설정
   else {
-    node->parent->right = right_child;
+    STORE(node->parent->right, right_child);
   }
 
   //right_child의 왼쪽 자식을 node로 설정, node의 부모를 right_child로 설정
-  right_child->left = node;
-  node->parent = right_child;
+  STORE(right_child->left, node);
+  STORE(node->parent, right_child);
+
+#if RBTREE_ORDER_STATS
+  //회전한 두 노드의 서브 트리 크기를 갱신 (right_child가 node의 자리를 물려받음)
+  right_child->size = node->size;
+  node->size = node->left->size + node->right->size + 1;
+#endif
 
 }
 
@@ -100,31 +294,38 @@ void left_rotate(rbtree *t, node_t *node){
 void right_rotate(rbtree *t, node_t *node){
   //왼쪽으로 회전하는 함수와 대칭적으로 동일
   node_t *right_child = node-> left;
+  STAT(t, right_rotations);
 
-  node->left = right_child->right;
+  STORE(node->left, right_child->right);
   
   if(right_child->right != t->nil){
-    right_child->right->parent = node;
+    STORE(right_child->right->parent, node);
   }
 
-  right_child->parent = node->parent;
+  STORE(right_child->parent, node->parent);
 
   if(node->parent == t->nil){
-    t->root = right_child;
+    STORE(t->root, right_child);
   } 
   else if ( node == node->parent->right){
-    node->parent->right = right_child;
+    STORE(node->parent->right, right_child);
   } 
   else {
-    node->parent->left = right_child;
+    STORE(node->parent->left, right_child);
   }
 
-  right_child->right = node;
-  node->parent = right_child;
+  STORE(right_child->right, node);
+  STORE(node->parent, right_child);
+
+#if RBTREE_ORDER_STATS
+  right_child->size = node->size;
+  node->size = node->left->size + node->right->size + 1;
+#endif
 }
 
-//RB 트리에 새 노드를 삽입 시 RB의 속성에 맞게 고치는 함수
-void rbtree_insert_fixup(rbtree *t, node_t *z) {
+//RB 트리에 새 노드를 삽입 시 RB의 속성에 맞게 고치는 함수.
+//빨강이 된 루트를 검은색으로 바꿔서 트리의 검은 높이가 1 늘었으면 1을 반환한다.
+int rbtree_insert_fixup(rbtree *t, node_t *z) {
   node_t *y = NULL;
 
   // z의 부모가 레드인 동안 루프를 수행합니다.
@@ -135,6 +336,7 @@ void rbtree_insert_fixup(rbtree *t, node_t *z) {
       y = z->parent->parent->right;
       // 삼촌 노드가 레드일 경우, 부모를 블랙으로, 삼촌을 블랙으로, 조부모를 레드로 변경
       if(y->color == RBTREE_RED){
+        STAT(t, insert_fixup[0][0]);
         z->parent->color = RBTREE_BLACK;
         y->color = RBTREE_BLACK;
         z->parent->parent->color = RBTREE_RED;
@@ -144,10 +346,12 @@ void rbtree_insert_fixup(rbtree *t, node_t *z) {
       else {
         //z가 오른쪽 자식이면 부모노드로 이동 후 왼쪽 회전
         if(z == z->parent->right){
+          STAT(t, insert_fixup[0][1]);
           z = z->parent;
           left_rotate(t,z);
         }
         //z가 왼쪽 자식이면 부모를 블랙으로, 조부모를 레드로 변경 후 오른쪽 회전
+        STAT(t, insert_fixup[0][2]);
         z->parent->color = RBTREE_BLACK;
         z->parent->parent->color = RBTREE_RED;
         right_rotate(t, z->parent->parent);
@@ -157,6 +361,7 @@ void rbtree_insert_fixup(rbtree *t, node_t *z) {
     else{
       y = z->parent->parent->left;
       if(y->color == RBTREE_RED){
+        STAT(t, insert_fixup[1][0]);
         z->parent->color = RBTREE_BLACK;
         y->color = RBTREE_BLACK;
         z->parent->parent->color = RBTREE_RED;
@@ -164,9 +369,11 @@ void rbtree_insert_fixup(rbtree *t, node_t *z) {
       }
       else {
         if(z == z->parent->left){
+          STAT(t, insert_fixup[1][1]);
           z = z->parent;
           right_rotate(t, z);
         }
+        STAT(t, insert_fixup[1][2]);
         z->parent->color = RBTREE_BLACK;
         z->parent->parent->color = RBTREE_RED;
         left_rotate(t,z->parent->parent);
@@ -174,63 +381,179 @@ void rbtree_insert_fixup(rbtree *t, node_t *z) {
     }
   }
   //루트 노드를 블랙으로 변경
+  const int grew = t->root->color == RBTREE_RED;
   t->root->color = RBTREE_BLACK;
+  return grew;
 }
 
-//새 키를 RB트리에 삽입하는 함수
-node_t *rbtree_insert(rbtree *t, const key_t key) {
+//z를 y의 자식 자리에 연결하고 균형을 맞추는 함수. y는 z가 들어갈 쪽의 자식이 nil인 노드여야 한다.
+static void attach(rbtree *t, node_t *z, node_t *y) {
+  //y를 z의 부모 노드로 변경
+  STORE(z->parent, y);
+
+  //z를 연결
+  if(y == t->nil){
+    STORE(t->root, z);
+  }
+  else if(z->key < y->key){
+    STORE(y->left, z);
+  }
+  else STORE(y->right, z);
+
+  //같은 키는 오른쪽으로 가므로 z는 최소보다 작을 때만 새 최소, 최대 이상이면 새 최대가 된다.
+  //회전은 중위 순서를 바꾸지 않으므로 fixup 뒤에도 그대로 맞다.
+  if(t->leftmost == t->nil || z->key < t->leftmost->key){
+    t->leftmost = z;
+  }
+  if(t->rightmost == t->nil || !(z->key < t->rightmost->key)){
+    t->rightmost = z;
+  }
+
+  //새로 삽입된 노드에 대해서 조정작업을 수행
+  rbtree_insert_fixup(t,z);
+}
+
+//z를 start를 루트로 하는 서브 트리 안의 자리에 연결하고 균형을 맞추는 함수.
+//start는 트리의 루트이거나, z의 키가 그 서브 트리의 키 범위 안에 들어가는 노드여야 한다.
+//track_size가 0이면 서브 트리 크기를 갱신하지 않으므로 호출자가 나중에 다시 계산해야 한다.
+static void insert_below(rbtree *t, node_t *z, node_t *start, const int track_size) {
 
   //y는 삽입될 위치를 찾는 포인터, x는 탐색을 수행하는 포인터
-  node_t *y = t->nil;
-  node_t *x = t->root;
+  node_t *y = start == t->root ? t->nil : start->parent;
+  node_t *x = start;
 
-  // 새로 삽입될 노드 z의 메모리를 할당
-  node_t *z = (node_t *)malloc(sizeof(node_t));
-  if(z == NULL){
-    return NULL;
+#if RBTREE_ORDER_STATS
+  //z는 start의 조상들의 서브 트리에도 들어가게 된다
+  for(node_t *a = y; track_size && a != t->nil; a = a->parent){
+    a->size++;
   }
-  
-  // z 노드의 속성: 빨강색, 자식 노드는 nil노드, 매개변수 키를 키값으로 가진다.
-  z->color = RBTREE_RED;
-  z->left = t->nil;
-  z->right = t->nil;
-  z->key = key;
+#else
+  (void)track_size;
+#endif
 
   //트리를 내려가면서 새 노드의 삽입 위치를 찾는다.
+  size_t depth = 0;
   while(x != t->nil){
     y = x;
+    depth++;
+#if RBTREE_ORDER_STATS
+    //z는 지나가는 모든 노드의 서브 트리에 들어가게 된다
+    x->size += track_size != 0;
+#endif
     //현재 노드의 키를 비교해서 새 키가 작으면 왼쪽, 크거나 같으면 오른쪽 노드로 이동
     if(z->key < x->key){
       x = x->left;
     }
     else x = x->right;
   }
-  //y를 z의 부모 노드로 변경
-  z->parent = y;
+  STAT(t, inserts);
+  STAT_DEPTH(t, insert_depth, depth);
+  attach(t, z, y);
+}
 
-  //z를 연결
-  if(y == t->nil){
-    t->root = z;
+//새 노드의 필드를 초기화하는 함수
+static void init_node(const rbtree *t, node_t *z, const key_t key) {
+  // z 노드의 속성: 빨강색, 자식 노드는 nil노드, 매개변수 키를 키값으로 가진다.
+  z->color = RBTREE_RED;
+  STORE(z->left, t->nil);
+  STORE(z->right, t->nil);
+  STORE(z->key, key);
+#if RBTREE_ORDER_STATS
+  z->size = 1;
+#endif
+}
+
+//새 키를 RB트리에 삽입하는 함수
+node_t *rbtree_insert(rbtree *t, const key_t key) {
+
+  // 새로 삽입될 노드 z를 트리의 풀에서 할당
+  node_t *z = node_pool_alloc(t->pool);
+  if(z == NULL){
+    return NULL;
   }
-  else if(z->key < y->key){
-    y->left = z;
+  init_node(t, z, key);
+
+  //루트부터 내려가며 삽입한 후 반환
+  insert_below(t, z, t->root, 1);
+  return z;
+}
+
+//key가 중위 순서에서 hint 바로 뒤나 바로 앞에 들어갈 키이면 새 노드의 부모가 될 노드를, 아니면 NULL을 반환하는 함수.
+//이웃한 두 노드 중 하나는 서로를 향하는 쪽의 자식 자리가 비어 있으므로 그 노드가 부모가 된다.
+//최소/최대 캐시가 맞도록 같은 키는 hint 쪽에 붙을 때만 받아들인다.
+static node_t *hint_parent(const rbtree *t, node_t *hint, const key_t key) {
+  if(!(key < hint->key)){
+    //hint가 최대이면 바로 오른쪽 자식 자리에 붙는다 (단조 증가하는 키의 경우)
+    if(hint == t->rightmost){
+      return hint;
+    }
+    node_t *next = rbtree_next(t, hint);
+    if(!(key < next->key)){
+      return NULL;
+    }
+    return hint->right == t->nil ? hint : next;
+  }
+  if(hint == t->leftmost){
+    return hint;
+  }
+  node_t *prev = rbtree_prev(t, hint);
+  if(key < prev->key){
+    return NULL;
   }
-  else y->right = z;
+  return hint->left == t->nil ? hint : prev;
+}
 
-  //새로 삽입된 노드에 대해서 조정작업을 수행한 후 반환
-  rbtree_insert_fixup(t,z);
+//hint (t의 노드 또는 NULL) 옆에 들어갈 키이면 루트부터 내려가지 않고 바로 연결하는 함수.
+//hint가 최대 노드이거나 직전에 삽입한 노드이면 정렬된 키의 삽입이 fixup을 포함해 평균 O(1)이 된다
+//(RBTREE_ORDER_STATS면 조상의 크기 갱신 때문에 O(log N)). hint가 맞지 않으면 rbtree_insert와 같다.
+node_t *rbtree_insert_hint(rbtree *t, node_t *hint, const key_t key) {
+  node_t *z = node_pool_alloc(t->pool);
+  if(z == NULL){
+    return NULL;
+  }
+  init_node(t, z, key);
+
+  node_t *y = hint == NULL ? NULL : hint_parent(t, hint, key);
+  if(y == NULL){
+    insert_below(t, z, t->root, 1);
+    return z;
+  }
+#if RBTREE_ORDER_STATS
+  for(node_t *a = y; a != t->nil; a = a->parent){
+    a->size++;
+  }
+#endif
+  STAT(t, inserts);
+  STAT_DEPTH(t, insert_depth, 0);
+  attach(t, z, y);
   return z;
 }
 
+//호출자가 key를 채워 둔 노드 z를 그대로 트리에 연결하는 함수. 할당하지 않는다.
+//t는 new_rbtree_intrusive로 만든 트리여야 하며, 아니면 (지울 때 z가 풀로 들어가므로) 연결하지 않고 -1 반환.
+//z의 메모리는 호출자의 것이며, rbtree_erase로 떼어내거나 트리를 삭제할 때까지 옮기거나 해제하면 안 된다.
+int rbtree_insert_node(rbtree *t, node_t *z) {
+  if(!t->pool->external){
+    return -1;
+  }
+  init_node(t, z, z->key);
+  insert_below(t, z, t->root, 1);
+  return 0;
+}
+
 //rb트리에서 주어진 키값을 가진 노드를 찾는 함수
 node_t *rbtree_find(const rbtree *t, const key_t key) {
   //현재 노드를 루트 노드로 설정
   node_t *current = t->root;
+  size_t depth = 0;
+  STAT(t, finds);
 
   //현재 노드가 nil노드가 되기 전 까지 탐색. 
   while(current != t->nil){
+    depth++;
     //현재 노드의 키와 매개변수 키가 동일하면 현재 노드를 반환
     if(current->key == key){
+      STAT_DEPTH(t, find_depth, depth);
       return current;
     }
     //현재 노드의 키가 매개변수의 키보다 작으면 오른쪽 자식노드로 이동
@@ -241,37 +564,66 @@ node_t *rbtree_find(const rbtree *t, const key_t key) {
     else current = current->left;
   }
   //미발견
+  STAT_DEPTH(t, find_depth, depth);
   return NULL;
 }
 
-//RB트리의 최소값을 찾는 함수
-node_t *rbtree_min(const rbtree *t) {
-  node_t *current = t->root;
+//rbtree_find_many가 동시에 진행하는 탐색의 수
+#define FIND_MANY_LANES 16
 
-  //현재 트리가 비었을 경우 못찾았음을 리턴
-  if (current == t->nil){
-    return NULL;
+//키 n개를 찾아서 out[i]에 rbtree_find(t, keys[i])와 같은 결과를 저장하는 함수.
+//여러 탐색을 한 단계씩 번갈아 진행하고 다음 자식 노드를 미리 가져와서 캐시 미스가 겹치게 한다.
+//탐색이 끝난 자리에는 바로 다음 키를 넣어서 항상 FIND_MANY_LANES개의 탐색이 진행되도록 한다.
+void rbtree_find_many(const rbtree *t, const key_t *keys, const size_t n, node_t **out) {
+  node_t *current[FIND_MANY_LANES];
+  size_t index[FIND_MANY_LANES];
+  size_t next = 0;
+  int active = 0;
+
+  //처음 탐색들을 루트에서 시작
+  while(active < FIND_MANY_LANES && next < n){
+    index[active] = next++;
+    current[active++] = t->root;
   }
-  //nil 노드를 만나기 전까지 왼쪽 자식 노드들로 이동 후 리턴
-  while(current->left != t->nil){
-    current = current->left;
+
+  while(active > 0){
+    for(int i = 0; i < active;){
+      node_t *x = current[i];
+      const key_t key = keys[index[i]];
+
+      //탐색이 끝났으면 결과를 저장하고 그 자리에서 다음 키의 탐색을 시작
+      if(x == t->nil || x->key == key){
+        out[index[i]] = x == t->nil ? NULL : x;
+        if(next < n){
+          index[i] = next++;
+          current[i++] = t->root;
+        }
+        else {
+          //남은 키가 없으면 마지막 탐색을 이 자리로 옮김
+          active--;
+          index[i] = index[active];
+          current[i] = current[active];
+        }
+        continue;
+      }
+
+      //rbtree_find와 같은 방향으로 한 단계 내려가고 그 노드를 미리 가져옴
+      x = key < x->key ? x->left : x->right;
+      __builtin_prefetch(x);
+      current[i++] = x;
+    }
   }
-  return current;
 }
 
-//RB트리의 최대값을 찾는 함수
-node_t *rbtree_max(const rbtree *t) {
-    node_t *current = t->root;
-
+//RB트리의 최소값을 찾는 함수. 삽입/삭제가 유지하는 leftmost를 돌려주므로 O(1)
+node_t *rbtree_min(const rbtree *t) {
   //현재 트리가 비었을 경우 못찾았음을 리턴
-  if (current == t->nil){
-    return NULL;
-  }
-  //nil 노드를 만나기 전까지 오른쪽 자식 노드들로 이동 후 리턴
-  while(current->right != t->nil){
-    current = current->right;
-  }
-  return current;
+  return t->leftmost == t->nil ? NULL : t->leftmost;
+}
+
+//RB트리의 최대값을 찾는 함수. O(1)
+node_t *rbtree_max(const rbtree *t) {
+  return t->rightmost == t->nil ? NULL : t->rightmost;
 }
 
 //노드를 삭제 시 RB 트리를 고치는 함수
@@ -285,6 +637,7 @@ void rbtree_delete_fixup(rbtree *t, node_t *x) {
 
       //case 1: 형제노드가 빨강색인 경우 형제 노드를 검은색, 부모노드를 빨강색으로 변경 후 왼쪽 회전
       if (w->color == RBTREE_RED){
+        STAT(t, delete_fixup[0][0]);
         w->color = RBTREE_BLACK;
         x->parent->color = RBTREE_RED;
         left_rotate(t,x->parent);
@@ -294,12 +647,14 @@ void rbtree_delete_fixup(rbtree *t, node_t *x) {
       //case 2: 형제 노드의 자식 노드 둘 다 검은색일 경우 
       if (w->left->color == RBTREE_BLACK  && w->right->color == RBTREE_BLACK){
         //형제 노드의 색을 빨강색으로 변경
+        STAT(t, delete_fixup[0][1]);
         w->color =RBTREE_RED;
         //삭제하려는 노드에 부모노드를 대입
         x = x->parent;
       } else {
         // Case 3: 형제 노드의 오른쪽 자식만 블랙인 경우 형제 노드의 왼쪽 자식을 블랙, 형제 노드를 레드로 설정한 후 오른쪽 회전
         if(w->right->color == RBTREE_BLACK) {
+          STAT(t, delete_fixup[0][2]);
           w->left->color = RBTREE_BLACK;
           w->color = RBTREE_RED;
           right_rotate(t,w);
@@ -307,6 +662,7 @@ void rbtree_delete_fixup(rbtree *t, node_t *x) {
         }
 
         //case 4: 형제 노드의 색이 검은색이고 형제 노드의 오른쪽 자식이 레드일 경우 노드들의 색을 변경하고 왼쪽 회전
+        STAT(t, delete_fixup[0][3]);
         w->color = x->parent->color;
         x->parent->color = RBTREE_BLACK;
         w->right->color = RBTREE_BLACK;
@@ -319,6 +675,7 @@ void rbtree_delete_fixup(rbtree *t, node_t *x) {
 
       //case 1
       if (w->color == RBTREE_RED){
+        STAT(t, delete_fixup[1][0]);
         w->color = RBTREE_BLACK;
         x->parent->color = RBTREE_RED;
         right_rotate(t,x->parent);
@@ -327,12 +684,14 @@ void rbtree_delete_fixup(rbtree *t, node_t *x) {
 
       //case 2
       if(w->left->color == RBTREE_BLACK  && w->right->color == RBTREE_BLACK){
+        STAT(t, delete_fixup[1][1]);
         w->color = RBTREE_RED;
         x = x->parent;
       }
       //case3
       else {
         if(w->left->color == RBTREE_BLACK) {
+          STAT(t, delete_fixup[1][2]);
           w->right->color = RBTREE_BLACK;
           w->color = RBTREE_RED;
           left_rotate(t, w);
@@ -340,6 +699,7 @@ void rbtree_delete_fixup(rbtree *t, node_t *x) {
         }
 
         //case 4
+        STAT(t, delete_fixup[1][3]);
         w->color = x->parent->color;
         x->parent->color =RBTREE_BLACK;
         w->left->color =RBTREE_BLACK;
@@ -355,14 +715,14 @@ void rbtree_delete_fixup(rbtree *t, node_t *x) {
 void rb_transplant(rbtree *t, node_t *u, node_t *v) {
   //삭제한 노드가 루트 노드일 때 후계자 노드를 루트노드로 변경
   if (u->parent == t->nil) {
-    t->root = v;
+    STORE(t->root, v);
   //삭제한 노드의 자리를 후계자 노드로 대체
   } else if (u == u->parent->left) {
-    u->parent->left = v;
+    STORE(u->parent->left, v);
   } else {
-    u->parent->right = v;
+    STORE(u->parent->right, v);
   }
-  v->parent = u->parent;
+  STORE(v->parent, u->parent);
 }
 
 //서브트리의 노드들 중 키가 최소값을 가지는 노드를 반환하는 함수
@@ -380,7 +740,231 @@ node_t *rbtree_sub_min(const rbtree *t, node_t *subroot) {
   return cursor;
 }
 
+//서브트리의 노드들 중 키가 최대값을 가지는 노드를 반환하는 함수
+node_t *rbtree_sub_max(const rbtree *t, node_t *subroot) {
+  if (subroot == NULL) {
+    return NULL;
+  }
+
+  //cursor는 현재 서브 루트, 오른쪽 자식으로 계속 이동
+  node_t *cursor = subroot;
+  while (cursor->right != t->nil) {
+    cursor = cursor->right;
+  }
+
+  return cursor;
+}
+
+//트리 전체를 한 번에 바꾸는 연산 (일괄 생성, join, split, 집합 연산) 뒤에 새 루트를 설정하고
+//leftmost/rightmost를 양쪽 끝까지 내려가서 다시 구하는 함수. O(log N)
+static void set_root(rbtree *t, node_t *root) {
+  t->root = root;
+  t->leftmost = root == t->nil ? t->nil : rbtree_sub_min(t, root);
+  t->rightmost = root == t->nil ? t->nil : rbtree_sub_max(t, root);
+}
+
+//중위 순회에서 node 바로 다음 노드를 반환하는 함수. 마지막 노드면 NULL 반환
+//부모 포인터를 따라 올라가므로 전체 순회 시 노드당 O(1)로 상환된다.
+node_t *rbtree_next(const rbtree *t, const node_t *node) {
+  //오른쪽 서브 트리가 있으면 그 서브 트리의 최소 노드가 다음 노드
+  if (node->right != t->nil) {
+    return rbtree_sub_min(t, node->right);
+  }
+
+  //없으면 왼쪽 자식 쪽에서 올라오게 되는 첫 조상이 다음 노드
+  node_t *parent = node->parent;
+  while (parent != t->nil && node == parent->right) {
+    node = parent;
+    parent = parent->parent;
+  }
+  return parent == t->nil ? NULL : parent;
+}
+
+//중위 순회에서 node 바로 이전 노드를 반환하는 함수. 첫 노드면 NULL 반환
+node_t *rbtree_prev(const rbtree *t, const node_t *node) {
+  //rbtree_next와 대칭적으로 동일
+  if (node->left != t->nil) {
+    return rbtree_sub_max(t, node->left);
+  }
+
+  node_t *parent = node->parent;
+  while (parent != t->nil && node == parent->left) {
+    node = parent;
+    parent = parent->parent;
+  }
+  return parent == t->nil ? NULL : parent;
+}
+
+//키가 key 이상인 첫 노드를 루트에서 한 번 내려가며 찾는 함수. 없으면 NULL 반환
+node_t *rbtree_lower_bound(const rbtree *t, const key_t key) {
+  node_t *current = t->root;
+  node_t *found = NULL;
+
+  while (current != t->nil) {
+    //현재 노드가 key 이상이면 후보로 기억하고 더 작은 후보를 찾아 왼쪽으로 이동
+    if (!(current->key < key)) {
+      found = current;
+      current = current->left;
+    }
+    else current = current->right;
+  }
+  return found;
+}
+
+//키가 key보다 큰 첫 노드를 루트에서 한 번 내려가며 찾는 함수. 없으면 NULL 반환
+node_t *rbtree_upper_bound(const rbtree *t, const key_t key) {
+  node_t *current = t->root;
+  node_t *found = NULL;
+
+  while (current != t->nil) {
+    //현재 노드가 key보다 크면 후보로 기억하고 왼쪽으로 이동
+    if (key < current->key) {
+      found = current;
+      current = current->left;
+    }
+    else current = current->right;
+  }
+  return found;
+}
+
+//키가 key인 노드들의 구간 [*first, *last)를 찾는 함수. *last가 NULL이면 구간이 트리 끝까지 이어진다.
+//두 경계의 탐색 경로는 key와 같은 첫 노드까지 공유하므로 그 지점까지는 한 번만 내려가고,
+//거기서 왼쪽 서브 트리로 lower bound를, 오른쪽 서브 트리로 upper bound를 이어서 찾는다.
+void rbtree_equal_range(const rbtree *t, const key_t key, node_t **first, node_t **last) {
+  node_t *current = t->root;
+  node_t *lo = NULL, *hi = NULL;
+
+  //key와 같은 노드를 만날 때까지는 두 경계 모두 같은 방향으로 이동
+  while (current != t->nil && !(current->key == key)) {
+    if (key < current->key) {
+      lo = hi = current;
+      current = current->left;
+    }
+    else current = current->right;
+  }
+
+  if (current != t->nil) {
+    //왼쪽 서브 트리에서 key 이상인 첫 노드를 찾음 (현재 노드가 후보)
+    node_t *x = current->left;
+    lo = current;
+    while (x != t->nil) {
+      if (!(x->key < key)) {
+        lo = x;
+        x = x->left;
+      }
+      else x = x->right;
+    }
+
+    //오른쪽 서브 트리에서 key보다 큰 첫 노드를 찾음
+    x = current->right;
+    while (x != t->nil) {
+      if (key < x->key) {
+        hi = x;
+        x = x->left;
+      }
+      else x = x->right;
+    }
+  }
+
+  *first = lo;
+  *last = hi;
+}
+
+#if RBTREE_ORDER_STATS
+//키가 key보다 작은 (inclusive면 key 이하인) 노드의 개수를 루트에서 한 번 내려가며 세는 함수
+static size_t count_below(const rbtree *t, const key_t key, const int inclusive) {
+  node_t *current = t->root;
+  size_t rank = 0;
+
+  while (current != t->nil) {
+    //현재 노드가 경계 안에 있으면 왼쪽 서브 트리와 현재 노드를 모두 세고 오른쪽으로 이동
+    if (current->key < key || (inclusive && current->key == key)) {
+      rank += current->left->size + 1;
+      current = current->right;
+    }
+    else current = current->left;
+  }
+  return rank;
+}
+
+//트리의 키 개수를 반환하는 함수
+size_t rbtree_size(const rbtree *t) {
+  return t->root->size;
+}
+
+//k번째(0부터 시작)로 작은 키를 가진 노드를 반환하는 함수. k가 범위를 벗어나면 NULL 반환
+node_t *rbtree_select(const rbtree *t, size_t k) {
+  node_t *current = t->root;
+
+  while (current != t->nil) {
+    size_t left = current->left->size;
+    //왼쪽 서브 트리에 k번째가 있으면 왼쪽으로, 아니면 왼쪽과 현재 노드를 건너뛰고 오른쪽으로 이동
+    if (k < left) {
+      current = current->left;
+    }
+    else if (k == left) {
+      return current;
+    }
+    else {
+      k -= left + 1;
+      current = current->right;
+    }
+  }
+  return NULL;
+}
+
+//key보다 작은 키의 개수를 반환하는 함수
+size_t rbtree_rank(const rbtree *t, const key_t key) {
+  return count_below(t, key, 0);
+}
+
+//키가 key인 노드의 개수를 반환하는 함수
+size_t rbtree_count(const rbtree *t, const key_t key) {
+  return count_below(t, key, 1) - count_below(t, key, 0);
+}
+#else
+//키가 key인 노드의 개수를 반환하는 함수. 서브 트리 크기가 없으므로 같은 키의 구간을 직접 센다.
+size_t rbtree_count(const rbtree *t, const key_t key) {
+  node_t *first, *last;
+  size_t count = 0;
+
+  rbtree_equal_range(t, key, &first, &last);
+  while (first != last) {
+    count++;
+    first = rbtree_next(t, first);
+  }
+  return count;
+}
+#endif
+
+//[lo, hi) 범위의 노드들을 순서대로 돌려주도록 커서를 설정하는 함수
+void rbtree_range(const rbtree *t, rbtree_cursor *cursor, const key_t lo, const key_t hi) {
+  cursor->tree = t;
+  cursor->hi = hi;
+  cursor->node = lo < hi ? rbtree_lower_bound(t, lo) : NULL;
+}
+
+//커서가 가리키는 노드를 반환하고 다음 노드로 이동하는 함수. 범위를 벗어나면 NULL 반환
+node_t *rbtree_cursor_next(rbtree_cursor *cursor) {
+  node_t *current = cursor->node;
+  if (current == NULL || !(current->key < cursor->hi)) {
+    cursor->node = NULL;
+    return NULL;
+  }
+  cursor->node = rbtree_next(cursor->tree, current);
+  return current;
+}
+
 int rbtree_erase(rbtree *t, node_t *p) {
+  //p가 최소이면 왼쪽 자식이 없으므로 다음 노드는 오른쪽 서브 트리의 최소이거나 부모이다 (최대는 대칭).
+  //p에게 한쪽 자식이 없으면 다른 쪽 서브 트리의 검은 높이가 0이라 그 자식은 자식 없는 빨강 노드이므로 O(1)이다.
+  if(p == t->leftmost){
+    t->leftmost = p->right != t->nil ? rbtree_sub_min(t, p->right) : p->parent;
+  }
+  if(p == t->rightmost){
+    t->rightmost = p->left != t->nil ? rbtree_sub_max(t, p->left) : p->parent;
+  }
+
   //삭제하려는 노드의 후계자 노드를 생성
   node_t *y = p;
   color_t succeed_original_color = y->color;
@@ -404,58 +988,799 @@ int rbtree_erase(rbtree *t, node_t *p) {
 
     //
     if(y->parent == p){
-      x->parent = y;
+      STORE(x->parent, y);
     } else {
       rb_transplant(t,y,y->right);
-      y->right = p->right;
-      y->right->parent = y;
+      STORE(y->right, p->right);
+      STORE(y->right->parent, y);
     }
     //후계자 노드의 위치를 삭제된 노드 p의 위치로 옮김
     rb_transplant(t,p,y);
-    y->left = p->left;
-    y->left->parent = y;
+    STORE(y->left, p->left);
+    STORE(y->left->parent, y);
     y->color = p->color;
   }
+#if RBTREE_ORDER_STATS
+  //노드가 빠진 자리부터 루트까지 서브 트리 크기를 다시 계산
+  for(node_t *n = x->parent; n != t->nil; n = n->parent){
+    n->size = n->left->size + n->right->size + 1;
+  }
+#endif
+
   if(succeed_original_color == RBTREE_BLACK){
     rbtree_delete_fixup(t,x);
   }
 
-  free(p);
+  node_pool_free(t->pool, p);
   return 0;
 }
-//재귀적으로 중위순회해서 키를 배열에 저장하는 함수
-int recursive_inorder(const rbtree *t, node_t *node , key_t *arr, int *index){
+//최소 노드를 지우고 그 키를 *out에 저장한 뒤 1 반환. 비어있으면 0 반환.
+//탐색 없이 leftmost를 바로 지우므로 fixup을 포함해 평균 O(1)이다 (RBTREE_ORDER_STATS면 크기 갱신 때문에 O(log N)).
+int rbtree_pop_min(rbtree *t, key_t *out) {
+  node_t *p = t->leftmost;
+  if(p == t->nil){
+    return 0;
+  }
+  *out = p->key;
+  rbtree_erase(t, p);
+  return 1;
+}
+
+//최대 노드를 지우고 그 키를 *out에 저장한 뒤 1 반환. 비어있으면 0 반환
+int rbtree_pop_max(rbtree *t, key_t *out) {
+  node_t *p = t->rightmost;
+  if(p == t->nil){
+    return 0;
+  }
+  *out = p->key;
+  rbtree_erase(t, p);
+  return 1;
+}
+
+//레드-블랙 트리의 키를 작은 순서대로 최대 n개까지 배열에 저장하고 저장한 개수를 반환하는 함수.
+//재귀 대신 고정 크기 배열을 스택으로 써서 순회하고, n개를 채우면 바로 멈추므로 O(log N + n)개의 노드만 방문한다.
+size_t rbtree_to_array(const rbtree *t, key_t *arr, const size_t n) {
+  
+  // 빈 트리나 빈 배열이 주어진 경우 아무것도 저장하지 않음
+  if(t == NULL || arr == NULL){
+    return 0;
+  }
+
+  node_t *stack[RBTREE_MAX_HEIGHT];
+  int top = 0;
+  size_t index = 0;
+  node_t *current = t->root;
+
+  while(index < n){
+    //왼쪽 끝까지 내려가면서 지나온 노드를 스택에 쌓음
+    while(current != t->nil){
+      stack[top++] = current;
+      current = current->left;
+    }
+    if(top == 0){
+      break;
+    }
+    //가장 최근에 쌓은 노드를 저장하고 오른쪽 서브 트리로 이동
+    current = stack[--top];
+    arr[index++] = current->key;
+    current = current->right;
+  }
+  return index;
+}
 
-  //nil노드가 아닐때만 중위순회
-  if(node != t->nil){
-    //왼쪽 서브 트리를 재귀적으로 중위순회
-    recursive_inorder(t, node->left, arr, index);
+//정렬된 arr[lo, hi)로 완전 균형 서브 트리를 만들고 그 루트를 반환하는 함수.
+//arr[i]의 노드는 block[i]에 두어서 중위 순서와 메모리 순서가 같도록 한다.
+static node_t *build_sorted(const rbtree *t, node_t *block, const key_t *arr, size_t lo, size_t hi,
+                            node_t *parent, int depth, int red_depth) {
+  if(lo == hi){
+    return t->nil;
+  }
 
-    //현재 노드의 키를 배열에 삽입 후 인덱스 증가
-    arr[*index] = node->key;
-    (*index)++;
+  //가운데 키를 루트로 두면 양쪽 서브 트리의 크기 차이가 1 이하가 된다
+  size_t mid = lo + (hi - lo) / 2;
+  node_t *node = &block[mid];
+  node->key = arr[mid];
+  node->parent = parent;
+  //가장 깊은 층만 빨강으로 칠하면 모든 경로의 검은 노드 수가 같아진다
+  node->color = depth == red_depth ? RBTREE_RED : RBTREE_BLACK;
+#if RBTREE_ORDER_STATS
+  node->size = hi - lo;
+#endif
+  node->left = build_sorted(t, block, arr, lo, mid, node, depth + 1, red_depth);
+  node->right = build_sorted(t, block, arr, mid + 1, hi, node, depth + 1, red_depth);
+  return node;
+}
 
-    //오른쪽 서브 트리를 재귀적으로 중위순회
-    recursive_inorder(t, node->right, arr, index);
+//빈 트리 t에 정렬된 arr의 키들을 t의 풀의 연속된 블록으로 채우는 함수. 메모리가 부족하면 -1 반환
+static int build_from_sorted(rbtree *t, const key_t *arr, const size_t n) {
+  if(n == 0){
+    return 0;
+  }
+  node_t *block = node_pool_alloc_block(t->pool, n);
+  if(block == NULL){
+    return -1;
+  }
+
+  //중간값 분할로 만든 트리는 floor(log2(n)) 층을 빼고 모두 꽉 차 있다.
+  //노드가 하나뿐이면 루트가 검은색이어야 하므로 빨강으로 칠할 층이 없다.
+  int red_depth = 0;
+  while(((size_t)2 << red_depth) <= n){
+    red_depth++;
+  }
+  if(red_depth == 0){
+    red_depth = -1;
   }
+
+  set_root(t, build_sorted(t, block, arr, 0, n, t->nil, 0, red_depth));
   return 0;
 }
 
-//레드-블랙 트리를 배열로 변환하는 함수
-int rbtree_to_array(const rbtree *t, key_t *arr, const size_t n) {
-  
-  // 빈 트리나 빈 배열이 주어진 경우 오류
-  if(t == NULL || arr == NULL){
+//정렬된 배열로부터 회전 없이 O(N)에 레드-블랙 트리를 만드는 함수.
+//노드들은 하나의 연속된 블록에 할당된다. 배열이 정렬되어 있지 않으면 NULL 반환
+rbtree *rbtree_from_sorted_array(const key_t *arr, const size_t n) {
+  //배열이 오름차순인지 확인
+  for(size_t i = 1; i < n; i++){
+    if(arr[i] < arr[i - 1]){
+      return NULL;
+    }
+  }
+
+  rbtree *t = new_rbtree();
+  if(t == NULL){
     return NULL;
   }
+  if(build_from_sorted(t, arr, n) != 0){
+    delete_rbtree(t);
+    return NULL;
+  }
+  return t;
+}
 
-  //index 0을 가진 root노드부터 중위순회하여 배열에 저장
-  int index = 0;
-  recursive_inorder(t, t->root, arr, &index);
+#if RBTREE_ORDER_STATS
+//모든 노드의 서브 트리 크기를 후위 순회로 다시 계산하는 함수
+static void recompute_sizes(rbtree *t) {
+  node_t *stack[RBTREE_MAX_HEIGHT];
+  int top = 0;
+  node_t *current = t->root;
+  node_t *last = t->nil;
 
-  //입력받은 배열의 크기가 트리보다 큰 경우 오류
-  if((size_t)index > n){
-    return NULL;
+  while(top > 0 || current != t->nil){
+    //왼쪽 끝까지 내려가면서 지나온 노드를 스택에 쌓음
+    if(current != t->nil){
+      stack[top++] = current;
+      current = current->left;
+      continue;
+    }
+    node_t *node = stack[top - 1];
+    //오른쪽 서브 트리를 아직 방문하지 않았으면 오른쪽으로 이동
+    if(node->right != t->nil && last != node->right){
+      current = node->right;
+      continue;
+    }
+    //두 서브 트리를 모두 계산했으므로 현재 노드의 크기를 계산
+    node->size = node->left->size + node->right->size + 1;
+    last = node;
+    top--;
   }
+}
+#endif
+
+static int key_compare(const void *p1, const void *p2) {
+  const key_t a = *(const key_t *)p1;
+  const key_t b = *(const key_t *)p2;
+  return (a > b) - (a < b);
+}
+
+//키 n개를 한 번에 삽입하는 함수. 성공하면 0, 메모리가 부족하면 -1 반환
+//정렬된 순서로 삽입하면서 직전에 삽입한 노드에서 부모 포인터로 필요한 만큼만 올라간 뒤 내려가므로
+//매번 루트부터 내려가지 않는다. 배치의 노드들은 한 블록으로 할당한다.
+//키 100만 개를 rbtree_insert로 하나씩 넣는 것보다 빈 트리에는 4~5배 빠르지만, 키가 1000개인 트리에는 1.7~2.4배,
+//100만 개인 트리에는 연속된 키가 1.6배, random 키가 1.0배 정도로 3배에 미치지 못한다 (bench-insert-batch).
+//큰 트리에서는 삽입 위치마다 생기는 캐시 미스가 비용의 대부분이라 finger로 줄일 수 없기 때문이다.
+int rbtree_insert_batch(rbtree *t, const key_t *keys, const size_t n) {
+  if(n == 0){
+    return 0;
+  }
+
+  //정렬되어 있지 않으면 복사본을 정렬해서 사용
+  key_t *sorted = NULL;
+  for(size_t i = 1; i < n; i++){
+    if(keys[i] < keys[i - 1]){
+      sorted = (key_t *)malloc(n * sizeof(key_t));
+      if(sorted == NULL){
+        return -1;
+      }
+      memcpy(sorted, keys, n * sizeof(key_t));
+      qsort(sorted, n, sizeof(key_t), key_compare);
+      keys = sorted;
+      break;
+    }
+  }
+
+  node_t *block = node_pool_alloc_block(t->pool, n);
+  if(block == NULL){
+    free(sorted);
+    return -1;
+  }
+
+#if RBTREE_ORDER_STATS
+  //배치가 트리보다 훨씬 크면 삽입마다 조상의 크기를 고치는 대신 끝에서 한 번에 다시 계산한다
+  const int track_size = n / 4 <= t->root->size;
+#else
+  const int track_size = 1;
+#endif
+
+  //finger는 직전에 삽입한 노드, max는 트리의 최대 노드
+  node_t *finger = t->root;
+  node_t *max = rbtree_max(t);
+  for(size_t i = 0; i < n; i++){
+    node_t *z = &block[i];
+    init_node(t, z, keys[i]);
+
+    node_t *start;
+    if(max != NULL && !(z->key < max->key)){
+      //최대값 뒤에 붙는 키는 최대 노드의 오른쪽 자식 자리로 바로 들어간다
+      start = max;
+    }
+    else {
+      //키는 직전 키 이상이므로 finger의 서브 트리의 아래쪽 경계는 항상 만족한다.
+      //z의 키보다 큰 조상의 왼쪽 서브 트리에 들어올 때까지 올라가되,
+      //그 사이에서 z가 오른쪽으로 갈라져야 하는 가장 높은 조상부터 내려간다.
+      start = finger;
+      node_t *x = finger;
+      while(x != t->root){
+        node_t *parent = x->parent;
+        if(x == parent->left){
+          if(z->key < parent->key){
+            break;
+          }
+          start = parent;
+        }
+        x = parent;
+      }
+    }
+
+    insert_below(t, z, start, track_size);
+    finger = z;
+    if(max == NULL || !(z->key < max->key)){
+      max = z;
+    }
+  }
+
+#if RBTREE_ORDER_STATS
+  if(!track_size){
+    recompute_sizes(t);
+  }
+#endif
+
+  free(sorted);
   return 0;
 }
+
+//트리에서 떼어낸 서브 트리의 루트와 검은 높이 (루트에서 nil까지 경로의 검은 노드 수, nil 제외).
+//떼어낸 서브 트리의 루트는 항상 검은색으로 칠해 둔다.
+typedef struct {
+  node_t *root;
+  int bh;
+} subtree_t;
+
+static int black_height(const rbtree *t, const node_t *x) {
+  int h = 0;
+  for(; x != t->nil; x = x->left){
+    h += x->color == RBTREE_BLACK;
+  }
+  return h;
+}
+
+static subtree_t whole_tree(const rbtree *t) {
+  subtree_t s = {t->root, black_height(t, t->root)};
+  return s;
+}
+
+//검은 높이가 bh인 노드 x를 부모에서 떼어낸 서브 트리로 만드는 함수. 빨간 루트는 검은색으로 바꾼다.
+static subtree_t detach(const rbtree *t, node_t *x, int bh) {
+  if(x != t->nil){
+    x->parent = t->nil;
+    if(x->color == RBTREE_RED){
+      x->color = RBTREE_BLACK;
+      bh++;
+    }
+  }
+  subtree_t s = {x, bh};
+  return s;
+}
+
+//l의 키 <= k의 키 <= r의 키일 때 세 부분을 하나의 서브 트리로 잇는 함수.
+//검은 높이가 같으면 k를 루트로 두고, 다르면 높은 쪽의 안쪽 경계를 따라 검은 높이가 같은 검은 노드까지
+//내려가서 그 자리에 빨간 k를 끼운 뒤 삽입과 같은 방법으로 고치므로 O(|l.bh - r.bh| + 1)이다.
+//t는 작업용 트리로, 회전이 t->root를 고친다.
+static subtree_t join(rbtree *t, subtree_t l, node_t *k, subtree_t r) {
+  node_t *nil = t->nil;
+  if(l.bh == r.bh){
+    k->left = l.root;
+    k->right = r.root;
+    k->parent = nil;
+    k->color = RBTREE_BLACK;
+    if(l.root != nil){
+      l.root->parent = k;
+    }
+    if(r.root != nil){
+      r.root->parent = k;
+    }
+#if RBTREE_ORDER_STATS
+    k->size = l.root->size + r.root->size + 1;
+#endif
+    subtree_t s = {k, l.bh + 1};
+    return s;
+  }
+
+  const int left_taller = l.bh > r.bh;
+  subtree_t tall = left_taller ? l : r;
+  subtree_t low = left_taller ? r : l;
+
+  //높은 쪽의 오른쪽 (l이 높으면) 또는 왼쪽 경계를 따라 내려간다
+  node_t *p = nil;
+  node_t *y = tall.root;
+  int h = tall.bh;
+  while(!(y->color == RBTREE_BLACK && h == low.bh)){
+    h -= y->color == RBTREE_BLACK;
+#if RBTREE_ORDER_STATS
+    //k와 낮은 쪽 트리는 지나가는 모든 노드의 서브 트리에 들어가게 된다
+    y->size += low.root->size + 1;
+#endif
+    p = y;
+    y = left_taller ? y->right : y->left;
+  }
+
+  k->parent = p;
+  k->color = RBTREE_RED;
+  if(left_taller){
+    k->left = y;
+    k->right = low.root;
+    p->right = k;
+  }
+  else {
+    k->left = low.root;
+    k->right = y;
+    p->left = k;
+  }
+  if(y != nil){
+    y->parent = k;
+  }
+  if(low.root != nil){
+    low.root->parent = k;
+  }
+#if RBTREE_ORDER_STATS
+  k->size = k->left->size + k->right->size + 1;
+#endif
+
+  t->root = tall.root;
+  const int grew = rbtree_insert_fixup(t, k);
+  subtree_t s = {t->root, tall.bh + grew};
+  return s;
+}
+
+//s를 키가 key보다 작은 (inclusive면 key 이하인) 노드들 *lo와 나머지 *hi로 나누는 함수.
+//key를 찾아 내려간 경로를 아래에서부터 되짚으며 경로의 노드와 경로 밖의 서브 트리를 양쪽에 join한다.
+//양쪽에 쌓이는 트리의 검은 높이가 경로를 따라 커지므로 join 비용의 합은 O(log N)이다.
+static void unzip(rbtree *t, subtree_t s, const key_t key, const int inclusive,
+                  subtree_t *lo, subtree_t *hi) {
+  node_t *path[RBTREE_MAX_HEIGHT];
+  int bh[RBTREE_MAX_HEIGHT];
+  int top = 0;
+
+  node_t *x = s.root;
+  int h = s.bh;
+  while(x != t->nil){
+    path[top] = x;
+    bh[top++] = h;
+    h -= x->color == RBTREE_BLACK;
+    x = x->key < key || (inclusive && x->key == key) ? x->right : x->left;
+  }
+
+  subtree_t l = {t->nil, 0}, r = {t->nil, 0};
+  while(top > 0){
+    x = path[--top];
+    const int child_bh = bh[top] - (x->color == RBTREE_BLACK);
+    //x와 반대쪽 자식은 join이 x의 필드를 덮어쓰기 전에 떼어낸다
+    if(x->key < key || (inclusive && x->key == key)){
+      l = join(t, detach(t, x->left, child_bh), x, l);
+    }
+    else r = join(t, r, x, detach(t, x->right, child_bh));
+  }
+  *lo = l;
+  *hi = r;
+}
+
+//s에서 가장 작은 노드를 떼어내서 *min에 저장하고 나머지를 반환하는 함수. s는 비어있지 않아야 한다.
+static subtree_t pop_min(rbtree *t, subtree_t s, node_t **min) {
+  node_t *path[RBTREE_MAX_HEIGHT];
+  int bh[RBTREE_MAX_HEIGHT];
+  int top = 0;
+
+  node_t *x = s.root;
+  int h = s.bh;
+  for(;;){
+    path[top] = x;
+    bh[top++] = h;
+    if(x->left == t->nil){
+      break;
+    }
+    h -= x->color == RBTREE_BLACK;
+    x = x->left;
+  }
+
+  *min = path[--top];
+  subtree_t r = detach(t, x->right, bh[top] - (x->color == RBTREE_BLACK));
+  while(top > 0){
+    x = path[--top];
+    r = join(t, r, x, detach(t, x->right, bh[top] - (x->color == RBTREE_BLACK)));
+  }
+  return r;
+}
+
+//가운데 키 없이 두 서브 트리를 잇는 함수. r의 최소 노드를 가운데 노드로 쓴다.
+static subtree_t join2(rbtree *t, subtree_t l, subtree_t r) {
+  if(l.root == t->nil){
+    return r;
+  }
+  if(r.root == t->nil){
+    return l;
+  }
+  node_t *min;
+  r = pop_min(t, r, &min);
+  return join(t, l, min, r);
+}
+
+//t의 노드 수를 반환하는 함수
+static size_t count_nodes(const rbtree *t) {
+#if RBTREE_ORDER_STATS
+  return t->root->size;
+#else
+  size_t n = 0;
+  for(node_t *p = rbtree_min(t); p != NULL; p = rbtree_next(t, p)){
+    n++;
+  }
+  return n;
+#endif
+}
+
+//t의 키들을 pool에서 할당한 노드로 다시 만들어 옮기는 함수. O(N)이며,
+//메모리가 부족하면 t를 그대로 두고 -1 반환
+static int move_to_pool(rbtree *t, node_pool_t *pool) {
+  const size_t n = count_nodes(t);
+  key_t *arr = (key_t *)malloc((n ? n : 1) * sizeof(key_t));
+  rbtree *moved = new_rbtree_with_allocator(pool);
+  int ret = -1;
+  if(arr != NULL && moved != NULL){
+    rbtree_to_array(t, arr, n);
+    ret = build_from_sorted(moved, arr, n);
+  }
+  if(ret == 0){
+    //구조체 내용을 맞바꿔서 t는 새 노드들을, moved는 예전 노드들을 가지게 한 뒤 moved를 삭제
+    rbtree old = *t;
+    *t = *moved;
+    *moved = old;
+#if RBTREE_STATS
+    //카운터는 노드가 아니라 트리의 것이므로 t에 남긴다
+    t->stats = old.stats;
+#endif
+  }
+  if(moved != NULL){
+    delete_rbtree(moved);
+  }
+  free(arr);
+  return ret;
+}
+
+//노드를 옮길 수 있도록 두 트리가 같은 풀 (같은 nil)을 쓰게 만드는 함수.
+//풀이 다르면 검은 높이가 낮은 (노드가 적은) 쪽을 다른 쪽 풀로 옮긴다.
+//intrusive 트리는 옮기면 호출자의 노드가 풀의 노드로 바뀌어 버리므로 -1 반환
+static int share_pool(rbtree *t1, rbtree *t2) {
+  if(t1->pool->external || t2->pool->external){
+    return -1;
+  }
+  if(t1->pool == t2->pool){
+    return 0;
+  }
+  if(black_height(t1, t1->root) < black_height(t2, t2->root)){
+    return move_to_pool(t1, t2->pool);
+  }
+  return move_to_pool(t2, t1->pool);
+}
+
+//t1의 키 <= key <= t2의 키일 때 key와 t2의 노드들을 t1로 옮기고 t2를 삭제하는 함수.
+//두 트리가 같은 풀을 쓰면 O(log N)이다. 같은 트리이거나 순서가 맞지 않거나 메모리가 부족하면 -1 반환 (두 트리의 키는 그대로)
+int rbtree_join(rbtree *t1, const key_t key, rbtree *t2) {
+  if(t1 == t2){
+    return -1;
+  }
+  node_t *max = rbtree_max(t1);
+  node_t *min = rbtree_min(t2);
+  if((max != NULL && key < max->key) || (min != NULL && min->key < key)){
+    return -1;
+  }
+  if(share_pool(t1, t2) != 0){
+    return -1;
+  }
+  node_t *k = node_pool_alloc(t1->pool);
+  if(k == NULL){
+    return -1;
+  }
+  init_node(t1, k, key);
+
+  subtree_t s = join(t1, whole_tree(t1), k, whole_tree(t2));
+  set_root(t1, s.root);
+  t2->root = t2->nil;
+  delete_rbtree(t2);
+  return 0;
+}
+
+//t를 키가 key보다 작은 노드들의 트리 *lo와 key 이상인 노드들의 트리 *hi로 O(log N)에 나누는 함수.
+//t는 *lo가 되고, *hi는 t와 같은 풀을 쓰는 새 트리이다. intrusive 트리이거나 메모리가 부족하면 t를 그대로 두고 -1 반환
+int rbtree_split(rbtree *t, const key_t key, rbtree **lo, rbtree **hi) {
+  if(t->pool->external){
+    return -1;
+  }
+  rbtree *right = new_rbtree_with_allocator(t->pool);
+  if(right == NULL){
+    return -1;
+  }
+  subtree_t l, r;
+  unzip(t, whole_tree(t), key, 0, &l, &r);
+  set_root(t, l.root);
+  set_root(right, r.root);
+  *lo = t;
+  *hi = right;
+  return 0;
+}
+
+typedef enum { SET_UNION, SET_INTERSECTION, SET_DIFFERENCE } set_op_t;
+
+typedef struct {
+  rbtree work;        //회전이 루트를 고치는 작업용 트리 (스레드마다 따로 가진다)
+  set_op_t op;
+  node_t *other_nil;  //교집합/차집합에서 키를 찾아보는 트리의 nil
+  node_t *garbage;    //결과에서 빠진 서브 트리들 (루트의 parent로 연결). 풀 반환은 끝난 뒤 한 번에 한다.
+  int forks;          //이 호출 아래에서 쓸 수 있는 스레드 수
+} set_ctx;
+
+#if RBTREE_STATS
+//from의 카운터들을 to에 더하는 함수. 집합 연산은 t1의 복사본 (작업용 트리)에서 세므로 끝난 뒤 t1로 합친다.
+static void stats_add(rbtree_stats_t *to, const rbtree_stats_t *from) {
+  //black_height 앞의 필드는 모두 size_t 카운터이다
+  size_t *dst = (size_t *)to;
+  const size_t *src = (const size_t *)from;
+  for(size_t i = 0; i < offsetof(rbtree_stats_t, black_height) / sizeof(size_t); i++){
+    dst[i] += src[i];
+  }
+}
+#endif
+
+static void discard(set_ctx *c, subtree_t s) {
+  if(s.root != c->work.nil){
+    s.root->parent = c->garbage;
+    c->garbage = s.root;
+  }
+}
+
+static subtree_t set_rec(set_ctx *c, subtree_t a, subtree_t b);
+
+#if RBTREE_SET_OP_THREADS > 1
+typedef struct {
+  set_ctx c;
+  subtree_t a, b, out;
+} set_task;
+
+static void *set_task_run(void *arg) {
+  set_task *task = (set_task *)arg;
+  task->out = set_rec(&task->c, task->a, task->b);
+  return NULL;
+}
+#endif
+
+//서로 겹치지 않는 두 부분 문제 (la, lb), (ra, rb)를 푸는 함수.
+//RBTREE_SET_OP_THREADS가 2 이상이면 충분히 큰 왼쪽 문제를 새 스레드에 맡긴다 (fork-join).
+//두 문제는 서로 다른 노드만 고치고 nil은 읽기만 하므로 잠금이 필요 없다.
+static void set_both(set_ctx *c, subtree_t la, subtree_t lb, subtree_t ra, subtree_t rb,
+                     subtree_t *l, subtree_t *r) {
+#if RBTREE_SET_OP_THREADS > 1
+  if(c->forks > 1 && la.bh >= SET_OP_FORK_BH && ra.bh >= SET_OP_FORK_BH){
+    set_task task = {*c, la, lb, {NULL, 0}};
+    task.c.forks = c->forks / 2;
+    task.c.garbage = NULL;
+#if RBTREE_STATS
+    memset(&task.c.work.stats, 0, sizeof(task.c.work.stats));
+#endif
+    pthread_t tid;
+    if(pthread_create(&tid, NULL, set_task_run, &task) == 0){
+      const int forks = c->forks;
+      c->forks -= forks / 2;
+      *r = set_rec(c, ra, rb);
+      pthread_join(tid, NULL);
+      c->forks = forks;
+      *l = task.out;
+#if RBTREE_STATS
+      stats_add(&c->work.stats, &task.c.work.stats);
+#endif
+
+      //스레드가 버린 서브 트리들을 이어 붙임
+      node_t *g = task.c.garbage;
+      while(g != NULL){
+        node_t *next = g->parent;
+        g->parent = c->garbage;
+        c->garbage = g;
+        g = next;
+      }
+      return;
+    }
+  }
+#endif
+  *l = set_rec(c, la, lb);
+  *r = set_rec(c, ra, rb);
+}
+
+//b의 루트 키로 a를 나누고 양쪽을 재귀적으로 처리한 뒤 다시 잇는 함수.
+//합집합은 b의 노드들도 결과로 옮기고, 교집합/차집합은 b (다른 트리)를 읽기만 한다.
+//b의 노드마다 a를 O(log(n/m + 1))에 나누고 이으므로 전체 O(m log(n/m + 1))이다.
+static subtree_t set_rec(set_ctx *c, subtree_t a, subtree_t b) {
+  node_t *nil = c->work.nil;
+  if(c->op == SET_UNION){
+    if(a.root == nil){
+      return b;
+    }
+    if(b.root == nil){
+      return a;
+    }
+  }
+  else {
+    if(a.root == nil){
+      return a;
+    }
+    if(b.root == c->other_nil){
+      //b에 없는 키들만 남았다
+      if(c->op == SET_DIFFERENCE){
+        return a;
+      }
+      discard(c, a);
+      subtree_t empty = {nil, 0};
+      return empty;
+    }
+  }
+
+  node_t *m = b.root;
+  const key_t key = m->key;
+  subtree_t bl = {m->left, 0}, br = {m->right, 0};
+  if(c->op == SET_UNION){
+    const int child_bh = b.bh - (m->color == RBTREE_BLACK);
+    bl = detach(&c->work, m->left, child_bh);
+    br = detach(&c->work, m->right, child_bh);
+  }
+
+  //a를 key보다 작은 쪽, key와 같은 쪽, 큰 쪽으로 나눔 (합집합은 같은 쪽을 큰 쪽에 둔다)
+  subtree_t lt, eq, gt;
+  unzip(&c->work, a, key, 0, &lt, &gt);
+  if(c->op != SET_UNION){
+    unzip(&c->work, gt, key, 1, &eq, &gt);
+  }
+
+  subtree_t l, r;
+  set_both(c, lt, bl, gt, br, &l, &r);
+
+  if(c->op == SET_UNION){
+    return join(&c->work, l, m, r);
+  }
+  //key는 b에 있으므로 교집합은 a의 key들을 남기고 차집합은 버린다
+  if(c->op == SET_INTERSECTION){
+    l = join2(&c->work, l, eq);
+  }
+  else discard(c, eq);
+  return join2(&c->work, l, r);
+}
+
+//t1을 작업용 트리로 집합 연산을 수행하고 버려진 노드들을 풀에 반환하는 함수.
+//작업용 트리는 t1의 복사본이므로 RBTREE_STATS면 그 카운터를 0에서 시작해서 끝난 뒤 t1에 더한다.
+static subtree_t run_set_op(rbtree *t1, const set_op_t op, node_t *other_nil, subtree_t a, subtree_t b) {
+  set_ctx c = {*t1, op, other_nil, NULL, RBTREE_SET_OP_THREADS};
+#if RBTREE_STATS
+  memset(&c.work.stats, 0, sizeof(c.work.stats));
+#endif
+  subtree_t s = set_rec(&c, a, b);
+#if RBTREE_STATS
+  stats_add(&t1->stats, &c.work.stats);
+#endif
+  while(c.garbage != NULL){
+    node_t *next = c.garbage->parent;
+    free_rbtree_nodes(c.garbage, t1->nil, t1->pool);
+    c.garbage = next;
+  }
+  return s;
+}
+
+//키가 [lo, hi) 안에 있는 노드들을 모두 지우고 지운 수를 반환하는 함수.
+//lo와 hi에서 두 번 split해서 가운데 서브 트리를 통째로 떼어내고, 남은 양쪽을 한 번 join한 뒤
+//떼어낸 노드들을 한꺼번에 풀에 돌려주므로 노드마다 delete fixup을 하지 않고 O(log N + k)이다.
+size_t rbtree_erase_range(rbtree *t, const key_t lo, const key_t hi) {
+  //범위가 비었거나 트리의 키들과 겹치지 않으면 O(1)에 끝낸다
+  if(!(lo < hi) || t->root == t->nil || t->rightmost->key < lo || !(t->leftmost->key < hi)){
+    return 0;
+  }
+  subtree_t l, m, r;
+  unzip(t, whole_tree(t), lo, 0, &l, &m);
+  unzip(t, m, hi, 0, &m, &r);
+  set_root(t, join2(t, l, r).root);
+  return free_rbtree_nodes(m.root, t->nil, t->pool);
+}
+
+//키가 key보다 작은 노드들을 모두 지우고 지운 수를 반환하는 함수. 오래된 키를 만료시킬 때 사용하며 O(log N + k)
+size_t rbtree_truncate_below(rbtree *t, const key_t key) {
+  if(t->root == t->nil || !(t->leftmost->key < key)){
+    return 0;
+  }
+  subtree_t l, r;
+  unzip(t, whole_tree(t), key, 0, &l, &r);
+  set_root(t, r.root);
+  return free_rbtree_nodes(l.root, t->nil, t->pool);
+}
+
+//t2의 노드들을 t1로 모두 옮기고 t2를 삭제하는 함수 (같은 키는 양쪽 것을 모두 가진다).
+//같은 트리나 intrusive 트리를 주거나 메모리가 부족하면 -1 반환. 두 트리가 다른 풀을 쓰면 작은 쪽을 먼저 다른 쪽 풀로 옮긴다.
+int rbtree_union(rbtree *t1, rbtree *t2) {
+  if(t1 == t2 || share_pool(t1, t2) != 0){
+    return -1;
+  }
+  //작은 트리의 노드들로 큰 트리를 나눠야 O(m log(n/m + 1))이 된다
+  subtree_t a = whole_tree(t1), b = whole_tree(t2);
+  if(a.bh < b.bh){
+    subtree_t tmp = a;
+    a = b;
+    b = tmp;
+  }
+  set_root(t1, run_set_op(t1, SET_UNION, NULL, a, b).root);
+  t2->root = t2->nil;
+  delete_rbtree(t2);
+  return 0;
+}
+
+//t1에서 키가 t2에 있는 노드들만 남기는 함수. t2는 바뀌지 않는다.
+//어느 한쪽이 intrusive 트리이면 아무것도 바꾸지 않고 -1 반환
+int rbtree_intersection(rbtree *t1, const rbtree *t2) {
+  if(t1->pool->external || t2->pool->external){
+    return -1;
+  }
+  if(t1 == t2){
+    return 0;
+  }
+  subtree_t b = {t2->root, 0};
+  set_root(t1, run_set_op(t1, SET_INTERSECTION, t2->nil, whole_tree(t1), b).root);
+  return 0;
+}
+
+//t1에서 키가 t2에 있는 노드들을 모두 지우는 함수. t2는 바뀌지 않는다.
+//어느 한쪽이 intrusive 트리이면 아무것도 바꾸지 않고 -1 반환
+int rbtree_difference(rbtree *t1, const rbtree *t2) {
+  if(t1->pool->external || t2->pool->external){
+    return -1;
+  }
+  if(t1 == t2){
+    free_rbtree_nodes(t1->root, t1->nil, t1->pool);
+    set_root(t1, t1->nil);
+    return 0;
+  }
+  subtree_t b = {t2->root, 0};
+  set_root(t1, run_set_op(t1, SET_DIFFERENCE, t2->nil, whole_tree(t1), b).root);
+  return 0;
+}
+
+#if RBTREE_STATS
+//트리가 만들어진 뒤 (또는 마지막 rbtree_stats_reset 뒤) 쌓인 카운터와 지금의 검은 높이를 out에 복사하는 함수
+void rbtree_stats(const rbtree *t, rbtree_stats_t *out) {
+  *out = t->stats;
+  out->black_height = black_height(t, t->root);
+}
+
+//카운터를 모두 0으로 되돌리는 함수. 주기적으로 꺼내서 구간별 값을 볼 때 사용
+void rbtree_stats_reset(rbtree *t) {
+  memset(&t->stats, 0, sizeof(t->stats));
+}
+#endif
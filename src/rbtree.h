@@ -3,6 +3,18 @@
 
 #include <stddef.h>
 
+// 노드에 서브 트리 크기를 저장해서 rank/select를 O(log N)에 지원할지 여부.
+// 필요 없으면 -DRBTREE_ORDER_STATS=0 으로 끄면 노드 크기와 갱신 비용이 사라진다.
+#ifndef RBTREE_ORDER_STATS
+#define RBTREE_ORDER_STATS 1
+#endif
+
+// 회전, 색 변경, 탐색 깊이를 트리마다 세어서 rbtree_stats로 꺼내 볼지 여부.
+// 기본은 꺼져 있으며, 끄면 카운터 필드와 증가 코드가 모두 사라진다.
+#ifndef RBTREE_STATS
+#define RBTREE_STATS 0
+#endif
+
 typedef enum { RBTREE_RED, RBTREE_BLACK } color_t;
 
 typedef int key_t;
@@ -11,22 +23,107 @@ typedef struct node_t {
   color_t color;
   key_t key;
   struct node_t *parent, *left, *right;
+#if RBTREE_ORDER_STATS
+  size_t size;  // 이 노드를 루트로 하는 서브 트리의 노드 수 (nil은 0)
+#endif
 } node_t;
 
+// node_t를 큰 연속 slab 단위로 나눠주는 노드 풀 (intrusive free list 사용)
+typedef struct node_pool_t node_pool_t;
+
+#if RBTREE_STATS
+// 깊이 히스토그램의 칸 수. 이보다 깊은 탐색은 마지막 칸에 센다.
+#define RBTREE_STATS_DEPTHS 64
+
+typedef struct {
+  // 아래 배열들의 첫 번째 첨자는 0: 부모 (삭제는 x)가 왼쪽 자식, 1: 오른쪽 자식
+  size_t insert_fixup[2][3];  // case 1 (삼촌이 빨강, 색만 변경), 2 (꺾인 모양, 회전 후 case 3), 3 (회전)
+  size_t delete_fixup[2][4];  // case 1 (형제가 빨강) ~ case 4 (형제의 먼 자식이 빨강)
+  size_t left_rotations, right_rotations;
+  size_t inserts, finds;
+  size_t insert_depth[RBTREE_STATS_DEPTHS];  // 삽입 위치를 찾으며 지나간 노드 수별 횟수 (hint 옆에 바로 붙이면 0)
+  size_t find_depth[RBTREE_STATS_DEPTHS];    // rbtree_find가 비교한 노드 수별 횟수
+  int black_height;  // rbtree_stats가 채우는 지금 트리의 검은 높이 (nil 제외)
+} rbtree_stats_t;
+#endif
+
 typedef struct {
   node_t *root;
   node_t *nil;  // for sentinel
+  node_pool_t *pool;
+  node_t *leftmost, *rightmost;  // 최소/최대 노드 (비어있으면 nil). rbtree_min/max를 O(1)로 만든다
+#if RBTREE_STATS
+  rbtree_stats_t stats;  // 읽기 함수도 세므로 const 트리에서도 바뀐다. 여러 스레드가 동시에 읽으면 근사치
+#endif
 } rbtree;
 
+// node_t를 멤버로 가진 호출자의 구조체를 노드 포인터로부터 구하는 매크로.
+// 예) struct record { int id; node_t node; }; ... rbtree_container_of(p, struct record, node)->id
+#define rbtree_container_of(node, type, member) \
+  ((type *)((char *)(node) - offsetof(type, member)))
+
+// [lo, hi) 범위를 할당 없이 순서대로 훑기 위한 커서
+typedef struct {
+  const rbtree *tree;
+  node_t *node;  // 다음에 돌려줄 노드, 범위가 끝났으면 NULL
+  key_t hi;
+} rbtree_cursor;
+
 rbtree *new_rbtree(void);
+rbtree *new_rbtree_with_allocator(node_pool_t *);
+rbtree *rbtree_from_sorted_array(const key_t *, const size_t);
+rbtree *new_rbtree_intrusive(void);
 void delete_rbtree(rbtree *);
 
+node_pool_t *new_node_pool(const size_t);
+void delete_node_pool(node_pool_t *);
+
 node_t *rbtree_insert(rbtree *, const key_t);
+node_t *rbtree_insert_hint(rbtree *, node_t *, const key_t);
+int rbtree_insert_node(rbtree *, node_t *);
+int rbtree_insert_batch(rbtree *, const key_t *, const size_t);
 node_t *rbtree_find(const rbtree *, const key_t);
+void rbtree_find_many(const rbtree *, const key_t *, const size_t, node_t **);
 node_t *rbtree_min(const rbtree *);
 node_t *rbtree_max(const rbtree *);
 int rbtree_erase(rbtree *, node_t *);
+int rbtree_pop_min(rbtree *, key_t *);
+int rbtree_pop_max(rbtree *, key_t *);
+size_t rbtree_erase_range(rbtree *, const key_t, const key_t);
+size_t rbtree_truncate_below(rbtree *, const key_t);
+
+node_t *rbtree_lower_bound(const rbtree *, const key_t);
+node_t *rbtree_upper_bound(const rbtree *, const key_t);
+void rbtree_equal_range(const rbtree *, const key_t, node_t **, node_t **);
+size_t rbtree_count(const rbtree *, const key_t);
+
+#if RBTREE_ORDER_STATS
+size_t rbtree_size(const rbtree *);
+node_t *rbtree_select(const rbtree *, size_t);
+size_t rbtree_rank(const rbtree *, const key_t);
+#endif
+
+node_t *rbtree_next(const rbtree *, const node_t *);
+node_t *rbtree_prev(const rbtree *, const node_t *);
+void rbtree_range(const rbtree *, rbtree_cursor *, const key_t, const key_t);
+node_t *rbtree_cursor_next(rbtree_cursor *);
+
+size_t rbtree_to_array(const rbtree *, key_t *, const size_t);
+
+#if RBTREE_STATS
+void rbtree_stats(const rbtree *, rbtree_stats_t *);
+void rbtree_stats_reset(rbtree *);
+#endif
 
-int rbtree_to_array(const rbtree *, key_t *, const size_t);
+// rbtree_join과 rbtree_union은 t2의 노드를 t1으로 옮기므로 두 트리가 같은 풀을 써야 O(log N)
+// (union은 O(m log(n/m + 1)))이다. new_rbtree()로 만든 트리들은 풀이 각각 다르므로, 이때는 작은 쪽의 키들을
+// 먼저 다른 쪽 풀의 새 노드로 O(N)에 복사하고 그 트리의 노드를 가리키던 node_t 포인터는 모두 무효가 된다.
+// 같은 풀의 트리끼리는 (new_rbtree_with_allocator) 노드를 그대로 옮기므로 포인터가 계속 유효하다.
+// intersection/difference는 t2를 읽기만 하므로 풀이 달라도 복사하지 않는다.
+int rbtree_join(rbtree *, const key_t, rbtree *);
+int rbtree_split(rbtree *, const key_t, rbtree **, rbtree **);
+int rbtree_union(rbtree *, rbtree *);
+int rbtree_intersection(rbtree *, const rbtree *);
+int rbtree_difference(rbtree *, const rbtree *);
 
 #endif  // _RBTREE_H_
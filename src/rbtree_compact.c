@@ -0,0 +1,746 @@
+#include "rbtree_compact.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+//노드 배열의 초기 크기와 인덱스로 표현할 수 있는 최대 노드 수 (최상위 비트는 색으로 사용)
+#define COMPACT_INITIAL_CAP 64
+#define COMPACT_MAX_NODES 0x7fffffffu
+#define COLOR_BIT 0x80000000u
+
+//레드-블랙 트리의 높이는 2 * log2(N + 1)을 넘지 않는다
+#define COMPACT_MAX_HEIGHT 64
+
+//인덱스로 노드에 접근하는 매크로. 배열이 재할당될 수 있으므로 노드 포인터를 오래 들고 있지 않는다.
+#define N(i) (t->nodes[i])
+
+static inline node_idx_t parent_of(const rbtree_compact *t, node_idx_t i) {
+  return N(i).parent_color & ~COLOR_BIT;
+}
+
+static inline void set_parent(rbtree_compact *t, node_idx_t i, node_idx_t p) {
+  N(i).parent_color = (N(i).parent_color & COLOR_BIT) | p;
+}
+
+static inline int is_red(const rbtree_compact *t, node_idx_t i) {
+  return !(N(i).parent_color & COLOR_BIT);
+}
+
+static inline void set_color(rbtree_compact *t, node_idx_t i, color_t color) {
+  N(i).parent_color = (N(i).parent_color & ~COLOR_BIT) | ((uint32_t)color << 31);
+}
+
+//새로운 컴팩트 레드-블랙 트리를 생성하고 초기화 하는 함수.
+rbtree_compact *new_rbtree_compact(void) {
+  rbtree_compact *t = (rbtree_compact *)calloc(1, sizeof(rbtree_compact));
+  if(t == NULL){
+    return NULL;
+  }
+
+  //nodes[0]을 검은색 nil 노드로 사용
+  t->nodes = (compact_node_t *)calloc(COMPACT_INITIAL_CAP, sizeof(compact_node_t));
+  if(t->nodes == NULL){
+    free(t);
+    return NULL;
+  }
+  t->cap = COMPACT_INITIAL_CAP;
+  t->used = 1;
+  t->root = RBTREE_COMPACT_NIL;
+  t->free_list = RBTREE_COMPACT_NIL;
+  set_color(t, RBTREE_COMPACT_NIL, RBTREE_BLACK);
+  return t;
+}
+
+//노드 배열 하나만 해제하면 되므로 노드를 순회할 필요가 없다
+void delete_rbtree_compact(rbtree_compact *t) {
+  if(t->map != NULL){
+    munmap(t->map, t->map_len);
+  }
+  else free(t->nodes);
+  free(t);
+}
+
+//노드 하나를 할당해서 인덱스를 반환하는 함수. 실패하면 nil 반환
+static node_idx_t alloc_node(rbtree_compact *t) {
+  //반환된 노드가 있으면 재사용
+  node_idx_t i = t->free_list;
+  if(i != RBTREE_COMPACT_NIL){
+    t->free_list = N(i).left;
+    return i;
+  }
+
+  //배열이 가득 찼으면 두 배로 늘림
+  if(t->used == t->cap){
+    if(t->cap > COMPACT_MAX_NODES / 2){
+      return RBTREE_COMPACT_NIL;
+    }
+    compact_node_t *nodes;
+    if(t->map != NULL){
+      //파일을 매핑한 배열은 늘릴 수 없으므로 처음으로 커질 때 heap으로 복사하고 매핑을 해제
+      nodes = (compact_node_t *)malloc(2 * (size_t)t->cap * sizeof(compact_node_t));
+      if(nodes == NULL){
+        return RBTREE_COMPACT_NIL;
+      }
+      memcpy(nodes, t->nodes, (size_t)t->used * sizeof(compact_node_t));
+      munmap(t->map, t->map_len);
+      t->map = NULL;
+      t->map_len = 0;
+    }
+    else {
+      nodes = (compact_node_t *)realloc(t->nodes, 2 * (size_t)t->cap * sizeof(compact_node_t));
+      if(nodes == NULL){
+        return RBTREE_COMPACT_NIL;
+      }
+    }
+    t->nodes = nodes;
+    t->cap *= 2;
+  }
+  return t->used++;
+}
+
+//왼쪽으로 회전하는 함수
+static void left_rotate(rbtree_compact *t, node_idx_t x) {
+  node_idx_t y = N(x).right;
+  node_idx_t xp = parent_of(t, x);
+
+  //y의 왼쪽 서브 트리를 x의 오른쪽 서브 트리로 이동
+  N(x).right = N(y).left;
+  if(N(y).left != RBTREE_COMPACT_NIL){
+    set_parent(t, N(y).left, x);
+  }
+
+  //y를 x의 자리로 올림
+  set_parent(t, y, xp);
+  if(xp == RBTREE_COMPACT_NIL){
+    t->root = y;
+  }
+  else if(x == N(xp).left){
+    N(xp).left = y;
+  }
+  else N(xp).right = y;
+
+  N(y).left = x;
+  set_parent(t, x, y);
+}
+
+//오른쪽으로 회전하는 함수. 왼쪽 회전과 대칭적으로 동일
+static void right_rotate(rbtree_compact *t, node_idx_t x) {
+  node_idx_t y = N(x).left;
+  node_idx_t xp = parent_of(t, x);
+
+  N(x).left = N(y).right;
+  if(N(y).right != RBTREE_COMPACT_NIL){
+    set_parent(t, N(y).right, x);
+  }
+
+  set_parent(t, y, xp);
+  if(xp == RBTREE_COMPACT_NIL){
+    t->root = y;
+  }
+  else if(x == N(xp).right){
+    N(xp).right = y;
+  }
+  else N(xp).left = y;
+
+  N(y).right = x;
+  set_parent(t, x, y);
+}
+
+//삽입 후 RB 속성을 복구하는 함수. rbtree.c의 rbtree_insert_fixup과 같은 경우 분류를 따른다.
+static void insert_fixup(rbtree_compact *t, node_idx_t z) {
+  while(is_red(t, parent_of(t, z))){
+    node_idx_t p = parent_of(t, z);
+    node_idx_t g = parent_of(t, p);
+    if(p == N(g).left){
+      node_idx_t y = N(g).right;
+      //삼촌이 빨강이면 색만 바꾸고 조부모로 이동
+      if(is_red(t, y)){
+        set_color(t, p, RBTREE_BLACK);
+        set_color(t, y, RBTREE_BLACK);
+        set_color(t, g, RBTREE_RED);
+        z = g;
+      }
+      else {
+        //z가 오른쪽 자식이면 부모에서 왼쪽 회전해서 일직선으로 만듦
+        if(z == N(p).right){
+          z = p;
+          left_rotate(t, z);
+          p = parent_of(t, z);
+        }
+        set_color(t, p, RBTREE_BLACK);
+        set_color(t, g, RBTREE_RED);
+        right_rotate(t, g);
+      }
+    }
+    else {
+      node_idx_t y = N(g).left;
+      if(is_red(t, y)){
+        set_color(t, p, RBTREE_BLACK);
+        set_color(t, y, RBTREE_BLACK);
+        set_color(t, g, RBTREE_RED);
+        z = g;
+      }
+      else {
+        if(z == N(p).left){
+          z = p;
+          right_rotate(t, z);
+          p = parent_of(t, z);
+        }
+        set_color(t, p, RBTREE_BLACK);
+        set_color(t, g, RBTREE_RED);
+        left_rotate(t, g);
+      }
+    }
+  }
+  set_color(t, t->root, RBTREE_BLACK);
+}
+
+//새 키를 삽입하고 새 노드의 인덱스를 반환하는 함수. 실패하면 nil 반환
+node_idx_t rbtree_compact_insert(rbtree_compact *t, const key_t key) {
+  //배열이 재할당될 수 있으므로 탐색 전에 먼저 할당
+  node_idx_t z = alloc_node(t);
+  if(z == RBTREE_COMPACT_NIL){
+    return RBTREE_COMPACT_NIL;
+  }
+
+  node_idx_t y = RBTREE_COMPACT_NIL;
+  node_idx_t x = t->root;
+  while(x != RBTREE_COMPACT_NIL){
+    y = x;
+    x = key < N(x).key ? N(x).left : N(x).right;
+  }
+
+  //빨간색 잎으로 연결
+  N(z).key = key;
+  N(z).left = RBTREE_COMPACT_NIL;
+  N(z).right = RBTREE_COMPACT_NIL;
+  N(z).parent_color = y;
+  if(y == RBTREE_COMPACT_NIL){
+    t->root = z;
+  }
+  else if(key < N(y).key){
+    N(y).left = z;
+  }
+  else N(y).right = z;
+
+  insert_fixup(t, z);
+  t->count++;
+  return z;
+}
+
+//주어진 키값을 가진 노드를 찾는 함수. 없으면 nil 반환
+node_idx_t rbtree_compact_find(const rbtree_compact *t, const key_t key) {
+  const compact_node_t *nodes = t->nodes;
+  node_idx_t x = t->root;
+  while(x != RBTREE_COMPACT_NIL){
+    if(nodes[x].key == key){
+      return x;
+    }
+    x = key < nodes[x].key ? nodes[x].left : nodes[x].right;
+  }
+  return RBTREE_COMPACT_NIL;
+}
+
+//키가 key 이상인 첫 노드를 찾는 함수. 없으면 nil 반환
+node_idx_t rbtree_compact_lower_bound(const rbtree_compact *t, const key_t key) {
+  node_idx_t x = t->root;
+  node_idx_t found = RBTREE_COMPACT_NIL;
+  while(x != RBTREE_COMPACT_NIL){
+    if(!(N(x).key < key)){
+      found = x;
+      x = N(x).left;
+    }
+    else x = N(x).right;
+  }
+  return found;
+}
+
+static node_idx_t sub_min(const rbtree_compact *t, node_idx_t x) {
+  while(N(x).left != RBTREE_COMPACT_NIL){
+    x = N(x).left;
+  }
+  return x;
+}
+
+static node_idx_t sub_max(const rbtree_compact *t, node_idx_t x) {
+  while(N(x).right != RBTREE_COMPACT_NIL){
+    x = N(x).right;
+  }
+  return x;
+}
+
+node_idx_t rbtree_compact_min(const rbtree_compact *t) {
+  return t->root == RBTREE_COMPACT_NIL ? RBTREE_COMPACT_NIL : sub_min(t, t->root);
+}
+
+node_idx_t rbtree_compact_max(const rbtree_compact *t) {
+  return t->root == RBTREE_COMPACT_NIL ? RBTREE_COMPACT_NIL : sub_max(t, t->root);
+}
+
+//중위 순회에서 다음 노드를 반환하는 함수. 마지막이면 nil 반환
+node_idx_t rbtree_compact_next(const rbtree_compact *t, node_idx_t x) {
+  if(N(x).right != RBTREE_COMPACT_NIL){
+    return sub_min(t, N(x).right);
+  }
+  node_idx_t p = parent_of(t, x);
+  while(p != RBTREE_COMPACT_NIL && x == N(p).right){
+    x = p;
+    p = parent_of(t, p);
+  }
+  return p;
+}
+
+//중위 순회에서 이전 노드를 반환하는 함수. 처음이면 nil 반환
+node_idx_t rbtree_compact_prev(const rbtree_compact *t, node_idx_t x) {
+  if(N(x).left != RBTREE_COMPACT_NIL){
+    return sub_max(t, N(x).left);
+  }
+  node_idx_t p = parent_of(t, x);
+  while(p != RBTREE_COMPACT_NIL && x == N(p).left){
+    x = p;
+    p = parent_of(t, p);
+  }
+  return p;
+}
+
+//u 자리에 v를 옮겨 다는 함수. v가 nil이어도 부모를 기록한다 (delete_fixup에서 사용)
+static void transplant(rbtree_compact *t, node_idx_t u, node_idx_t v) {
+  node_idx_t up = parent_of(t, u);
+  if(up == RBTREE_COMPACT_NIL){
+    t->root = v;
+  }
+  else if(u == N(up).left){
+    N(up).left = v;
+  }
+  else N(up).right = v;
+  set_parent(t, v, up);
+}
+
+//삭제 후 RB 속성을 복구하는 함수. rbtree.c의 rbtree_delete_fixup과 같은 경우 분류를 따른다.
+static void delete_fixup(rbtree_compact *t, node_idx_t x) {
+  while(x != t->root && !is_red(t, x)){
+    node_idx_t xp = parent_of(t, x);
+    if(x == N(xp).left){
+      node_idx_t w = N(xp).right;
+      //case 1: 형제가 빨강
+      if(is_red(t, w)){
+        set_color(t, w, RBTREE_BLACK);
+        set_color(t, xp, RBTREE_RED);
+        left_rotate(t, xp);
+        w = N(xp).right;
+      }
+      //case 2: 형제의 두 자식이 모두 검정
+      if(!is_red(t, N(w).left) && !is_red(t, N(w).right)){
+        set_color(t, w, RBTREE_RED);
+        x = xp;
+      }
+      else {
+        //case 3: 형제의 오른쪽 자식만 검정
+        if(!is_red(t, N(w).right)){
+          set_color(t, N(w).left, RBTREE_BLACK);
+          set_color(t, w, RBTREE_RED);
+          right_rotate(t, w);
+          w = N(xp).right;
+        }
+        //case 4
+        set_color(t, w, rbtree_compact_color(t, xp));
+        set_color(t, xp, RBTREE_BLACK);
+        set_color(t, N(w).right, RBTREE_BLACK);
+        left_rotate(t, xp);
+        x = t->root;
+      }
+    }
+    else {
+      node_idx_t w = N(xp).left;
+      if(is_red(t, w)){
+        set_color(t, w, RBTREE_BLACK);
+        set_color(t, xp, RBTREE_RED);
+        right_rotate(t, xp);
+        w = N(xp).left;
+      }
+      if(!is_red(t, N(w).left) && !is_red(t, N(w).right)){
+        set_color(t, w, RBTREE_RED);
+        x = xp;
+      }
+      else {
+        if(!is_red(t, N(w).left)){
+          set_color(t, N(w).right, RBTREE_BLACK);
+          set_color(t, w, RBTREE_RED);
+          left_rotate(t, w);
+          w = N(xp).left;
+        }
+        set_color(t, w, rbtree_compact_color(t, xp));
+        set_color(t, xp, RBTREE_BLACK);
+        set_color(t, N(w).left, RBTREE_BLACK);
+        right_rotate(t, xp);
+        x = t->root;
+      }
+    }
+  }
+  set_color(t, x, RBTREE_BLACK);
+}
+
+//노드 p를 삭제하고 배열의 free list로 반환하는 함수
+int rbtree_compact_erase(rbtree_compact *t, node_idx_t p) {
+  node_idx_t y = p;
+  int removed_black = !is_red(t, y);
+  node_idx_t x;
+
+  if(N(p).left == RBTREE_COMPACT_NIL){
+    x = N(p).right;
+    transplant(t, p, x);
+  }
+  else if(N(p).right == RBTREE_COMPACT_NIL){
+    x = N(p).left;
+    transplant(t, p, x);
+  }
+  else {
+    //두 자식이 모두 있으면 후계자 y가 p의 자리를 차지
+    y = sub_min(t, N(p).right);
+    removed_black = !is_red(t, y);
+    x = N(y).right;
+    if(parent_of(t, y) == p){
+      set_parent(t, x, y);
+    }
+    else {
+      transplant(t, y, x);
+      N(y).right = N(p).right;
+      set_parent(t, N(y).right, y);
+    }
+    transplant(t, p, y);
+    N(y).left = N(p).left;
+    set_parent(t, N(y).left, y);
+    set_color(t, y, rbtree_compact_color(t, p));
+  }
+
+  if(removed_black){
+    delete_fixup(t, x);
+  }
+
+  N(p).left = t->free_list;
+  t->free_list = p;
+  t->count--;
+  return 0;
+}
+
+//키를 작은 순서대로 최대 n개까지 배열에 저장하고 저장한 개수를 반환하는 함수
+size_t rbtree_compact_to_array(const rbtree_compact *t, key_t *arr, const size_t n) {
+  if(arr == NULL){
+    return 0;
+  }
+
+  node_idx_t stack[COMPACT_MAX_HEIGHT];
+  int top = 0;
+  size_t index = 0;
+  node_idx_t x = t->root;
+
+  while(index < n){
+    while(x != RBTREE_COMPACT_NIL){
+      //검사하지 않고 연 파일이 망가져 있어도 스택 밖에 쓰지 않도록 높이 상한에서 멈춘다
+      if(top == COMPACT_MAX_HEIGHT){
+        return index;
+      }
+      stack[top++] = x;
+      x = N(x).left;
+    }
+    if(top == 0){
+      break;
+    }
+    x = stack[--top];
+    arr[index++] = N(x).key;
+    x = N(x).right;
+  }
+  return index;
+}
+
+//파일 형식: 64바이트 헤더 뒤에 nodes[0, used)가 그대로 이어진다.
+//노드는 포인터 대신 배열 인덱스로 연결되므로 파일을 어느 주소에 매핑해도 바로 탐색할 수 있다.
+//정수는 저장한 기계의 바이트 순서를 따르며, 다른 바이트 순서나 노드 형식의 파일은 열지 않는다.
+#define COMPACT_FILE_MAGIC "RBTCMPCT"
+#define COMPACT_FILE_VERSION 1
+#define COMPACT_FILE_BYTE_ORDER 0x01020304u
+
+typedef struct {
+  char magic[8];
+  uint32_t version;
+  uint32_t byte_order;
+  uint32_t node_size;       //sizeof(compact_node_t)
+  uint32_t key_size;        //sizeof(key_t)
+  uint32_t root;
+  uint32_t free_list;
+  uint32_t used;
+  uint32_t reserved;
+  uint64_t count;
+  uint64_t nodes_checksum;  //nodes[0, used)의 체크섬
+  uint64_t header_checksum; //이 필드 앞까지의 헤더 체크섬
+} compact_file_header;
+
+_Static_assert(sizeof(compact_file_header) == 64, "compact file header must stay 64 bytes");
+
+//8바이트 단위로 섞는 FNV-1a 변형 체크섬. 노드는 16바이트이므로 길이는 항상 8의 배수이다.
+static uint64_t checksum(const void *data, const size_t len) {
+  const unsigned char *p = (const unsigned char *)data;
+  uint64_t h = 0xcbf29ce484222325ull;
+  for(size_t i = 0; i + 8 <= len; i += 8){
+    uint64_t w;
+    memcpy(&w, p + i, 8);
+    h = (h ^ w) * 0x100000001b3ull;
+    h ^= h >> 29;
+  }
+  return h;
+}
+
+//헤더와 노드 배열을 path에 쓰는 함수. 같은 디렉터리의 임시 파일에 다 쓴 뒤 이름을 바꾸므로
+//도중에 실패하거나 중단되어도 예전 파일이 그대로 남는다. 실패하면 -1 반환
+static int write_file(const char *path, const compact_node_t *nodes, const uint32_t used,
+                      const node_idx_t root, const node_idx_t free_list, const size_t count) {
+  compact_file_header h;
+  memset(&h, 0, sizeof(h));
+  memcpy(h.magic, COMPACT_FILE_MAGIC, sizeof(h.magic));
+  h.version = COMPACT_FILE_VERSION;
+  h.byte_order = COMPACT_FILE_BYTE_ORDER;
+  h.node_size = sizeof(compact_node_t);
+  h.key_size = sizeof(key_t);
+  h.root = root;
+  h.free_list = free_list;
+  h.used = used;
+  h.count = count;
+  h.nodes_checksum = checksum(nodes, (size_t)used * sizeof(compact_node_t));
+  h.header_checksum = checksum(&h, offsetof(compact_file_header, header_checksum));
+
+  const size_t len = strlen(path);
+  char *tmp = (char *)malloc(len + 5);
+  if(tmp == NULL){
+    return -1;
+  }
+  memcpy(tmp, path, len);
+  memcpy(tmp + len, ".tmp", 5);
+
+  FILE *f = fopen(tmp, "wb");
+  int ok = f != NULL;
+  ok = ok && fwrite(&h, sizeof(h), 1, f) == 1;
+  ok = ok && fwrite(nodes, sizeof(compact_node_t), used, f) == used;
+  ok = ok && fflush(f) == 0 && fsync(fileno(f)) == 0;
+  if(f != NULL && fclose(f) != 0){
+    ok = 0;
+  }
+  ok = ok && rename(tmp, path) == 0;
+  if(!ok){
+    remove(tmp);
+  }
+  free(tmp);
+  return ok ? 0 : -1;
+}
+
+//컴팩트 트리를 path에 저장하는 함수. 반환된 노드의 자리도 그대로 저장되므로 O(used)이다. 실패하면 -1 반환
+int rbtree_compact_save(const rbtree_compact *t, const char *path) {
+  return write_file(path, t->nodes, t->used, t->root, t->free_list, t->count);
+}
+
+//정렬된 arr[lo, hi)로 완전 균형 서브 트리를 만드는 함수. arr[i]의 노드는 nodes[i + 1]에 둔다.
+//rbtree.c의 build_sorted와 같이 가장 깊은 층만 빨강으로 칠한다.
+static node_idx_t build_sorted(compact_node_t *nodes, const key_t *arr, size_t lo, size_t hi,
+                               node_idx_t parent, int depth, int red_depth) {
+  if(lo == hi){
+    return RBTREE_COMPACT_NIL;
+  }
+  size_t mid = lo + (hi - lo) / 2;
+  node_idx_t i = (node_idx_t)(mid + 1);
+  nodes[i].key = arr[mid];
+  nodes[i].parent_color = parent | (depth == red_depth ? 0 : COLOR_BIT);
+  nodes[i].left = build_sorted(nodes, arr, lo, mid, i, depth + 1, red_depth);
+  nodes[i].right = build_sorted(nodes, arr, mid + 1, hi, i, depth + 1, red_depth);
+  return i;
+}
+
+//포인터로 연결된 RB 트리를 컴팩트 파일 형식으로 저장하는 함수.
+//키들을 중위 순서대로 배열에 두고 완전 균형 트리로 연결하므로 열었을 때 순회가 메모리 순서와 같다.
+//실패하면 -1 반환
+int rbtree_save(const rbtree *t, const char *path) {
+#if RBTREE_ORDER_STATS
+  const size_t n = rbtree_size(t);
+#else
+  size_t n = 0;
+  for(node_t *p = rbtree_min(t); p != NULL; p = rbtree_next(t, p)){
+    n++;
+  }
+#endif
+  if(n >= COMPACT_MAX_NODES){
+    return -1;
+  }
+
+  key_t *arr = (key_t *)malloc((n ? n : 1) * sizeof(key_t));
+  compact_node_t *nodes = (compact_node_t *)calloc(n + 1, sizeof(compact_node_t));
+  int ret = -1;
+  if(arr != NULL && nodes != NULL){
+    rbtree_to_array(t, arr, n);
+    int red_depth = 0;
+    while(((size_t)2 << red_depth) <= n){
+      red_depth++;
+    }
+    if(red_depth == 0){
+      red_depth = -1;
+    }
+    nodes[RBTREE_COMPACT_NIL].parent_color = COLOR_BIT;
+    node_idx_t root = build_sorted(nodes, arr, 0, n, RBTREE_COMPACT_NIL, 0, red_depth);
+    ret = write_file(path, nodes, (uint32_t)(n + 1), root, RBTREE_COMPACT_NIL, n);
+  }
+  free(nodes);
+  free(arr);
+  return ret;
+}
+
+//모든 노드의 인덱스가 배열 안을 가리키는지 확인하는 함수
+static int indices_valid(const compact_node_t *nodes, const uint32_t used) {
+  for(uint32_t i = 0; i < used; i++){
+    if(nodes[i].left >= used || nodes[i].right >= used ||
+       (nodes[i].parent_color & ~COLOR_BIT) >= used){
+      return 0;
+    }
+  }
+  return 1;
+}
+
+//x의 자식 c가 x를 부모로 가리키고, x가 빨강이면 c는 검은색인지 확인하는 함수
+static int child_valid(const compact_node_t *nodes, const node_idx_t x, const node_idx_t c) {
+  if(c == RBTREE_COMPACT_NIL){
+    return 1;
+  }
+  const int x_red = !(nodes[x].parent_color & COLOR_BIT);
+  const int c_red = !(nodes[c].parent_color & COLOR_BIT);
+  return (nodes[c].parent_color & ~COLOR_BIT) == x && !(x_red && c_red);
+}
+
+//인덱스가 모두 배열 안을 가리키는 노드 배열이 올바른 RB 트리인지 확인하는 함수.
+//루트부터 중위 순회하며 깊이가 COMPACT_MAX_HEIGHT를 넘지 않는지, 같은 노드를 두 번 만나지 않는지 (순환),
+//부모 링크, 빨강-빨강, 모든 잎까지의 검은 노드 수, 키 순서를 확인한다.
+//그 뒤 free list도 따라가서 모든 노드가 트리와 free list 중 정확히 한 곳에 있고 트리의 노드 수가 count인지 본다.
+static int tree_valid(const compact_node_t *nodes, const uint32_t used, const node_idx_t root,
+                      const node_idx_t free_list, const uint64_t count) {
+  if(nodes[RBTREE_COMPACT_NIL].parent_color < COLOR_BIT){
+    return 0;
+  }
+  if(root != RBTREE_COMPACT_NIL && nodes[root].parent_color != COLOR_BIT){
+    return 0;
+  }
+  unsigned char *seen = (unsigned char *)calloc(used, 1);
+  if(seen == NULL){
+    return 0;
+  }
+  seen[RBTREE_COMPACT_NIL] = 1;
+
+  node_idx_t stack[COMPACT_MAX_HEIGHT];
+  int blacks[COMPACT_MAX_HEIGHT];  //루트부터 stack[i]까지의 검은 노드 수
+  int top = 0;
+  int b = 0;
+  int leaf_blacks = -1;
+  uint64_t visited = 0;
+  key_t prev = 0;
+  int ok = 1;
+  node_idx_t x = root;
+
+  while(ok){
+    //왼쪽 끝까지 내려가면서 지나온 노드를 스택에 쌓음
+    while(ok && x != RBTREE_COMPACT_NIL){
+      if(top == COMPACT_MAX_HEIGHT || seen[x] || !child_valid(nodes, x, nodes[x].left)){
+        ok = 0;
+        break;
+      }
+      seen[x] = 1;
+      b += (nodes[x].parent_color & COLOR_BIT) != 0;
+      stack[top] = x;
+      blacks[top++] = b;
+      x = nodes[x].left;
+    }
+    //nil 자리마다 검은 노드 수가 같아야 한다
+    if(leaf_blacks < 0){
+      leaf_blacks = b;
+    }
+    if(!ok || b != leaf_blacks || top == 0){
+      ok = ok && b == leaf_blacks;
+      break;
+    }
+    x = stack[--top];
+    b = blacks[top];
+    if((visited > 0 && nodes[x].key < prev) || !child_valid(nodes, x, nodes[x].right)){
+      ok = 0;
+      break;
+    }
+    prev = nodes[x].key;
+    visited++;
+    x = nodes[x].right;
+  }
+
+  //free list는 left로 연결되며 트리의 노드나 자기 자신으로 돌아오면 안 된다
+  uint64_t freed = 0;
+  for(x = free_list; ok && x != RBTREE_COMPACT_NIL; x = nodes[x].left){
+    if(seen[x]){
+      ok = 0;
+    }
+    seen[x] = 1;
+    freed++;
+  }
+  free(seen);
+  return ok && visited == count && visited + freed == (uint64_t)used - 1;
+}
+
+//저장된 파일을 읽지 않고 mmap해서 바로 탐색할 수 있는 컴팩트 트리를 반환하는 함수.
+//헤더는 항상 확인하고, verify가 0이 아니면 노드 배열 전체의 체크섬과 인덱스 범위, 그리고 노드들이
+//순환 없이 깊이가 제한된 올바른 RB 트리를 이루는지도 확인한다 (O(N)). verify가 0이면 파일을 믿으므로
+//신뢰할 수 없는 파일은 verify를 주고 열어야 한다. 아니면 망가진 파일에서 탐색이 끝나지 않을 수 있다.
+//매핑은 MAP_PRIVATE이므로 삽입/삭제가 고치는 페이지만 커널이 복사하고 파일은 바뀌지 않으며,
+//배열이 커져야 하면 그때 heap으로 옮긴다. 파일을 열 수 없거나 형식이 맞지 않으면 NULL 반환
+rbtree_compact *rbtree_compact_open_mmap(const char *path, const int verify) {
+  int fd = open(path, O_RDONLY);
+  if(fd < 0){
+    return NULL;
+  }
+  struct stat st;
+  void *map = MAP_FAILED;
+  size_t len = 0;
+  if(fstat(fd, &st) == 0 && (size_t)st.st_size >= sizeof(compact_file_header)){
+    len = (size_t)st.st_size;
+    map = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  }
+  //매핑은 파일을 닫아도 유지된다
+  close(fd);
+  if(map == MAP_FAILED){
+    return NULL;
+  }
+
+  const compact_file_header *h = (const compact_file_header *)map;
+  const compact_node_t *nodes = (const compact_node_t *)((char *)map + sizeof(compact_file_header));
+  int ok = memcmp(h->magic, COMPACT_FILE_MAGIC, sizeof(h->magic)) == 0 &&
+           h->header_checksum == checksum(h, offsetof(compact_file_header, header_checksum)) &&
+           h->version == COMPACT_FILE_VERSION &&
+           h->byte_order == COMPACT_FILE_BYTE_ORDER &&
+           h->node_size == sizeof(compact_node_t) && h->key_size == sizeof(key_t) &&
+           h->used >= 1 && h->used <= COMPACT_MAX_NODES &&
+           len == sizeof(compact_file_header) + (size_t)h->used * sizeof(compact_node_t) &&
+           h->root < h->used && h->free_list < h->used;
+  if(ok && verify){
+    ok = checksum(nodes, (size_t)h->used * sizeof(compact_node_t)) == h->nodes_checksum &&
+         indices_valid(nodes, h->used) &&
+         tree_valid(nodes, h->used, h->root, h->free_list, h->count);
+  }
+
+  rbtree_compact *t = ok ? (rbtree_compact *)calloc(1, sizeof(rbtree_compact)) : NULL;
+  if(t == NULL){
+    munmap(map, len);
+    return NULL;
+  }
+  t->nodes = (compact_node_t *)nodes;
+  t->root = h->root;
+  t->free_list = h->free_list;
+  t->used = h->used;
+  t->cap = h->used;
+  t->count = h->count;
+  t->map = map;
+  t->map_len = len;
+  return t;
+}
@@ -0,0 +1,60 @@
+#ifndef _RBTREE_COMPACT_H_
+#define _RBTREE_COMPACT_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "rbtree.h"
+
+// 노드 배열 안의 위치로 노드를 가리키는 32비트 인덱스. 0은 nil 노드다.
+typedef uint32_t node_idx_t;
+
+#define RBTREE_COMPACT_NIL 0
+
+// 16바이트 노드: 포인터 대신 인덱스로 연결하고, 색은 부모 인덱스의 최상위 비트에 저장
+typedef struct {
+  key_t key;
+  node_idx_t left, right;
+  uint32_t parent_color;  // 하위 31비트: 부모 인덱스, 최상위 비트: 색 (1이면 검은색)
+} compact_node_t;
+
+typedef struct {
+  compact_node_t *nodes;  // nodes[0]은 nil 노드
+  node_idx_t root;
+  node_idx_t free_list;   // 반환된 노드들 (left로 연결)
+  uint32_t used;          // 한 번이라도 사용된 노드 수 (nil 포함)
+  uint32_t cap;
+  size_t count;
+  void *map;              // nodes가 파일을 매핑한 메모리 안에 있으면 매핑의 시작 (heap이면 NULL)
+  size_t map_len;
+} rbtree_compact;
+
+rbtree_compact *new_rbtree_compact(void);
+void delete_rbtree_compact(rbtree_compact *);
+
+node_idx_t rbtree_compact_insert(rbtree_compact *, const key_t);
+node_idx_t rbtree_compact_find(const rbtree_compact *, const key_t);
+node_idx_t rbtree_compact_lower_bound(const rbtree_compact *, const key_t);
+node_idx_t rbtree_compact_min(const rbtree_compact *);
+node_idx_t rbtree_compact_max(const rbtree_compact *);
+node_idx_t rbtree_compact_next(const rbtree_compact *, node_idx_t);
+node_idx_t rbtree_compact_prev(const rbtree_compact *, node_idx_t);
+int rbtree_compact_erase(rbtree_compact *, node_idx_t);
+
+size_t rbtree_compact_to_array(const rbtree_compact *, key_t *, const size_t);
+
+int rbtree_compact_save(const rbtree_compact *, const char *);
+int rbtree_save(const rbtree *, const char *);
+rbtree_compact *rbtree_compact_open_mmap(const char *, const int);
+
+// 인덱스가 가리키는 노드의 키와 색
+static inline key_t rbtree_compact_key(const rbtree_compact *t, node_idx_t i) {
+  return t->nodes[i].key;
+}
+
+static inline color_t rbtree_compact_color(const rbtree_compact *t,
+                                           node_idx_t i) {
+  return (color_t)(t->nodes[i].parent_color >> 31);
+}
+
+#endif  // _RBTREE_COMPACT_H_
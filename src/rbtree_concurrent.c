@@ -0,0 +1,276 @@
+#include "rbtree_concurrent.h"
+
+#include <sched.h>
+#include <stdlib.h>
+
+//레드-블랙 트리의 높이 상한 (rbtree.c의 RBTREE_MAX_HEIGHT와 같다).
+//읽는 도중 트리가 바뀌면 순환하는 경로를 만날 수 있으므로 이보다 깊이 내려가면 실패로 본다.
+#define CONCURRENT_MAX_HEIGHT 128
+
+//잠금 없이 시도할 횟수. 모두 실패하면 쓰기 잠금을 잡고 읽어서 진행을 보장한다.
+#define OPTIMISTIC_TRIES 8
+
+//reader는 writer와 동시에 같은 필드를 읽으므로 필드를 한 번에 읽는다.
+//writer 쪽 (rbtree_insert, rbtree_erase)은 rbtree.c에서 같은 필드를 STORE로 쓴다.
+#define READ(field) __atomic_load_n(&(field), __ATOMIC_RELAXED)
+
+rbtree_concurrent *new_rbtree_concurrent(void) {
+  rbtree_concurrent *c = (rbtree_concurrent *)calloc(1, sizeof(rbtree_concurrent));
+  if(c == NULL){
+    return NULL;
+  }
+  //전용 풀을 써야 삭제된 node가 다른 트리로 넘어가지 않는다
+  c->tree = new_rbtree();
+  if(c->tree == NULL){
+    free(c);
+    return NULL;
+  }
+  pthread_mutex_init(&c->write_lock, NULL);
+  return c;
+}
+
+//모든 스레드가 사용을 마친 뒤에 호출해야 한다
+void delete_rbtree_concurrent(rbtree_concurrent *c) {
+  if(c == NULL){
+    return;
+  }
+  pthread_mutex_destroy(&c->write_lock);
+  delete_rbtree(c->tree);
+  free(c);
+}
+
+//쓰기 구간 시작: 번호를 홀수로 만든 뒤 트리를 고치기 시작
+static void write_begin(rbtree_concurrent *c) {
+  pthread_mutex_lock(&c->write_lock);
+  __atomic_store_n(&c->seq, c->seq + 1, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+//쓰기 구간 끝: 트리의 변경이 모두 보인 뒤에 번호가 짝수가 된다
+static void write_end(rbtree_concurrent *c) {
+  __atomic_store_n(&c->seq, c->seq + 1, __ATOMIC_RELEASE);
+  pthread_mutex_unlock(&c->write_lock);
+}
+
+//새 키를 삽입하는 함수. 메모리가 부족하면 -1 반환
+int rbtree_concurrent_insert(rbtree_concurrent *c, const key_t key) {
+  write_begin(c);
+  node_t *p = rbtree_insert(c->tree, key);
+  write_end(c);
+  return p != NULL ? 0 : -1;
+}
+
+//키 하나를 삭제하는 함수. 키가 없으면 -1 반환
+int rbtree_concurrent_erase(rbtree_concurrent *c, const key_t key) {
+  write_begin(c);
+  node_t *p = rbtree_find(c->tree, key);
+  if(p != NULL){
+    rbtree_erase(c->tree, p);
+  }
+  write_end(c);
+  return p != NULL ? 0 : -1;
+}
+
+//읽기 함수의 본체. 트리를 읽어서 결과를 arg에 쓰고, 읽은 내용이 앞뒤가 맞지 않으면 -1을 반환한다.
+//잠금 없이 실행될 때는 node가 삭제/재사용되는 중일 수 있지만,
+//노드 풀이 slab을 트리가 삭제될 때까지 반환하지 않고 포인터 필드를 항상 NULL, nil 또는 풀의 노드로 유지하므로
+//NULL과 깊이만 확인하면 잘못된 메모리에 접근하지 않는다.
+typedef int (*read_fn)(const rbtree *, void *);
+
+//읽기 구간: 시작할 때의 번호가 짝수이고 끝날 때까지 같으면 그 동안 쓰기가 없었으므로 결과가 유효하다
+static void concurrent_read(rbtree_concurrent *c, read_fn fn, void *arg) {
+  for(int i = 0; i < OPTIMISTIC_TRIES; i++){
+    unsigned seq = __atomic_load_n(&c->seq, __ATOMIC_ACQUIRE);
+    if(seq & 1){
+      //writer가 작업 중이면 CPU를 양보
+      sched_yield();
+      continue;
+    }
+    int ret = fn(c->tree, arg);
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    if(ret == 0 && __atomic_load_n(&c->seq, __ATOMIC_RELAXED) == seq){
+      return;
+    }
+  }
+  pthread_mutex_lock(&c->write_lock);
+  fn(c->tree, arg);
+  pthread_mutex_unlock(&c->write_lock);
+}
+
+typedef struct {
+  key_t key;
+  int found;
+} find_arg;
+
+//두 자식을 모두 읽은 뒤 고르면 분기 대신 조건부 이동이 되어 rbtree_find만큼 빠르게 내려간다
+static int find_walk(const rbtree *t, void *arg) {
+  find_arg *a = (find_arg *)arg;
+  const key_t want = a->key;
+  node_t *x = READ(t->root);
+  int depth = CONCURRENT_MAX_HEIGHT;
+
+  a->found = 0;
+  while(x != t->nil && x != NULL){
+    key_t key = READ(x->key);
+    if(key == want){
+      a->found = 1;
+      return 0;
+    }
+    if(--depth == 0){
+      return -1;
+    }
+    node_t *left = READ(x->left), *right = READ(x->right);
+    x = key < want ? right : left;
+  }
+  return x == NULL ? -1 : 0;
+}
+
+//키가 있으면 1, 없으면 0 반환
+int rbtree_concurrent_find(rbtree_concurrent *c, const key_t key) {
+  find_arg a = {key, 0};
+  concurrent_read(c, find_walk, &a);
+  return a.found;
+}
+
+typedef struct {
+  int right;  //0이면 최소값, 1이면 최대값
+  key_t key;
+  int found;
+} edge_arg;
+
+static int edge_walk(const rbtree *t, void *arg) {
+  edge_arg *a = (edge_arg *)arg;
+  node_t *x = READ(t->root);
+  a->found = 0;
+  for(int depth = 0; depth < CONCURRENT_MAX_HEIGHT; depth++){
+    if(x == NULL){
+      return -1;
+    }
+    if(x == t->nil){
+      return 0;
+    }
+    a->key = READ(x->key);
+    a->found = 1;
+    x = a->right ? READ(x->right) : READ(x->left);
+  }
+  return -1;
+}
+
+//최소값을 *out에 저장하고 1 반환. 트리가 비어있으면 0 반환
+int rbtree_concurrent_min(rbtree_concurrent *c, key_t *out) {
+  edge_arg a = {0, 0, 0};
+  concurrent_read(c, edge_walk, &a);
+  if(a.found){
+    *out = a.key;
+  }
+  return a.found;
+}
+
+//최대값을 *out에 저장하고 1 반환. 트리가 비어있으면 0 반환
+int rbtree_concurrent_max(rbtree_concurrent *c, key_t *out) {
+  edge_arg a = {1, 0, 0};
+  concurrent_read(c, edge_walk, &a);
+  if(a.found){
+    *out = a.key;
+  }
+  return a.found;
+}
+
+typedef struct {
+  key_t key;
+  key_t next;
+  int found;
+} next_arg;
+
+//key보다 큰 키 중 가장 작은 키를 찾는다 (upper bound)
+static int next_walk(const rbtree *t, void *arg) {
+  next_arg *a = (next_arg *)arg;
+  const key_t want = a->key;
+  node_t *x = READ(t->root);
+  int depth = CONCURRENT_MAX_HEIGHT;
+  key_t next = 0;
+  int found = 0;
+
+  while(x != t->nil && x != NULL){
+    if(--depth == 0){
+      return -1;
+    }
+    key_t key = READ(x->key);
+    node_t *left = READ(x->left), *right = READ(x->right);
+    if(want < key){
+      next = key;
+      found = 1;
+    }
+    x = want < key ? left : right;
+  }
+  a->next = next;
+  a->found = found;
+  return x == NULL ? -1 : 0;
+}
+
+//key보다 큰 첫 키를 *out에 저장하고 1 반환. 없으면 0 반환.
+//node 대신 키로 위치를 기억하므로 순회 도중 다른 스레드가 수정해도 이어서 순회할 수 있다.
+int rbtree_concurrent_next(rbtree_concurrent *c, const key_t key, key_t *out) {
+  next_arg a = {key, 0, 0};
+  concurrent_read(c, next_walk, &a);
+  if(a.found){
+    *out = a.next;
+  }
+  return a.found;
+}
+
+typedef struct {
+  key_t lo, hi;
+  key_t *out;
+  size_t max;
+  size_t count;
+} range_arg;
+
+//lo 이상인 첫 node까지의 경로를 스택에 쌓은 뒤 중위 순회로 [lo, hi)의 키를 복사한다
+static int range_walk(const rbtree *t, void *arg) {
+  range_arg *a = (range_arg *)arg;
+  node_t *stack[CONCURRENT_MAX_HEIGHT];
+  int top = 0;
+  a->count = 0;
+
+  node_t *x = READ(t->root);
+  for(int depth = 0; x != t->nil; depth++){
+    if(x == NULL || depth == CONCURRENT_MAX_HEIGHT){
+      return -1;
+    }
+    if(READ(x->key) < a->lo){
+      x = READ(x->right);
+    }
+    else {
+      stack[top++] = x;
+      x = READ(x->left);
+    }
+  }
+
+  //정상적인 트리라면 스택에 넣는 횟수는 복사하는 키의 수와 트리 높이의 합을 넘지 않는다
+  size_t budget = a->max + CONCURRENT_MAX_HEIGHT;
+  while(top > 0 && a->count < a->max){
+    x = stack[--top];
+    key_t key = READ(x->key);
+    if(!(key < a->hi)){
+      break;
+    }
+    a->out[a->count++] = key;
+    for(x = READ(x->right); x != t->nil; x = READ(x->left)){
+      if(x == NULL || top == CONCURRENT_MAX_HEIGHT || budget-- == 0){
+        return -1;
+      }
+      stack[top++] = x;
+    }
+  }
+  return 0;
+}
+
+//[lo, hi) 범위의 키를 순서대로 최대 max개 out에 복사하고 개수를 반환하는 함수.
+//복사한 키들은 한 시점의 트리 상태와 일치한다.
+size_t rbtree_concurrent_range(rbtree_concurrent *c, const key_t lo, const key_t hi,
+                               key_t *out, const size_t max) {
+  range_arg a = {lo, hi, out, max, 0};
+  concurrent_read(c, range_walk, &a);
+  return a.count;
+}
@@ -0,0 +1,32 @@
+#ifndef _RBTREE_CONCURRENT_H_
+#define _RBTREE_CONCURRENT_H_
+
+#include <pthread.h>
+#include <stddef.h>
+
+#include "rbtree.h"
+
+// 여러 스레드가 공유하는 rbtree.
+// 쓰기(insert/erase)는 mutex로 한 번에 하나씩 실행하고 seqlock 번호를 홀수로 만든 채 트리를 고친다.
+// 읽기는 잠금 없이 트리를 내려간 뒤 그동안 번호가 바뀌지 않았을 때만 결과를 쓴다.
+// node는 언제든 삭제되어 재사용될 수 있으므로 읽기 함수들은 node pointer 대신 key를 복사해서 돌려준다.
+typedef struct {
+  rbtree *tree;
+  pthread_mutex_t write_lock;
+  unsigned seq;  // 짝수: 트리가 안정된 상태, 홀수: 쓰는 중
+} rbtree_concurrent;
+
+rbtree_concurrent *new_rbtree_concurrent(void);
+void delete_rbtree_concurrent(rbtree_concurrent *);
+
+int rbtree_concurrent_insert(rbtree_concurrent *, const key_t);
+int rbtree_concurrent_erase(rbtree_concurrent *, const key_t);
+
+int rbtree_concurrent_find(rbtree_concurrent *, const key_t);
+int rbtree_concurrent_min(rbtree_concurrent *, key_t *);
+int rbtree_concurrent_max(rbtree_concurrent *, key_t *);
+int rbtree_concurrent_next(rbtree_concurrent *, const key_t, key_t *);
+size_t rbtree_concurrent_range(rbtree_concurrent *, const key_t, const key_t,
+                               key_t *, const size_t);
+
+#endif  // _RBTREE_CONCURRENT_H_
@@ -0,0 +1,119 @@
+#include "rbtree_counted.h"
+
+#include <stdlib.h>
+
+//빈 counted multiset을 생성하는 함수. 메모리가 부족하면 NULL 반환
+rbtree_counted *new_rbtree_counted(void) {
+  rbtree_counted *c = (rbtree_counted *)calloc(1, sizeof(rbtree_counted));
+  if(c == NULL){
+    return NULL;
+  }
+  c->tree = counted_tree_new();
+  if(c->tree == NULL){
+    free(c);
+    return NULL;
+  }
+  return c;
+}
+
+void delete_rbtree_counted(rbtree_counted *c) {
+  if(c == NULL){
+    return;
+  }
+  counted_tree_delete(c->tree);
+  free(c);
+}
+
+//key를 n개 추가하는 함수. 이미 있는 key면 개수만 늘리고, 없으면 node를 하나 만든다.
+//메모리가 부족하면 -1 반환
+int rbtree_counted_insert_n(rbtree_counted *c, const key_t key, const size_t n) {
+  if(n == 0){
+    return 0;
+  }
+  counted_tree_node *p = counted_tree_find(c->tree, key);
+  if(p != NULL){
+    p->value += n;
+  }
+  else if(counted_tree_insert(c->tree, key, n) == NULL){
+    return -1;
+  }
+  c->total += n;
+  return 0;
+}
+
+//key를 하나 추가하는 함수. 메모리가 부족하면 -1 반환
+int rbtree_counted_insert(rbtree_counted *c, const key_t key) {
+  return rbtree_counted_insert_n(c, key, 1);
+}
+
+//key를 하나 지우는 함수. 개수를 줄이고, 마지막 하나였으면 node를 지운다. key가 없으면 -1 반환
+int rbtree_counted_erase(rbtree_counted *c, const key_t key) {
+  counted_tree_node *p = counted_tree_find(c->tree, key);
+  if(p == NULL){
+    return -1;
+  }
+  if(--p->value == 0){
+    counted_tree_erase(c->tree, p);
+  }
+  c->total--;
+  return 0;
+}
+
+//key를 모두 지우고 지운 개수를 반환하는 함수
+size_t rbtree_counted_erase_all(rbtree_counted *c, const key_t key) {
+  counted_tree_node *p = counted_tree_find(c->tree, key);
+  if(p == NULL){
+    return 0;
+  }
+  const size_t n = p->value;
+  counted_tree_erase(c->tree, p);
+  c->total -= n;
+  return n;
+}
+
+//key의 개수를 반환하는 함수. O(log D) (D는 서로 다른 key의 수)
+size_t rbtree_counted_count(const rbtree_counted *c, const key_t key) {
+  counted_tree_node *p = counted_tree_find(c->tree, key);
+  return p != NULL ? p->value : 0;
+}
+
+//중복을 포함한 전체 key의 개수를 반환하는 함수
+size_t rbtree_counted_size(const rbtree_counted *c) {
+  return c->total;
+}
+
+//서로 다른 key의 개수 (node 수)를 반환하는 함수
+size_t rbtree_counted_distinct(const rbtree_counted *c) {
+  return counted_tree_size(c->tree);
+}
+
+//최소값을 *out에 저장하고 1 반환. 비어있으면 0 반환
+int rbtree_counted_min(const rbtree_counted *c, key_t *out) {
+  counted_tree_node *p = counted_tree_min(c->tree);
+  if(p == NULL){
+    return 0;
+  }
+  *out = p->key;
+  return 1;
+}
+
+//최대값을 *out에 저장하고 1 반환. 비어있으면 0 반환
+int rbtree_counted_max(const rbtree_counted *c, key_t *out) {
+  counted_tree_node *p = counted_tree_max(c->tree);
+  if(p == NULL){
+    return 0;
+  }
+  *out = p->key;
+  return 1;
+}
+
+//key들을 개수만큼 펼쳐서 오름차순으로 최대 n개 arr에 복사하고 복사한 개수를 반환하는 함수
+size_t rbtree_counted_to_array(const rbtree_counted *c, key_t *arr, const size_t n) {
+  size_t index = 0;
+  for(counted_tree_node *p = counted_tree_min(c->tree); p != NULL && index < n; p = counted_tree_next(c->tree, p)){
+    for(size_t i = 0; i < p->value && index < n; i++){
+      arr[index++] = p->key;
+    }
+  }
+  return index;
+}
@@ -0,0 +1,35 @@
+#ifndef _RBTREE_COUNTED_H_
+#define _RBTREE_COUNTED_H_
+
+#include <stddef.h>
+
+#include "rbtree.h"
+#include "rbtree_generic.h"
+
+// 같은 key를 node 하나와 개수로 저장하는 multiset.
+// rbtree는 중복마다 node를 하나씩 만들지만, 여기서는 서로 다른 key마다 node가 하나이므로
+// 메모리와 높이가 전체 key 수가 아니라 서로 다른 key 수에 비례한다.
+// node는 rbtree_generic.h의 key/value tree로, value에 그 key의 개수를 저장한다.
+RBTREE_DEFINE(counted_tree, key_t, size_t, RBTREE_CMP_NUM)
+
+typedef struct {
+  counted_tree *tree;
+  size_t total;  // 중복을 포함한 전체 key 수
+} rbtree_counted;
+
+rbtree_counted *new_rbtree_counted(void);
+void delete_rbtree_counted(rbtree_counted *);
+
+int rbtree_counted_insert(rbtree_counted *, const key_t);
+int rbtree_counted_insert_n(rbtree_counted *, const key_t, const size_t);
+int rbtree_counted_erase(rbtree_counted *, const key_t);
+size_t rbtree_counted_erase_all(rbtree_counted *, const key_t);
+
+size_t rbtree_counted_count(const rbtree_counted *, const key_t);
+size_t rbtree_counted_size(const rbtree_counted *);
+size_t rbtree_counted_distinct(const rbtree_counted *);
+int rbtree_counted_min(const rbtree_counted *, key_t *);
+int rbtree_counted_max(const rbtree_counted *, key_t *);
+size_t rbtree_counted_to_array(const rbtree_counted *, key_t *, const size_t);
+
+#endif  // _RBTREE_COUNTED_H_
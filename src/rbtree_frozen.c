@@ -0,0 +1,216 @@
+#include "rbtree_frozen.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#include <immintrin.h>
+#define FROZEN_HAVE_AVX2 1
+#else
+#define FROZEN_HAVE_AVX2 0
+#endif
+
+//캐시 라인 크기와 한 캐시 라인에 들어가는 키의 수
+#define CACHE_LINE 64
+#define KEYS_PER_LINE (CACHE_LINE / sizeof(key_t))
+
+//중위 순회에서 가장 먼저 방문하는 위치 (루트에서 왼쪽 끝까지 내려간 위치)
+static size_t first_pos(size_t n) {
+  size_t k = 1;
+  if(n == 0){
+    return 0;
+  }
+  while(2 * k <= n){
+    k = 2 * k;
+  }
+  return k;
+}
+
+//rbtree의 키들을 Eytzinger 배열로 복사하는 함수. 메모리가 부족하면 NULL 반환
+rbtree_frozen *rbtree_freeze(const rbtree *t) {
+  rbtree_frozen *f = (rbtree_frozen *)calloc(1, sizeof(rbtree_frozen));
+  if(f == NULL){
+    return NULL;
+  }
+
+  //키의 개수를 구함
+#if RBTREE_ORDER_STATS
+  size_t n = rbtree_size(t);
+#else
+  size_t n = 0;
+  for(node_t *p = rbtree_min(t); p != NULL; p = rbtree_next(t, p)){
+    n++;
+  }
+#endif
+
+  //keys[16k..16k+15]가 한 캐시 라인에 들어가도록 배열을 캐시 라인에 맞춰 할당
+  size_t bytes = (n + 1) * sizeof(key_t);
+  bytes = (bytes + CACHE_LINE - 1) / CACHE_LINE * CACHE_LINE;
+  f->keys = (key_t *)aligned_alloc(CACHE_LINE, bytes);
+  if(f->keys == NULL){
+    free(f);
+    return NULL;
+  }
+  f->n = n;
+
+  //rbtree와 암묵적 트리를 동시에 중위 순회하면서 키를 채움
+  size_t k = first_pos(n);
+  for(node_t *p = rbtree_min(t); p != NULL; p = rbtree_next(t, p)){
+    f->keys[k] = p->key;
+    k = rbtree_frozen_next(f, k);
+  }
+  return f;
+}
+
+void delete_rbtree_frozen(rbtree_frozen *f) {
+  if(f != NULL){
+    free(f->keys);
+    free(f);
+  }
+}
+
+//키가 key 이상인 첫 위치를 반환하는 함수. 없으면 0 반환
+//비교 결과를 그대로 더해서 자식으로 내려가므로 분기 예측 실패가 없고,
+//4단계 아래 자손 16개가 있는 캐시 라인을 미리 가져온다.
+size_t rbtree_frozen_lower_bound(const rbtree_frozen *f, const key_t key) {
+  const key_t *keys = f->keys;
+  const size_t n = f->n;
+  size_t k = 1;
+
+  while(k <= n){
+    __builtin_prefetch(keys + k * KEYS_PER_LINE);
+    k = 2 * k + (keys[k] < key);
+  }
+
+  //마지막으로 왼쪽으로 내려간 위치가 답이다. 오른쪽으로 내려간 횟수(끝의 1 비트)와 그 직전의 왼쪽 이동 한 번을 되돌린다.
+  k >>= __builtin_ffsll(~(long long)k);
+  return k;
+}
+
+//주어진 키값을 가진 위치를 찾는 함수. 없으면 0 반환
+size_t rbtree_frozen_find(const rbtree_frozen *f, const key_t key) {
+  size_t k = rbtree_frozen_lower_bound(f, key);
+  return k != 0 && f->keys[k] == key ? k : 0;
+}
+
+//rbtree_frozen_find_many가 한 번에 진행하는 탐색의 수
+#define FIND_MANY_LANES 16
+
+//lower_bound의 반복 횟수. 모든 탐색은 floor(log2 n)번 또는 그보다 한 번 더 내려간 뒤 끝난다.
+static int descent_steps(size_t n) {
+  return n == 0 ? 0 : 64 - __builtin_clzll((unsigned long long)n);
+}
+
+//lower_bound 결과를 find 결과로 바꾸는 함수
+static size_t finish_find(const rbtree_frozen *f, size_t k, const key_t key) {
+  k >>= __builtin_ffsll(~(long long)k);
+  return k != 0 && f->keys[k] == key ? k : 0;
+}
+
+//키 m개(m <= FIND_MANY_LANES)의 탐색을 한 단계씩 번갈아 진행하는 함수
+static void find_lanes_scalar(const rbtree_frozen *f, const key_t *in, const size_t m,
+                              const int steps, size_t *out) {
+  const key_t *keys = f->keys;
+  const size_t n = f->n;
+  size_t k[FIND_MANY_LANES];
+
+  for(size_t i = 0; i < m; i++){
+    k[i] = 1;
+  }
+  for(int d = 0; d < steps; d++){
+    for(size_t i = 0; i < m; i++){
+      if(k[i] <= n){
+        __builtin_prefetch(keys + k[i] * KEYS_PER_LINE);
+        k[i] = 2 * k[i] + (keys[k[i]] < in[i]);
+      }
+    }
+  }
+  for(size_t i = 0; i < m; i++){
+    out[i] = finish_find(f, k[i], in[i]);
+  }
+}
+
+#if FROZEN_HAVE_AVX2
+//키 8개를 AVX2 레지스터의 각 칸에서 동시에 탐색하는 함수.
+//gather로 8개 위치의 키를 한 번에 읽고 비교 결과(참이면 -1)를 빼서 자식 위치를 구한다.
+//이미 끝난 칸(k > n)은 읽지도 바꾸지도 않는다. 위치가 32비트에 들어가야 하므로 n < 2^30에서만 쓴다.
+__attribute__((target("avx2")))
+static void find_lanes_avx2(const rbtree_frozen *f, const key_t *in, const int steps,
+                            size_t *out) {
+  const __m256i key = _mm256_loadu_si256((const __m256i *)in);
+  const __m256i limit = _mm256_set1_epi32((int)f->n + 1);
+  __m256i k = _mm256_set1_epi32(1);
+  uint32_t pos[8];
+
+  for(int d = 0; d < steps; d++){
+    __m256i active = _mm256_cmpgt_epi32(limit, k);
+    __m256i v = _mm256_mask_i32gather_epi32(_mm256_setzero_si256(), (const int *)f->keys,
+                                            k, active, sizeof(key_t));
+    __m256i child = _mm256_sub_epi32(_mm256_add_epi32(k, k), _mm256_cmpgt_epi32(key, v));
+    k = _mm256_blendv_epi8(k, child, active);
+
+    //scalar 경로처럼 각 칸의 4단계 아래 캐시 라인을 미리 가져옴
+    _mm256_storeu_si256((__m256i *)pos, k);
+    for(int i = 0; i < 8; i++){
+      __builtin_prefetch(f->keys + (size_t)pos[i] * KEYS_PER_LINE);
+    }
+  }
+
+  _mm256_storeu_si256((__m256i *)pos, k);
+  for(int i = 0; i < 8; i++){
+    out[i] = finish_find(f, pos[i], in[i]);
+  }
+}
+#endif
+
+//키 n개를 찾아서 out[i]에 rbtree_frozen_find(f, keys[i])와 같은 위치를 저장하는 함수.
+//AVX2를 쓸 수 있으면 8개씩 SIMD로, 아니면 FIND_MANY_LANES개씩 번갈아 탐색한다.
+void rbtree_frozen_find_many(const rbtree_frozen *f, const key_t *keys, const size_t n,
+                             size_t *out) {
+  const int steps = descent_steps(f->n);
+  size_t i = 0;
+
+#if FROZEN_HAVE_AVX2
+  if(sizeof(key_t) == sizeof(int32_t) && f->n < ((size_t)1 << 30) &&
+     __builtin_cpu_supports("avx2")){
+    for(; i + 8 <= n; i += 8){
+      find_lanes_avx2(f, keys + i, steps, out + i);
+    }
+  }
+#endif
+
+  for(; i < n; i += FIND_MANY_LANES){
+    size_t m = n - i < FIND_MANY_LANES ? n - i : FIND_MANY_LANES;
+    find_lanes_scalar(f, keys + i, m, steps, out + i);
+  }
+}
+
+//정렬 순서에서 다음 위치를 반환하는 함수. 마지막이면 0 반환
+size_t rbtree_frozen_next(const rbtree_frozen *f, size_t k) {
+  //오른쪽 자식이 있으면 그 서브 트리의 가장 왼쪽 위치
+  if(2 * k + 1 <= f->n){
+    k = 2 * k + 1;
+    while(2 * k <= f->n){
+      k = 2 * k;
+    }
+    return k;
+  }
+  //없으면 오른쪽 자식인 동안 올라간 뒤 한 번 더 올라감
+  while(k & 1){
+    k >>= 1;
+  }
+  return k >> 1;
+}
+
+//[lo, hi) 범위의 키를 순서대로 최대 max개 out에 복사하고 개수를 반환하는 함수
+size_t rbtree_frozen_range(const rbtree_frozen *f, const key_t lo, const key_t hi,
+                           key_t *out, const size_t max) {
+  size_t count = 0;
+  for(size_t k = rbtree_frozen_lower_bound(f, lo); k != 0 && count < max; k = rbtree_frozen_next(f, k)){
+    if(!(f->keys[k] < hi)){
+      break;
+    }
+    out[count++] = f->keys[k];
+  }
+  return count;
+}
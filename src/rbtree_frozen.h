@@ -0,0 +1,32 @@
+#ifndef _RBTREE_FROZEN_H_
+#define _RBTREE_FROZEN_H_
+
+#include <stddef.h>
+
+#include "rbtree.h"
+
+// rbtree의 키들을 복사해 둔 읽기 전용 탐색 구조.
+// 키는 Eytzinger 순서 (1번이 루트, k의 자식은 2k와 2k+1)의 배열에 놓여서
+// 탐색할 때 포인터를 따라가지 않고, 분기 없는 비교와 prefetch로 내려간다.
+// 위치는 배열 인덱스이고 0은 "없음"을 뜻한다.
+typedef struct {
+  key_t *keys;  // keys[1..n], 캐시 라인에 맞춰 정렬
+  size_t n;
+} rbtree_frozen;
+
+rbtree_frozen *rbtree_freeze(const rbtree *);
+void delete_rbtree_frozen(rbtree_frozen *);
+
+size_t rbtree_frozen_find(const rbtree_frozen *, const key_t);
+void rbtree_frozen_find_many(const rbtree_frozen *, const key_t *, const size_t,
+                             size_t *);
+size_t rbtree_frozen_lower_bound(const rbtree_frozen *, const key_t);
+size_t rbtree_frozen_next(const rbtree_frozen *, size_t);
+size_t rbtree_frozen_range(const rbtree_frozen *, const key_t, const key_t,
+                           key_t *, const size_t);
+
+static inline key_t rbtree_frozen_key(const rbtree_frozen *f, size_t pos) {
+  return f->keys[pos];
+}
+
+#endif  // _RBTREE_FROZEN_H_
@@ -0,0 +1,355 @@
+#ifndef _RBTREE_GENERIC_H_
+#define _RBTREE_GENERIC_H_
+
+#include <stdlib.h>
+
+#include "rbtree.h"
+
+// 키/값 타입과 비교 함수를 컴파일 타임에 정하는 레드-블랙 트리.
+//
+//   RBTREE_DEFINE(idmap, uint64_t, record_t, RBTREE_CMP_NUM)
+//
+// 는 idmap (트리), idmap_node (노드) 타입과 idmap_new, idmap_delete,
+// idmap_insert, idmap_find, idmap_lower_bound, idmap_min, idmap_max,
+// idmap_next, idmap_prev, idmap_erase, idmap_size 함수를 만든다.
+// 값은 노드 안에 바로 저장되고, cmp(a, b)는 a < b, a == b, a > b일 때 각각
+// 음수, 0, 양수를 돌려주는 함수나 매크로로 호출 위치에 인라인된다.
+// 같은 키는 기존 키들의 오른쪽에 들어간다 (multiset).
+
+// 숫자 키를 위한 기본 비교
+#define RBTREE_CMP_NUM(a, b) (((a) > (b)) - ((a) < (b)))
+
+// 매크로 안에서는 줄 연결 때문에 // 주석을 쓸 수 없으므로 /* */ 주석을 쓴다.
+#define RBTREE_DEFINE(name, K, V, cmp)                                         \
+  typedef struct name##_node {                                                 \
+    color_t color;                                                             \
+    struct name##_node *parent, *left, *right;                                 \
+    K key;                                                                     \
+    V value;                                                                   \
+  } name##_node;                                                               \
+                                                                               \
+  typedef struct {                                                             \
+    name##_node *root;                                                         \
+    name##_node nil; /* 트리 구조체 안에 둔 sentinel */                        \
+    size_t size;                                                               \
+  } name;                                                                      \
+                                                                               \
+  static inline name *name##_new(void) {                                       \
+    name *t = (name *)calloc(1, sizeof(name));                                 \
+    if(t == NULL){                                                             \
+      return NULL;                                                             \
+    }                                                                          \
+    t->nil.color = RBTREE_BLACK;                                               \
+    t->root = &t->nil;                                                         \
+    return t;                                                                  \
+  }                                                                            \
+                                                                               \
+  /* 부모 포인터로 올라가며 잎부터 해제하므로 스택을 쓰지 않는다 */            \
+  static inline void name##_delete(name *t) {                                  \
+    name##_node *nil = &t->nil;                                                \
+    name##_node *node = t->root;                                               \
+    while(node != nil){                                                        \
+      if(node->left != nil){                                                   \
+        node = node->left;                                                     \
+      } else if(node->right != nil){                                           \
+        node = node->right;                                                    \
+      } else {                                                                 \
+        name##_node *parent = node->parent;                                    \
+        if(parent != nil){                                                     \
+          if(parent->left == node){                                            \
+            parent->left = nil;                                                \
+          } else {                                                             \
+            parent->right = nil;                                               \
+          }                                                                    \
+        }                                                                      \
+        free(node);                                                            \
+        node = parent;                                                         \
+      }                                                                        \
+    }                                                                          \
+    free(t);                                                                   \
+  }                                                                            \
+                                                                               \
+  static inline size_t name##_size(const name *t) { return t->size; }          \
+                                                                               \
+  static inline void name##_left_rotate(name *t, name##_node *x) {             \
+    name##_node *y = x->right;                                                 \
+    x->right = y->left;                                                        \
+    if(y->left != &t->nil){                                                    \
+      y->left->parent = x;                                                     \
+    }                                                                          \
+    y->parent = x->parent;                                                     \
+    if(x->parent == &t->nil){                                                  \
+      t->root = y;                                                             \
+    } else if(x == x->parent->left){                                           \
+      x->parent->left = y;                                                     \
+    } else {                                                                   \
+      x->parent->right = y;                                                    \
+    }                                                                          \
+    y->left = x;                                                               \
+    x->parent = y;                                                             \
+  }                                                                            \
+                                                                               \
+  static inline void name##_right_rotate(name *t, name##_node *x) {            \
+    name##_node *y = x->left;                                                  \
+    x->left = y->right;                                                        \
+    if(y->right != &t->nil){                                                   \
+      y->right->parent = x;                                                    \
+    }                                                                          \
+    y->parent = x->parent;                                                     \
+    if(x->parent == &t->nil){                                                  \
+      t->root = y;                                                             \
+    } else if(x == x->parent->right){                                          \
+      x->parent->right = y;                                                    \
+    } else {                                                                   \
+      x->parent->left = y;                                                     \
+    }                                                                          \
+    y->right = x;                                                              \
+    x->parent = y;                                                             \
+  }                                                                            \
+                                                                               \
+  static inline void name##_insert_fixup(name *t, name##_node *z) {            \
+    while(z->parent->color == RBTREE_RED){                                     \
+      name##_node *g = z->parent->parent;                                      \
+      if(z->parent == g->left){                                                \
+        name##_node *y = g->right;                                             \
+        if(y->color == RBTREE_RED){                                            \
+          z->parent->color = RBTREE_BLACK;                                     \
+          y->color = RBTREE_BLACK;                                             \
+          g->color = RBTREE_RED;                                               \
+          z = g;                                                               \
+        } else {                                                               \
+          if(z == z->parent->right){                                           \
+            z = z->parent;                                                     \
+            name##_left_rotate(t, z);                                          \
+          }                                                                    \
+          z->parent->color = RBTREE_BLACK;                                     \
+          z->parent->parent->color = RBTREE_RED;                               \
+          name##_right_rotate(t, z->parent->parent);                           \
+        }                                                                      \
+      } else {                                                                 \
+        name##_node *y = g->left;                                              \
+        if(y->color == RBTREE_RED){                                            \
+          z->parent->color = RBTREE_BLACK;                                     \
+          y->color = RBTREE_BLACK;                                             \
+          g->color = RBTREE_RED;                                               \
+          z = g;                                                               \
+        } else {                                                               \
+          if(z == z->parent->left){                                            \
+            z = z->parent;                                                     \
+            name##_right_rotate(t, z);                                         \
+          }                                                                    \
+          z->parent->color = RBTREE_BLACK;                                     \
+          z->parent->parent->color = RBTREE_RED;                               \
+          name##_left_rotate(t, z->parent->parent);                            \
+        }                                                                      \
+      }                                                                        \
+    }                                                                          \
+    t->root->color = RBTREE_BLACK;                                             \
+  }                                                                            \
+                                                                               \
+  static inline name##_node *name##_insert(name *t, K key, V value) {          \
+    name##_node *z = (name##_node *)malloc(sizeof(name##_node));               \
+    if(z == NULL){                                                             \
+      return NULL;                                                             \
+    }                                                                          \
+    name##_node *y = &t->nil;                                                  \
+    name##_node *x = t->root;                                                  \
+    int c = 0;                                                                 \
+    while(x != &t->nil){                                                       \
+      y = x;                                                                   \
+      c = cmp(key, x->key);                                                    \
+      x = c < 0 ? x->left : x->right;                                          \
+    }                                                                          \
+    z->color = RBTREE_RED;                                                     \
+    z->key = key;                                                              \
+    z->value = value;                                                          \
+    z->left = z->right = &t->nil;                                              \
+    z->parent = y;                                                             \
+    if(y == &t->nil){                                                          \
+      t->root = z;                                                             \
+    } else if(c < 0){                                                          \
+      y->left = z;                                                             \
+    } else {                                                                   \
+      y->right = z;                                                            \
+    }                                                                          \
+    name##_insert_fixup(t, z);                                                 \
+    t->size++;                                                                 \
+    return z;                                                                  \
+  }                                                                            \
+                                                                               \
+  static inline name##_node *name##_find(const name *t, K key) {               \
+    name##_node *x = t->root;                                                  \
+    while(x != &t->nil){                                                       \
+      int c = cmp(key, x->key);                                                \
+      if(c == 0){                                                              \
+        return x;                                                              \
+      }                                                                        \
+      x = c < 0 ? x->left : x->right;                                          \
+    }                                                                          \
+    return NULL;                                                               \
+  }                                                                            \
+                                                                               \
+  /* key 이상인 첫 노드, 없으면 NULL */                                        \
+  static inline name##_node *name##_lower_bound(const name *t, K key) {        \
+    name##_node *x = t->root, *found = NULL;                                   \
+    while(x != &t->nil){                                                       \
+      if(cmp(x->key, key) >= 0){                                               \
+        found = x;                                                             \
+        x = x->left;                                                           \
+      } else {                                                                 \
+        x = x->right;                                                          \
+      }                                                                        \
+    }                                                                          \
+    return found;                                                              \
+  }                                                                            \
+                                                                               \
+  static inline name##_node *name##_sub_min(const name *t, name##_node *x) {   \
+    while(x->left != &t->nil){                                                 \
+      x = x->left;                                                             \
+    }                                                                          \
+    return x;                                                                  \
+  }                                                                            \
+                                                                               \
+  static inline name##_node *name##_sub_max(const name *t, name##_node *x) {   \
+    while(x->right != &t->nil){                                                \
+      x = x->right;                                                            \
+    }                                                                          \
+    return x;                                                                  \
+  }                                                                            \
+                                                                               \
+  static inline name##_node *name##_min(const name *t) {                       \
+    return t->root == &t->nil ? NULL : name##_sub_min(t, t->root);             \
+  }                                                                            \
+                                                                               \
+  static inline name##_node *name##_max(const name *t) {                       \
+    return t->root == &t->nil ? NULL : name##_sub_max(t, t->root);             \
+  }                                                                            \
+                                                                               \
+  static inline name##_node *name##_next(const name *t,                        \
+                                         const name##_node *x) {               \
+    if(x->right != &t->nil){                                                   \
+      return name##_sub_min(t, x->right);                                      \
+    }                                                                          \
+    name##_node *p = x->parent;                                                \
+    while(p != &t->nil && x == p->right){                                      \
+      x = p;                                                                   \
+      p = p->parent;                                                           \
+    }                                                                          \
+    return p == &t->nil ? NULL : p;                                            \
+  }                                                                            \
+                                                                               \
+  static inline name##_node *name##_prev(const name *t,                        \
+                                         const name##_node *x) {               \
+    if(x->left != &t->nil){                                                    \
+      return name##_sub_max(t, x->left);                                       \
+    }                                                                          \
+    name##_node *p = x->parent;                                                \
+    while(p != &t->nil && x == p->left){                                       \
+      x = p;                                                                   \
+      p = p->parent;                                                           \
+    }                                                                          \
+    return p == &t->nil ? NULL : p;                                            \
+  }                                                                            \
+                                                                               \
+  static inline void name##_transplant(name *t, name##_node *u,                \
+                                       name##_node *v) {                       \
+    if(u->parent == &t->nil){                                                  \
+      t->root = v;                                                             \
+    } else if(u == u->parent->left){                                           \
+      u->parent->left = v;                                                     \
+    } else {                                                                   \
+      u->parent->right = v;                                                    \
+    }                                                                          \
+    v->parent = u->parent;                                                     \
+  }                                                                            \
+                                                                               \
+  static inline void name##_delete_fixup(name *t, name##_node *x) {            \
+    while(x != t->root && x->color == RBTREE_BLACK){                           \
+      if(x == x->parent->left){                                                \
+        name##_node *w = x->parent->right;                                     \
+        if(w->color == RBTREE_RED){                                            \
+          w->color = RBTREE_BLACK;                                             \
+          x->parent->color = RBTREE_RED;                                       \
+          name##_left_rotate(t, x->parent);                                    \
+          w = x->parent->right;                                                \
+        }                                                                      \
+        if(w->left->color == RBTREE_BLACK &&                                   \
+           w->right->color == RBTREE_BLACK){                                   \
+          w->color = RBTREE_RED;                                               \
+          x = x->parent;                                                       \
+        } else {                                                               \
+          if(w->right->color == RBTREE_BLACK){                                 \
+            w->left->color = RBTREE_BLACK;                                     \
+            w->color = RBTREE_RED;                                             \
+            name##_right_rotate(t, w);                                         \
+            w = x->parent->right;                                              \
+          }                                                                    \
+          w->color = x->parent->color;                                         \
+          x->parent->color = RBTREE_BLACK;                                     \
+          w->right->color = RBTREE_BLACK;                                      \
+          name##_left_rotate(t, x->parent);                                    \
+          x = t->root;                                                         \
+        }                                                                      \
+      } else {                                                                 \
+        name##_node *w = x->parent->left;                                      \
+        if(w->color == RBTREE_RED){                                            \
+          w->color = RBTREE_BLACK;                                             \
+          x->parent->color = RBTREE_RED;                                       \
+          name##_right_rotate(t, x->parent);                                   \
+          w = x->parent->left;                                                 \
+        }                                                                      \
+        if(w->left->color == RBTREE_BLACK &&                                   \
+           w->right->color == RBTREE_BLACK){                                   \
+          w->color = RBTREE_RED;                                               \
+          x = x->parent;                                                       \
+        } else {                                                               \
+          if(w->left->color == RBTREE_BLACK){                                  \
+            w->right->color = RBTREE_BLACK;                                    \
+            w->color = RBTREE_RED;                                             \
+            name##_left_rotate(t, w);                                          \
+            w = x->parent->left;                                               \
+          }                                                                    \
+          w->color = x->parent->color;                                         \
+          x->parent->color = RBTREE_BLACK;                                     \
+          w->left->color = RBTREE_BLACK;                                       \
+          name##_right_rotate(t, x->parent);                                   \
+          x = t->root;                                                         \
+        }                                                                      \
+      }                                                                        \
+    }                                                                          \
+    x->color = RBTREE_BLACK;                                                   \
+  }                                                                            \
+                                                                               \
+  static inline void name##_erase(name *t, name##_node *p) {                   \
+    name##_node *y = p, *x;                                                    \
+    color_t original_color = y->color;                                         \
+    if(p->left == &t->nil){                                                    \
+      x = p->right;                                                            \
+      name##_transplant(t, p, p->right);                                       \
+    } else if(p->right == &t->nil){                                            \
+      x = p->left;                                                             \
+      name##_transplant(t, p, p->left);                                        \
+    } else {                                                                   \
+      y = name##_sub_min(t, p->right);                                         \
+      original_color = y->color;                                               \
+      x = y->right;                                                            \
+      if(y->parent == p){                                                      \
+        x->parent = y;                                                         \
+      } else {                                                                 \
+        name##_transplant(t, y, y->right);                                     \
+        y->right = p->right;                                                   \
+        y->right->parent = y;                                                  \
+      }                                                                        \
+      name##_transplant(t, p, y);                                              \
+      y->left = p->left;                                                       \
+      y->left->parent = y;                                                     \
+      y->color = p->color;                                                     \
+    }                                                                          \
+    if(original_color == RBTREE_BLACK){                                        \
+      name##_delete_fixup(t, x);                                               \
+    }                                                                          \
+    t->size--;                                                                 \
+    free(p);                                                                   \
+  }
+
+#endif  // _RBTREE_GENERIC_H_
@@ -0,0 +1,420 @@
+#include "rbtree_persistent.h"
+
+#include <stdlib.h>
+
+//레드-블랙 트리의 높이 상한 (rbtree.c의 RBTREE_MAX_HEIGHT와 같다)
+#define PERSISTENT_MAX_HEIGHT 128
+
+static int is_red(const persistent_node_t *n) {
+  return n != NULL && n->color == RBTREE_RED;
+}
+
+rbtree_persistent *new_rbtree_persistent(void) {
+  rbtree_persistent *t = (rbtree_persistent *)calloc(1, sizeof(rbtree_persistent));
+  if(t == NULL){
+    return NULL;
+  }
+  pthread_mutex_init(&t->lock, NULL);
+  return t;
+}
+
+//참조를 하나 놓는 함수. 마지막 참조였으면 node를 해제하고, 그 아래에서 더 이상 참조되지 않는 node들도 해제한다.
+//스냅샷을 가진 어느 스레드에서든 호출될 수 있으므로 참조 횟수는 원자적으로 바꾼다.
+static void release(persistent_node_t *n) {
+  //왼쪽 자식을 먼저 처리하므로 스택에는 층마다 최대 하나의 node만 남는다
+  persistent_node_t *stack[2 * PERSISTENT_MAX_HEIGHT];
+  int top = 0;
+
+  if(n != NULL){
+    stack[top++] = n;
+  }
+  while(top > 0){
+    n = stack[--top];
+    if(__atomic_sub_fetch(&n->refs, 1, __ATOMIC_ACQ_REL) != 0){
+      continue;
+    }
+    if(n->link[1] != NULL){
+      stack[top++] = n->link[1];
+    }
+    if(n->link[0] != NULL){
+      stack[top++] = n->link[0];
+    }
+    free(n);
+  }
+}
+
+//트리의 현재 버전을 해제하는 함수. 남아있는 스냅샷은 계속 사용할 수 있다.
+void delete_rbtree_persistent(rbtree_persistent *t) {
+  if(t == NULL){
+    return;
+  }
+  release(t->root);
+  while(t->spare != NULL){
+    persistent_node_t *next = t->spare->link[0];
+    free(t->spare);
+    t->spare = next;
+  }
+  pthread_mutex_destroy(&t->lock);
+  free(t);
+}
+
+//N개의 key를 가진 RB 트리의 높이 상한 2 * log2(N + 1)
+static size_t height_bound(const size_t count) {
+  return 2 * (64 - __builtin_clzll((unsigned long long)count + 1));
+}
+
+//쓰기 도중에 할당이 실패해서 트리가 반쯤 바뀐 채로 남지 않도록 node를 n개 이상 미리 확보하는 함수
+static int reserve(rbtree_persistent *t, const size_t n) {
+  while(t->spare_count < n){
+    persistent_node_t *node = (persistent_node_t *)malloc(sizeof(persistent_node_t));
+    if(node == NULL){
+      return -1;
+    }
+    node->link[0] = t->spare;
+    t->spare = node;
+    t->spare_count++;
+  }
+  return 0;
+}
+
+static persistent_node_t *take_spare(rbtree_persistent *t) {
+  persistent_node_t *node = t->spare;
+  t->spare = node->link[0];
+  t->spare_count--;
+  return node;
+}
+
+static void put_spare(rbtree_persistent *t, persistent_node_t *node) {
+  node->link[0] = t->spare;
+  t->spare = node;
+  t->spare_count++;
+}
+
+//slot이 가리키는 node를 이번 쓰기만 참조하는 node로 만들어 반환하는 함수.
+//참조가 하나뿐이면 어떤 스냅샷에서도 보이지 않으므로 그대로 고쳐도 되고,
+//공유된 node면 복사본으로 바꿔 끼운다. slot은 이미 이번 쓰기만 참조하는 node 안에 있어야 한다.
+static persistent_node_t *own(rbtree_persistent *t, persistent_node_t **slot) {
+  persistent_node_t *n = *slot;
+  if(n == NULL || __atomic_load_n(&n->refs, __ATOMIC_ACQUIRE) == 1){
+    return n;
+  }
+  persistent_node_t *copy = take_spare(t);
+  copy->key = n->key;
+  copy->color = n->color;
+  copy->refs = 1;
+  for(int dir = 0; dir < 2; dir++){
+    copy->link[dir] = n->link[dir];
+    if(copy->link[dir] != NULL){
+      __atomic_add_fetch(&copy->link[dir]->refs, 1, __ATOMIC_RELAXED);
+    }
+  }
+  *slot = copy;
+  release(n);
+  return copy;
+}
+
+//새 키를 삽입하는 함수. 메모리가 부족하면 -1 반환
+//부모 포인터가 없으므로 내려온 경로를 스택 (pa: node, da: 내려간 방향)에 쌓고 그 위에서 fixup 한다.
+int rbtree_persistent_insert(rbtree_persistent *t, const key_t key) {
+  persistent_node_t head;  //루트를 link[0]으로 가지는 가상의 부모
+  persistent_node_t *pa[PERSISTENT_MAX_HEIGHT + 2];
+  unsigned char da[PERSISTENT_MAX_HEIGHT + 2];
+  int k = 0;
+
+  pthread_mutex_lock(&t->lock);
+  //경로의 복사본, 색을 바꿀 삼촌들, 새 node
+  if(reserve(t, 2 * height_bound(t->count) + 1) != 0){
+    pthread_mutex_unlock(&t->lock);
+    return -1;
+  }
+
+  head.link[0] = t->root;
+  pa[k] = &head;
+  da[k++] = 0;
+  for(persistent_node_t *p = own(t, &head.link[0]); p != NULL; p = own(t, &p->link[da[k - 1]])){
+    pa[k] = p;
+    da[k++] = !(key < p->key);
+  }
+
+  persistent_node_t *n = take_spare(t);
+  n->key = key;
+  n->color = RBTREE_RED;
+  n->refs = 1;
+  n->link[0] = n->link[1] = NULL;
+  pa[k - 1]->link[da[k - 1]] = n;
+
+  //부모가 빨강인 동안 반복. d는 부모가 조부모의 어느 쪽 자식인지
+  while(k >= 3 && pa[k - 1]->color == RBTREE_RED){
+    const int d = da[k - 2];
+    persistent_node_t *g = pa[k - 2], *parent = pa[k - 1];
+
+    //삼촌도 빨강이면 색만 바꾸고 조부모에서 다시 검사
+    if(is_red(g->link[!d])){
+      persistent_node_t *uncle = own(t, &g->link[!d]);
+      parent->color = uncle->color = RBTREE_BLACK;
+      g->color = RBTREE_RED;
+      k -= 2;
+      continue;
+    }
+
+    //안쪽 손자면 부모에서 먼저 회전해서 바깥쪽 손자로 만든다
+    persistent_node_t *y = parent;
+    if(da[k - 1] != d){
+      y = parent->link[!d];
+      parent->link[!d] = y->link[d];
+      y->link[d] = parent;
+      g->link[d] = y;
+    }
+    //조부모에서 회전
+    g->color = RBTREE_RED;
+    y->color = RBTREE_BLACK;
+    g->link[d] = y->link[!d];
+    y->link[!d] = g;
+    pa[k - 3]->link[da[k - 3]] = y;
+    break;
+  }
+
+  t->root = head.link[0];
+  t->root->color = RBTREE_BLACK;
+  t->count++;
+  pthread_mutex_unlock(&t->lock);
+  return 0;
+}
+
+//키 하나를 삭제하는 함수. 키가 없거나 메모리가 부족하면 -1 반환
+int rbtree_persistent_erase(rbtree_persistent *t, const key_t key) {
+  persistent_node_t head;
+  persistent_node_t *pa[PERSISTENT_MAX_HEIGHT + 2];
+  unsigned char da[PERSISTENT_MAX_HEIGHT + 2];
+  int k = 0;
+
+  pthread_mutex_lock(&t->lock);
+  //키가 없으면 아무것도 복사하지 않도록 먼저 찾아봄
+  persistent_node_t *q = t->root;
+  while(q != NULL && q->key != key){
+    q = q->link[!(key < q->key)];
+  }
+  //경로와 후계자까지의 복사본, 형제와 두 조카의 복사본
+  if(q == NULL || reserve(t, 3 * height_bound(t->count) + 4) != 0){
+    pthread_mutex_unlock(&t->lock);
+    return -1;
+  }
+
+  head.link[0] = t->root;
+  pa[k] = &head;
+  da[k++] = 0;
+  persistent_node_t *p = own(t, &head.link[0]);
+  while(p->key != key){
+    const int dir = !(key < p->key);
+    pa[k] = p;
+    da[k++] = dir;
+    p = own(t, &p->link[dir]);
+  }
+
+  //p를 트리에서 떼어냄. 오른쪽 서브트리가 있으면 후계자를 p의 자리로 옮기고 두 node의 색을 바꾼다.
+  if(p->link[1] == NULL){
+    pa[k - 1]->link[da[k - 1]] = p->link[0];
+  }
+  else {
+    persistent_node_t *r = own(t, &p->link[1]);
+    if(r->link[0] == NULL){
+      r->link[0] = p->link[0];
+      color_t c = r->color;
+      r->color = p->color;
+      p->color = c;
+      pa[k - 1]->link[da[k - 1]] = r;
+      da[k] = 1;
+      pa[k++] = r;
+    }
+    else {
+      //후계자 s는 r에서 왼쪽 끝까지 내려간 node. 스택의 j번째 자리는 나중에 s로 채운다.
+      persistent_node_t *s;
+      const int j = k++;
+      for(;;){
+        da[k] = 0;
+        pa[k++] = r;
+        s = own(t, &r->link[0]);
+        if(s->link[0] == NULL){
+          break;
+        }
+        r = s;
+      }
+      da[j] = 1;
+      pa[j] = s;
+      pa[j - 1]->link[da[j - 1]] = s;
+      s->link[0] = p->link[0];
+      r->link[0] = s->link[1];
+      s->link[1] = p->link[1];
+      color_t c = s->color;
+      s->color = p->color;
+      p->color = c;
+    }
+  }
+
+  //검은 node가 빠졌으면 경로를 거슬러 오르며 검은 높이를 맞춤. d는 검은 높이가 모자란 쪽
+  if(p->color == RBTREE_BLACK){
+    for(;;){
+      if(is_red(pa[k - 1]->link[da[k - 1]])){
+        own(t, &pa[k - 1]->link[da[k - 1]])->color = RBTREE_BLACK;
+        break;
+      }
+      if(k < 2){
+        break;
+      }
+
+      const int d = da[k - 1];
+      persistent_node_t *parent = pa[k - 1];
+      persistent_node_t *w = own(t, &parent->link[!d]);
+
+      //형제가 빨강이면 부모에서 회전해서 검은 형제를 만듦
+      if(w->color == RBTREE_RED){
+        w->color = RBTREE_BLACK;
+        parent->color = RBTREE_RED;
+        parent->link[!d] = w->link[d];
+        w->link[d] = parent;
+        pa[k - 2]->link[da[k - 2]] = w;
+        pa[k] = parent;
+        da[k] = d;
+        pa[k - 1] = w;
+        k++;
+        w = own(t, &parent->link[!d]);
+      }
+
+      //조카가 모두 검은색이면 형제를 빨강으로 칠하고 한 층 위로
+      if(!is_red(w->link[0]) && !is_red(w->link[1])){
+        w->color = RBTREE_RED;
+      }
+      else {
+        //먼 조카가 검은색이면 형제에서 회전해서 먼 조카를 빨강으로 만듦
+        if(!is_red(w->link[!d])){
+          persistent_node_t *y = own(t, &w->link[d]);
+          y->color = RBTREE_BLACK;
+          w->color = RBTREE_RED;
+          w->link[d] = y->link[!d];
+          y->link[!d] = w;
+          w = parent->link[!d] = y;
+        }
+        persistent_node_t *far = own(t, &w->link[!d]);
+        w->color = parent->color;
+        parent->color = RBTREE_BLACK;
+        far->color = RBTREE_BLACK;
+        parent->link[!d] = w->link[d];
+        w->link[d] = parent;
+        pa[k - 2]->link[da[k - 2]] = w;
+        break;
+      }
+      k--;
+    }
+  }
+
+  //p의 자식 참조는 모두 다른 node로 옮겨졌으므로 p만 돌려놓으면 된다
+  put_spare(t, p);
+  t->root = head.link[0];
+  t->count--;
+  pthread_mutex_unlock(&t->lock);
+  return 0;
+}
+
+//현재 버전의 스냅샷을 만드는 함수. 루트의 참조 횟수만 늘리므로 O(1)
+void rbtree_persistent_snapshot(rbtree_persistent *t, rbtree_snapshot *s) {
+  pthread_mutex_lock(&t->lock);
+  s->root = t->root;
+  s->count = t->count;
+  if(s->root != NULL){
+    __atomic_add_fetch(&s->root->refs, 1, __ATOMIC_RELAXED);
+  }
+  pthread_mutex_unlock(&t->lock);
+}
+
+//스냅샷을 해제하는 함수. 이 스냅샷만 참조하던 node들이 해제된다.
+void rbtree_snapshot_release(rbtree_snapshot *s) {
+  release(s->root);
+  s->root = NULL;
+  s->count = 0;
+}
+
+//주어진 키값을 가진 node를 찾는 함수. 없으면 NULL 반환
+const persistent_node_t *rbtree_snapshot_find(const rbtree_snapshot *s, const key_t key) {
+  const persistent_node_t *p = s->root;
+  while(p != NULL && p->key != key){
+    p = p->link[p->key < key];
+  }
+  return p;
+}
+
+//키가 key 이상인 첫 node를 찾는 함수. 없으면 NULL 반환
+const persistent_node_t *rbtree_snapshot_lower_bound(const rbtree_snapshot *s, const key_t key) {
+  const persistent_node_t *p = s->root, *found = NULL;
+  while(p != NULL){
+    if(p->key < key){
+      p = p->link[1];
+    }
+    else {
+      found = p;
+      p = p->link[0];
+    }
+  }
+  return found;
+}
+
+static const persistent_node_t *edge(const rbtree_snapshot *s, const int dir) {
+  const persistent_node_t *p = s->root;
+  if(p == NULL){
+    return NULL;
+  }
+  while(p->link[dir] != NULL){
+    p = p->link[dir];
+  }
+  return p;
+}
+
+const persistent_node_t *rbtree_snapshot_min(const rbtree_snapshot *s) {
+  return edge(s, 0);
+}
+
+const persistent_node_t *rbtree_snapshot_max(const rbtree_snapshot *s) {
+  return edge(s, 1);
+}
+
+//lo 이상 hi 미만의 키를 순서대로 최대 max개 out에 복사하는 함수. lo, hi가 NULL이면 그쪽은 제한이 없다.
+static size_t collect(const rbtree_snapshot *s, const key_t *lo, const key_t *hi,
+                      key_t *out, const size_t max) {
+  const persistent_node_t *stack[PERSISTENT_MAX_HEIGHT];
+  int top = 0;
+  size_t count = 0;
+
+  //lo 이상인 첫 node까지의 경로 중 왼쪽으로 내려간 node들을 쌓음
+  const persistent_node_t *p = s->root;
+  while(p != NULL){
+    if(lo != NULL && p->key < *lo){
+      p = p->link[1];
+    }
+    else {
+      stack[top++] = p;
+      p = p->link[0];
+    }
+  }
+
+  while(top > 0 && count < max){
+    p = stack[--top];
+    if(hi != NULL && !(p->key < *hi)){
+      break;
+    }
+    out[count++] = p->key;
+    for(p = p->link[1]; p != NULL; p = p->link[0]){
+      stack[top++] = p;
+    }
+  }
+  return count;
+}
+
+//[lo, hi) 범위의 키를 순서대로 최대 max개 out에 복사하고 개수를 반환하는 함수
+size_t rbtree_snapshot_range(const rbtree_snapshot *s, const key_t lo, const key_t hi,
+                             key_t *out, const size_t max) {
+  return collect(s, &lo, &hi, out, max);
+}
+
+//스냅샷의 키를 오름차순으로 최대 n개 arr에 복사하고 개수를 반환하는 함수
+size_t rbtree_snapshot_to_array(const rbtree_snapshot *s, key_t *arr, const size_t n) {
+  return collect(s, NULL, NULL, arr, n);
+}
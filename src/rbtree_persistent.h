@@ -0,0 +1,51 @@
+#ifndef _RBTREE_PERSISTENT_H_
+#define _RBTREE_PERSISTENT_H_
+
+#include <pthread.h>
+#include <stddef.h>
+
+#include "rbtree.h"
+
+// 여러 버전이 서브트리를 공유하는 RB 트리 (path copying).
+// node는 부모 포인터 없이 참조 횟수만 가지며, 여러 버전이 공유하는 node는 바뀌지 않는다.
+// 쓰기는 참조가 하나뿐인 node만 그 자리에서 고치고, 공유된 node는 복사해서 고치므로
+// 스냅샷이 없으면 복사가 전혀 없고, 있으면 갱신마다 O(log N)개의 node만 새로 만든다.
+typedef struct persistent_node_t {
+  key_t key;
+  color_t color;
+  unsigned refs;
+  struct persistent_node_t *link[2];  // 0: 왼쪽, 1: 오른쪽 (NULL이면 없음)
+} persistent_node_t;
+
+typedef struct {
+  persistent_node_t *root;
+  size_t count;
+  persistent_node_t *spare;  // 쓰기 도중 할당이 실패하지 않도록 미리 확보해 둔 node들
+  size_t spare_count;
+  pthread_mutex_t lock;      // 쓰기와 스냅샷 생성을 직렬화
+} rbtree_persistent;
+
+// 한 시점의 트리. 해제할 때까지 다른 스레드의 쓰기와 상관없이 잠금 없이 읽을 수 있다.
+typedef struct {
+  persistent_node_t *root;
+  size_t count;
+} rbtree_snapshot;
+
+rbtree_persistent *new_rbtree_persistent(void);
+void delete_rbtree_persistent(rbtree_persistent *);
+
+int rbtree_persistent_insert(rbtree_persistent *, const key_t);
+int rbtree_persistent_erase(rbtree_persistent *, const key_t);
+
+void rbtree_persistent_snapshot(rbtree_persistent *, rbtree_snapshot *);
+void rbtree_snapshot_release(rbtree_snapshot *);
+
+const persistent_node_t *rbtree_snapshot_find(const rbtree_snapshot *, const key_t);
+const persistent_node_t *rbtree_snapshot_lower_bound(const rbtree_snapshot *, const key_t);
+const persistent_node_t *rbtree_snapshot_min(const rbtree_snapshot *);
+const persistent_node_t *rbtree_snapshot_max(const rbtree_snapshot *);
+size_t rbtree_snapshot_to_array(const rbtree_snapshot *, key_t *, const size_t);
+size_t rbtree_snapshot_range(const rbtree_snapshot *, const key_t, const key_t,
+                             key_t *, const size_t);
+
+#endif  // _RBTREE_PERSISTENT_H_
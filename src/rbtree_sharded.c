@@ -0,0 +1,315 @@
+#include "rbtree_sharded.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+
+//shard가 이 수보다 작을 때는 split 지점을 다시 정하지 않는다
+#define SHARD_REBALANCE_MIN 1024
+
+//다른 스레드가 split을 다시 정하는 동안에도 읽을 수 있도록 경계 key를 한 번에 읽는다
+#define READ(field) __atomic_load_n(&(field), __ATOMIC_RELAXED)
+
+//[lo, hi]를 k개의 같은 폭으로 나누는 shard 묶음을 생성하는 함수.
+//split 지점은 key가 쌓이면서 실제 분포에 맞게 다시 정해지므로 lo, hi는 예상 범위면 충분하다.
+rbtree_sharded *new_rbtree_sharded(const size_t k, const key_t lo, const key_t hi) {
+  if(k == 0){
+    return NULL;
+  }
+  rbtree_sharded *s = (rbtree_sharded *)calloc(1, sizeof(rbtree_sharded));
+  if(s == NULL){
+    return NULL;
+  }
+  s->k = k;
+  s->shards = (rbtree_shard *)aligned_alloc(64, k * sizeof(rbtree_shard));
+  s->splits = (key_t *)calloc(k, sizeof(key_t));
+  if(s->shards == NULL || s->splits == NULL){
+    free(s->shards);
+    free(s->splits);
+    free(s);
+    return NULL;
+  }
+
+  for(size_t i = 0; i < k; i++){
+    rbtree_shard *shard = &s->shards[i];
+    pthread_mutex_init(&shard->lock, NULL);
+    shard->tree = new_rbtree();
+    shard->count = 0;
+    shard->limit = SHARD_REBALANCE_MIN;
+    if(shard->tree == NULL){
+      s->k = i + 1;
+      delete_rbtree_sharded(s);
+      return NULL;
+    }
+  }
+  for(size_t i = 1; i < k; i++){
+    s->splits[i - 1] = (key_t)(lo + ((int64_t)hi - lo) * (int64_t)i / (int64_t)k);
+  }
+  return s;
+}
+
+//모든 스레드가 사용을 마친 뒤에 호출해야 한다
+void delete_rbtree_sharded(rbtree_sharded *s) {
+  if(s == NULL){
+    return;
+  }
+  for(size_t i = 0; i < s->k; i++){
+    pthread_mutex_destroy(&s->shards[i].lock);
+    if(s->shards[i].tree != NULL){
+      delete_rbtree(s->shards[i].tree);
+    }
+  }
+  free(s->shards);
+  free(s->splits);
+  free(s);
+}
+
+//key가 속한 shard의 번호 (key 이하인 split의 수)를 이분 탐색으로 구하는 함수
+static size_t route(const rbtree_sharded *s, const key_t key) {
+  size_t lo = 0, hi = s->k - 1;
+  while(lo < hi){
+    size_t mid = (lo + hi) / 2;
+    if(READ(s->splits[mid]) <= key){
+      lo = mid + 1;
+    }
+    else hi = mid;
+  }
+  return lo;
+}
+
+//key가 속한 shard를 잠그고 반환하는 함수.
+//split을 다시 정하는 쪽은 모든 shard를 잠근 채로 layout_seq를 바꾸므로,
+//shard를 잠근 뒤에도 layout_seq가 그대로면 잠그기 전에 구한 shard가 맞다.
+static size_t lock_shard(rbtree_sharded *s, const key_t key) {
+  for(;;){
+    unsigned seq = __atomic_load_n(&s->layout_seq, __ATOMIC_ACQUIRE);
+    size_t i = route(s, key);
+    pthread_mutex_lock(&s->shards[i].lock);
+    if(!(seq & 1) && __atomic_load_n(&s->layout_seq, __ATOMIC_RELAXED) == seq){
+      return i;
+    }
+    pthread_mutex_unlock(&s->shards[i].lock);
+  }
+}
+
+//교착을 피하기 위해 여러 shard는 항상 번호 순서대로 잠근다
+static void lock_all(rbtree_sharded *s) {
+  for(size_t i = 0; i < s->k; i++){
+    pthread_mutex_lock(&s->shards[i].lock);
+  }
+}
+
+static void unlock_range(rbtree_sharded *s, const size_t from, const size_t to) {
+  for(size_t i = from; i < to; i++){
+    pthread_mutex_unlock(&s->shards[i].lock);
+  }
+}
+
+//가장 큰 shard도 k등분한 크기에 가깝도록 split 지점을 다시 정하고 shard들을 다시 만드는 함수.
+//force가 0이면 limit을 넘은 shard가 있을 때만 수행한다. 메모리가 부족하면 -1 반환
+static int rebalance(rbtree_sharded *s, const int force) {
+  const size_t k = s->k;
+  lock_all(s);
+
+  size_t n = 0;
+  int skewed = force;
+  for(size_t i = 0; i < k; i++){
+    n += s->shards[i].count;
+    skewed |= s->shards[i].count > s->shards[i].limit;
+  }
+  if(!skewed){
+    unlock_range(s, 0, k);
+    return 0;
+  }
+
+  //shard들이 key 순서대로 놓여 있으므로 이어 붙이면 전체가 정렬된다
+  key_t *arr = (key_t *)malloc((n ? n : 1) * sizeof(key_t));
+  rbtree **trees = (rbtree **)calloc(k, sizeof(rbtree *));
+  key_t *splits = (key_t *)malloc(k * sizeof(key_t));
+  size_t *bounds = (size_t *)malloc((k + 1) * sizeof(size_t));
+  int ret = -1;
+  if(arr == NULL || trees == NULL || splits == NULL || bounds == NULL){
+    goto out;
+  }
+  size_t off = 0;
+  for(size_t i = 0; i < k; i++){
+    off += rbtree_to_array(s->shards[i].tree, arr + off, n - off);
+  }
+
+  //i번째 split은 (i + 1) * n / k 번째 key. 같은 key는 모두 같은 shard로 가야 하므로
+  //shard i는 그 key가 처음 나오는 곳 (bounds[i + 1]) 직전에서 끝난다.
+  bounds[0] = 0;
+  for(size_t i = 0; i + 1 < k; i++){
+    splits[i] = n ? arr[(i + 1) * n / k] : READ(s->splits[i]);
+    size_t end = bounds[i];
+    while(end < n && arr[end] < splits[i]){
+      end++;
+    }
+    bounds[i + 1] = end;
+  }
+  bounds[k] = n;
+  for(size_t i = 0; i < k; i++){
+    trees[i] = rbtree_from_sorted_array(arr + bounds[i], bounds[i + 1] - bounds[i]);
+    if(trees[i] == NULL){
+      goto out;
+    }
+  }
+
+  //새 shard들을 모두 만든 뒤에 교체
+  __atomic_store_n(&s->layout_seq, s->layout_seq + 1, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+  for(size_t i = 0; i < k; i++){
+    rbtree_shard *shard = &s->shards[i];
+    if(i + 1 < k){
+      __atomic_store_n(&s->splits[i], splits[i], __ATOMIC_RELAXED);
+    }
+    delete_rbtree(shard->tree);
+    shard->tree = trees[i];
+    trees[i] = NULL;
+    shard->count = bounds[i + 1] - bounds[i];
+    //같은 key가 몰려서 더 나눌 수 없는 shard 때문에 매번 다시 정하지 않도록 자기 크기의 두 배까지는 허용
+    size_t limit = 2 * (n / k);
+    if(limit < 2 * shard->count){
+      limit = 2 * shard->count;
+    }
+    shard->limit = limit + SHARD_REBALANCE_MIN;
+  }
+  __atomic_store_n(&s->layout_seq, s->layout_seq + 1, __ATOMIC_RELEASE);
+  ret = 0;
+
+out:
+  if(trees != NULL){
+    for(size_t i = 0; i < k; i++){
+      if(trees[i] != NULL){
+        delete_rbtree(trees[i]);
+      }
+    }
+  }
+  free(bounds);
+  free(splits);
+  free(trees);
+  free(arr);
+  unlock_range(s, 0, k);
+  return ret;
+}
+
+//split 지점을 지금 key 분포에 맞게 다시 정하는 함수. 메모리가 부족하면 -1 반환
+int rbtree_sharded_rebalance(rbtree_sharded *s) {
+  return rebalance(s, 1);
+}
+
+//새 키를 삽입하는 함수. 메모리가 부족하면 -1 반환
+int rbtree_sharded_insert(rbtree_sharded *s, const key_t key) {
+  size_t i = lock_shard(s, key);
+  rbtree_shard *shard = &s->shards[i];
+  node_t *p = rbtree_insert(shard->tree, key);
+  if(p != NULL){
+    shard->count++;
+  }
+  int skewed = shard->count > shard->limit;
+  pthread_mutex_unlock(&shard->lock);
+
+  if(p == NULL){
+    return -1;
+  }
+  if(skewed){
+    rebalance(s, 0);
+  }
+  return 0;
+}
+
+//키 하나를 삭제하는 함수. 키가 없으면 -1 반환
+int rbtree_sharded_erase(rbtree_sharded *s, const key_t key) {
+  size_t i = lock_shard(s, key);
+  rbtree_shard *shard = &s->shards[i];
+  node_t *p = rbtree_find(shard->tree, key);
+  if(p != NULL){
+    rbtree_erase(shard->tree, p);
+    shard->count--;
+  }
+  pthread_mutex_unlock(&shard->lock);
+  return p != NULL ? 0 : -1;
+}
+
+//키가 있으면 1, 없으면 0 반환
+int rbtree_sharded_find(rbtree_sharded *s, const key_t key) {
+  size_t i = lock_shard(s, key);
+  int found = rbtree_find(s->shards[i].tree, key) != NULL;
+  pthread_mutex_unlock(&s->shards[i].lock);
+  return found;
+}
+
+//최소값을 *out에 저장하고 1 반환. 비어있으면 0 반환
+//앞쪽 shard부터 비어있지 않은 shard가 나올 때까지 잠근 채로 진행한다.
+int rbtree_sharded_min(rbtree_sharded *s, key_t *out) {
+  size_t i = 0;
+  int found = 0;
+  for(; i < s->k; i++){
+    pthread_mutex_lock(&s->shards[i].lock);
+    node_t *p = rbtree_min(s->shards[i].tree);
+    if(p != NULL){
+      *out = p->key;
+      found = 1;
+      i++;
+      break;
+    }
+  }
+  unlock_range(s, 0, i);
+  return found;
+}
+
+//최대값을 *out에 저장하고 1 반환. 비어있으면 0 반환
+int rbtree_sharded_max(rbtree_sharded *s, key_t *out) {
+  int found = 0;
+  lock_all(s);
+  for(size_t i = s->k; i-- > 0;){
+    node_t *p = rbtree_max(s->shards[i].tree);
+    if(p != NULL){
+      *out = p->key;
+      found = 1;
+      break;
+    }
+  }
+  unlock_range(s, 0, s->k);
+  return found;
+}
+
+//key보다 큰 첫 키를 *out에 저장하고 1 반환. 없으면 0 반환.
+//key가 속한 shard에 없으면 다음 shard들의 최소값을 순서대로 본다.
+int rbtree_sharded_next(rbtree_sharded *s, const key_t key, key_t *out) {
+  const size_t first = lock_shard(s, key);
+  size_t i = first;
+  int found = 0;
+  node_t *p = rbtree_upper_bound(s->shards[i].tree, key);
+  while(p == NULL && i + 1 < s->k){
+    pthread_mutex_lock(&s->shards[++i].lock);
+    p = rbtree_min(s->shards[i].tree);
+  }
+  if(p != NULL){
+    *out = p->key;
+    found = 1;
+  }
+  unlock_range(s, first, i + 1);
+  return found;
+}
+
+//전체 키의 개수를 반환하는 함수
+size_t rbtree_sharded_size(rbtree_sharded *s) {
+  size_t n = 0;
+  lock_all(s);
+  for(size_t i = 0; i < s->k; i++){
+    n += s->shards[i].count;
+  }
+  unlock_range(s, 0, s->k);
+  return n;
+}
+
+//모든 키를 오름차순으로 최대 n개 arr에 복사하고 개수를 반환하는 함수
+size_t rbtree_sharded_to_array(rbtree_sharded *s, key_t *arr, const size_t n) {
+  size_t off = 0;
+  lock_all(s);
+  for(size_t i = 0; i < s->k && off < n; i++){
+    off += rbtree_to_array(s->shards[i].tree, arr + off, n - off);
+  }
+  unlock_range(s, 0, s->k);
+  return off;
+}
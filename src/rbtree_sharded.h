@@ -0,0 +1,42 @@
+#ifndef _RBTREE_SHARDED_H_
+#define _RBTREE_SHARDED_H_
+
+#include <pthread.h>
+#include <stddef.h>
+
+#include "rbtree.h"
+
+// key 범위로 나눈 K개의 독립된 rbtree.
+// shard i는 [splits[i - 1], splits[i]) 범위의 key를 가지며 (양 끝 shard는 끝이 열려 있음)
+// 각자 mutex를 가지므로 서로 다른 shard로 가는 쓰기는 동시에 진행된다.
+// shard들이 key 순서대로 놓여 있으므로 전체 순서가 필요한 연산은 shard들을 차례로 이어 붙이면 된다.
+typedef struct {
+  pthread_mutex_t lock;
+  rbtree *tree;
+  size_t count;
+  size_t limit;  // count가 이보다 커지면 split 지점을 다시 정한다
+} __attribute__((aligned(64))) rbtree_shard;
+
+typedef struct {
+  rbtree_shard *shards;
+  key_t *splits;        // k - 1개의 경계 key (오름차순)
+  size_t k;
+  unsigned layout_seq;  // split을 다시 정하는 동안 홀수
+} rbtree_sharded;
+
+rbtree_sharded *new_rbtree_sharded(const size_t, const key_t, const key_t);
+void delete_rbtree_sharded(rbtree_sharded *);
+
+int rbtree_sharded_insert(rbtree_sharded *, const key_t);
+int rbtree_sharded_erase(rbtree_sharded *, const key_t);
+int rbtree_sharded_find(rbtree_sharded *, const key_t);
+
+int rbtree_sharded_min(rbtree_sharded *, key_t *);
+int rbtree_sharded_max(rbtree_sharded *, key_t *);
+int rbtree_sharded_next(rbtree_sharded *, const key_t, key_t *);
+size_t rbtree_sharded_size(rbtree_sharded *);
+size_t rbtree_sharded_to_array(rbtree_sharded *, key_t *, const size_t);
+
+int rbtree_sharded_rebalance(rbtree_sharded *);
+
+#endif  // _RBTREE_SHARDED_H_
@@ -0,0 +1,678 @@
+#include "rbtree_wal.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#define WAL_LOG_MAGIC "RBTWALOG"
+#define WAL_SNAP_MAGIC "RBTWSNAP"
+#define WAL_VERSION 1
+
+//로그의 기록 수가 이보다 적을 때는 (그리고 tree의 key 수보다 적을 때는) 압축하지 않는다
+#define WAL_COMPACT_MIN (1 << 16)
+#define WAL_BUF_INITIAL 256
+
+enum { WAL_INSERT = 1, WAL_ERASE = 2 };
+
+//로그 기록 하나. check는 세대, 로그 안의 순번, 내용으로 만든 값이라서
+//마지막에 반만 쓰인 기록이나 이전 세대의 기록은 재생하지 않는다.
+struct wal_record {
+  uint32_t op;
+  key_t key;
+  uint64_t check;
+};
+
+//로그와 스냅샷 파일의 헤더. 스냅샷은 헤더 뒤에 count개의 key가 오름차순으로 이어진다.
+typedef struct {
+  char magic[8];
+  uint32_t version;
+  uint32_t key_size;
+  uint64_t gen;
+  uint64_t count;         //스냅샷의 key 수 (로그는 0)
+  uint64_t data_check;    //스냅샷 key들의 체크섬 (로그는 0)
+  uint64_t header_check;  //이 필드 앞까지의 체크섬
+} wal_header;
+
+//splitmix64의 마무리 단계
+static uint64_t mix(uint64_t x) {
+  x ^= x >> 30;
+  x *= 0xbf58476d1ce4e5b9ull;
+  x ^= x >> 27;
+  x *= 0x94d049bb133111ebull;
+  return x ^ (x >> 31);
+}
+
+static uint64_t record_check(const uint64_t gen, const uint64_t index, const uint32_t op, const key_t key) {
+  return mix(gen ^ mix(index ^ mix(((uint64_t)op << 32) | (uint32_t)key)));
+}
+
+static uint64_t keys_check(const key_t *keys, const size_t n) {
+  uint64_t h = n;
+  for(size_t i = 0; i < n; i++){
+    h = mix(h ^ (uint32_t)keys[i]);
+  }
+  return h;
+}
+
+static uint64_t header_check(const wal_header *h) {
+  uint64_t words[5];
+  memcpy(words, h, sizeof(words));
+  uint64_t c = 0;
+  for(int i = 0; i < 5; i++){
+    c = mix(c ^ words[i]);
+  }
+  return c;
+}
+
+static void fill_header(wal_header *h, const char *magic, const uint64_t gen, const uint64_t count,
+                        const uint64_t data_check) {
+  memset(h, 0, sizeof(*h));
+  memcpy(h->magic, magic, sizeof(h->magic));
+  h->version = WAL_VERSION;
+  h->key_size = sizeof(key_t);
+  h->gen = gen;
+  h->count = count;
+  h->data_check = data_check;
+  h->header_check = header_check(h);
+}
+
+static int header_valid(const wal_header *h, const char *magic) {
+  return memcmp(h->magic, magic, sizeof(h->magic)) == 0 && h->version == WAL_VERSION &&
+         h->key_size == sizeof(key_t) && h->header_check == header_check(h);
+}
+
+//path 뒤에 suffix를 붙인 새 문자열을 반환하는 함수
+static char *file_path(const char *path, const char *suffix) {
+  size_t a = strlen(path), b = strlen(suffix);
+  char *p = (char *)malloc(a + b + 1);
+  if(p != NULL){
+    memcpy(p, path, a);
+    memcpy(p + a, suffix, b + 1);
+  }
+  return p;
+}
+
+static char *log_path(const rbtree_wal *w, const uint64_t gen) {
+  return file_path(w->path, gen % 2 ? ".log1" : ".log0");
+}
+
+//새로 만들거나 이름을 바꾼 파일이 남도록 파일이 있는 디렉터리를 fsync하는 함수
+static int sync_dir(const char *path) {
+  const char *slash = strrchr(path, '/');
+  char *dir = slash == NULL ? file_path(".", "") : strndup(path, slash == path ? 1 : (size_t)(slash - path));
+  if(dir == NULL){
+    return -1;
+  }
+  int fd = open(dir, O_RDONLY);
+  free(dir);
+  if(fd < 0){
+    return -1;
+  }
+  int ret = fsync(fd);
+  close(fd);
+  return ret;
+}
+
+static int write_all(const int fd, const void *data, size_t len) {
+  const char *p = (const char *)data;
+  while(len > 0){
+    ssize_t n = write(fd, p, len);
+    if(n < 0){
+      if(errno == EINTR){
+        continue;
+      }
+      return -1;
+    }
+    p += n;
+    len -= (size_t)n;
+  }
+  return 0;
+}
+
+//파일 전체를 읽어서 반환하는 함수. 파일이 없으면 NULL을 반환하고 *missing을 1로 만든다
+static char *read_file(const char *path, size_t *len, int *missing) {
+  *missing = 0;
+  int fd = open(path, O_RDONLY);
+  if(fd < 0){
+    *missing = errno == ENOENT;
+    return NULL;
+  }
+  struct stat st;
+  char *data = NULL;
+  if(fstat(fd, &st) == 0){
+    *len = (size_t)st.st_size;
+    data = (char *)malloc(*len ? *len : 1);
+  }
+  size_t off = 0;
+  while(data != NULL && off < *len){
+    ssize_t n = read(fd, data + off, *len - off);
+    if(n < 0 && errno == EINTR){
+      continue;
+    }
+    if(n <= 0){
+      free(data);
+      data = NULL;
+      break;
+    }
+    off += (size_t)n;
+  }
+  close(fd);
+  return data;
+}
+
+//세대 gen의 스냅샷을 임시 파일에 다 쓴 뒤 path.snap으로 이름을 바꾸는 함수. 실패하면 -1 반환
+static int write_snapshot(const rbtree_wal *w, const uint64_t gen, const key_t *keys, const size_t n) {
+  char *snap = file_path(w->path, ".snap");
+  char *tmp = file_path(w->path, ".snap.tmp");
+  int ret = -1;
+  if(snap != NULL && tmp != NULL){
+    wal_header h;
+    fill_header(&h, WAL_SNAP_MAGIC, gen, n, keys_check(keys, n));
+    int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if(fd >= 0){
+      int ok = write_all(fd, &h, sizeof(h)) == 0 && write_all(fd, keys, n * sizeof(key_t)) == 0 &&
+               fsync(fd) == 0;
+      ok = close(fd) == 0 && ok;
+      if(ok && rename(tmp, snap) == 0 && sync_dir(snap) == 0){
+        ret = 0;
+      }
+      else unlink(tmp);
+    }
+  }
+  free(tmp);
+  free(snap);
+  return ret;
+}
+
+//세대 gen의 빈 로그를 만들고 파일 기술자를 반환하는 함수. 실패하면 -1 반환
+static int create_log(const rbtree_wal *w, const uint64_t gen) {
+  char *path = log_path(w, gen);
+  if(path == NULL){
+    return -1;
+  }
+  wal_header h;
+  fill_header(&h, WAL_LOG_MAGIC, gen, 0, 0);
+  int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if(fd >= 0 && (write_all(fd, &h, sizeof(h)) != 0 || fsync(fd) != 0 || sync_dir(path) != 0)){
+    close(fd);
+    fd = -1;
+  }
+  free(path);
+  return fd;
+}
+
+//path.snap을 읽어서 tree를 bulk load하는 함수. 스냅샷이 없으면 세대 0의 빈 tree로 시작한다.
+//스냅샷이 있는데 손상되었으면 데이터를 잃지 않도록 -1 반환
+static int load_snapshot(rbtree_wal *w, uint64_t *gen, size_t *count) {
+  char *snap = file_path(w->path, ".snap");
+  if(snap == NULL){
+    return -1;
+  }
+  size_t len = 0;
+  int missing;
+  char *data = read_file(snap, &len, &missing);
+  free(snap);
+  if(data == NULL){
+    *gen = 0;
+    *count = 0;
+    w->tree = new_rbtree();
+    return missing && w->tree != NULL ? 0 : -1;
+  }
+
+  const wal_header *h = (const wal_header *)data;
+  const key_t *keys = (const key_t *)(data + sizeof(wal_header));
+  int ok = len >= sizeof(wal_header) && header_valid(h, WAL_SNAP_MAGIC) &&
+           len == sizeof(wal_header) + h->count * sizeof(key_t) && h->data_check == keys_check(keys, h->count);
+  if(ok){
+    //스냅샷은 정렬되어 있으므로 회전 없이 O(N)에 만든다
+    w->tree = rbtree_from_sorted_array(keys, h->count);
+    *gen = h->gen;
+    *count = h->count;
+  }
+  free(data);
+  return ok && w->tree != NULL ? 0 : -1;
+}
+
+//세대 gen의 로그를 읽어서 tree에 재생하는 함수. 로그가 없거나 다른 세대면 0, 재생했으면 1, 실패하면 -1 반환.
+//연속된 삽입은 모아서 rbtree_insert_batch로 넣고, 삭제를 만나면 그 전까지 모은 삽입을 먼저 넣는다.
+//*records에는 앞에서부터 온전한 기록의 수를 저장한다.
+static int replay_log(rbtree_wal *w, const uint64_t gen, uint64_t *records, size_t *count) {
+  char *path = log_path(w, gen);
+  if(path == NULL){
+    return -1;
+  }
+  size_t len = 0;
+  int missing;
+  char *data = read_file(path, &len, &missing);
+  free(path);
+  if(data == NULL){
+    return missing ? 0 : -1;
+  }
+  const wal_header *h = (const wal_header *)data;
+  if(len < sizeof(wal_header) || !header_valid(h, WAL_LOG_MAGIC) || h->gen != gen){
+    free(data);
+    return 0;
+  }
+
+  const wal_record *rec = (const wal_record *)(data + sizeof(wal_header));
+  const size_t n = (len - sizeof(wal_header)) / sizeof(wal_record);
+  key_t *pending = (key_t *)malloc((n ? n : 1) * sizeof(key_t));
+  size_t np = 0;
+  int ret = pending != NULL ? 1 : -1;
+  size_t i = 0;
+  for(; ret == 1 && i < n; i++){
+    if(rec[i].check != record_check(gen, i, rec[i].op, rec[i].key)){
+      //여기부터는 쓰다가 멈춘 기록이다
+      break;
+    }
+    if(rec[i].op == WAL_INSERT){
+      pending[np++] = rec[i].key;
+      continue;
+    }
+    if(rbtree_insert_batch(w->tree, pending, np) != 0){
+      ret = -1;
+      break;
+    }
+    *count += np;
+    np = 0;
+    node_t *p = rbtree_find(w->tree, rec[i].key);
+    if(p != NULL){
+      rbtree_erase(w->tree, p);
+      (*count)--;
+    }
+  }
+  if(ret == 1){
+    if(rbtree_insert_batch(w->tree, pending, np) != 0){
+      ret = -1;
+    }
+    *count += np;
+  }
+  *records = i;
+  free(pending);
+  free(data);
+  return ret;
+}
+
+//세대 gen의 로그가 온전한 헤더와 함께 있으면 1 반환
+static int log_exists(const rbtree_wal *w, const uint64_t gen) {
+  char *path = log_path(w, gen);
+  if(path == NULL){
+    return 0;
+  }
+  wal_header h;
+  int fd = open(path, O_RDONLY);
+  free(path);
+  if(fd < 0){
+    return 0;
+  }
+  int ok = read(fd, &h, sizeof(h)) == (ssize_t)sizeof(h) && header_valid(&h, WAL_LOG_MAGIC) && h.gen == gen;
+  close(fd);
+  return ok;
+}
+
+//세대 gen의 로그를 온전한 records개의 기록 뒤에서부터 이어 쓰도록 여는 함수
+static int open_log_for_append(const rbtree_wal *w, const uint64_t gen, const uint64_t records) {
+  char *path = log_path(w, gen);
+  if(path == NULL){
+    return -1;
+  }
+  int fd = open(path, O_WRONLY);
+  free(path);
+  if(fd < 0){
+    return -1;
+  }
+  off_t end = (off_t)(sizeof(wal_header) + records * sizeof(wal_record));
+  if(ftruncate(fd, end) != 0 || lseek(fd, end, SEEK_SET) != end || fsync(fd) != 0){
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+static void *flusher_main(void *);
+
+//path.snap과 로그들로 tree를 복구하고 로그를 이어서 기록하는 rbtree_wal을 반환하는 함수.
+//commit_us는 group commit으로 기록을 모으는 시간 (마이크로초)이다. 복구할 수 없으면 NULL 반환
+rbtree_wal *rbtree_wal_open(const char *path, const unsigned commit_us) {
+  rbtree_wal *w = (rbtree_wal *)calloc(1, sizeof(rbtree_wal));
+  if(w == NULL){
+    return NULL;
+  }
+  w->path = file_path(path, "");
+  w->fd = -1;
+  w->commit_us = commit_us;
+  w->buf_cap = w->spare_cap = WAL_BUF_INITIAL;
+  w->buf = (wal_record *)malloc(w->buf_cap * sizeof(wal_record));
+  w->spare = (wal_record *)malloc(w->spare_cap * sizeof(wal_record));
+  pthread_mutex_init(&w->lock, NULL);
+  pthread_cond_init(&w->work, NULL);
+  pthread_cond_init(&w->done, NULL);
+  if(w->path == NULL || w->buf == NULL || w->spare == NULL){
+    goto fail;
+  }
+
+  uint64_t gen, records = 0;
+  if(load_snapshot(w, &gen, &w->count) != 0 || replay_log(w, gen, &records, &w->count) < 0){
+    goto fail;
+  }
+
+  //압축 도중에 멈췄으면 다음 세대의 로그도 있다. 그 로그가 시작한 시점의 스냅샷을 먼저 완성한 뒤
+  //재생해야 다음 압축이 세대 gen의 로그를 덮어써도 잃는 기록이 없다.
+  int next = log_exists(w, gen + 1);
+  if(next){
+    key_t *keys = (key_t *)malloc((w->count ? w->count : 1) * sizeof(key_t));
+    if(keys == NULL){
+      goto fail;
+    }
+    rbtree_to_array(w->tree, keys, w->count);
+    int ret = write_snapshot(w, gen + 1, keys, w->count);
+    free(keys);
+    if(ret != 0 || replay_log(w, gen + 1, &records, &w->count) < 0){
+      goto fail;
+    }
+    gen++;
+  }
+
+  w->snap_gen = w->log_gen = gen;
+  w->log_records = records;
+  if(records > 0 || next){
+    w->fd = open_log_for_append(w, gen, records);
+  }
+  else {
+    //온전한 기록이 없으면 로그를 새로 만든다 (처음 시작했거나 헤더만 있는 경우)
+    w->fd = create_log(w, gen);
+  }
+  if(w->fd < 0 || pthread_create(&w->flusher, NULL, flusher_main, w) != 0){
+    goto fail;
+  }
+  return w;
+
+fail:
+  if(w->fd >= 0){
+    close(w->fd);
+  }
+  if(w->tree != NULL){
+    delete_rbtree(w->tree);
+  }
+  pthread_cond_destroy(&w->done);
+  pthread_cond_destroy(&w->work);
+  pthread_mutex_destroy(&w->lock);
+  free(w->spare);
+  free(w->buf);
+  free(w->path);
+  free(w);
+  return NULL;
+}
+
+static void *compactor_main(void *);
+
+//로그가 스냅샷보다 커졌으면 백그라운드 압축을 시작하는 함수. lock을 잡은 채로 호출한다
+static void maybe_compact(rbtree_wal *w) {
+  if(w->compacting || w->stop || w->failed || w->snap_gen != w->log_gen ||
+     w->log_records < WAL_COMPACT_MIN || w->log_records < w->count){
+    return;
+  }
+  //이전 압축 스레드는 compacting을 0으로 만든 뒤 끝나므로 바로 회수된다
+  if(w->compactor_started){
+    pthread_join(w->compactor, NULL);
+    w->compactor_started = 0;
+  }
+  w->compacting = 1;
+  if(pthread_create(&w->compactor, NULL, compactor_main, w) == 0){
+    w->compactor_started = 1;
+  }
+  else w->compacting = 0;
+}
+
+//내려 쓰지 못한 기록 n개의 변경을 tree에서 되돌리는 함수. lock을 잡은 채로 호출한다.
+//기록된 순서의 역순으로 되돌리므로 되돌릴 때마다 tree는 그 기록을 적용한 직후의 상태이고, key로 찾아도 된다.
+static void undo_records(rbtree_wal *w, const wal_record *recs, size_t n) {
+  while(n > 0){
+    const wal_record *r = &recs[--n];
+    if(r->op == WAL_INSERT){
+      node_t *p = rbtree_find(w->tree, r->key);
+      if(p != NULL){
+        rbtree_erase(w->tree, p);
+        w->count--;
+      }
+    }
+    else if(rbtree_insert(w->tree, r->key) != NULL){
+      w->count++;
+    }
+  }
+}
+
+//로그를 쓰다 실패했을 때 lock을 잡은 채로 호출하는 함수. 이후의 변경은 모두 -1을 반환한다.
+//쓰던 batch와 그 뒤에 버퍼에 쌓인 기록의 변경을 되돌려서 tree가 디스크에 내려간 기록까지의 상태가 되게 하고,
+//write는 되고 fdatasync만 실패했으면 그 기록들을 다시 열 때 재생하지 않도록 로그를 잘라낸다.
+static void fail_log(rbtree_wal *w, const wal_record *batch, const size_t n) {
+  w->failed = 1;
+  undo_records(w, w->buf, w->buf_len);
+  undo_records(w, batch, n);
+  w->log_records -= n + w->buf_len;
+  w->buf_len = 0;
+  if(ftruncate(w->fd, (off_t)(sizeof(wal_header) + w->log_records * sizeof(wal_record))) == 0){
+    fdatasync(w->fd);
+  }
+}
+
+//버퍼에 쌓인 기록을 commit_us마다 한 번의 write와 fdatasync로 내려 쓰는 스레드.
+//쓰는 동안에는 lock을 놓고 다른 버퍼를 쓰게 하므로 writer들은 다음 묶음에 계속 기록을 넣을 수 있다.
+static void *flusher_main(void *arg) {
+  rbtree_wal *w = (rbtree_wal *)arg;
+  pthread_mutex_lock(&w->lock);
+  for(;;){
+    while(w->buf_len == 0 && !w->stop){
+      pthread_cond_wait(&w->work, &w->lock);
+    }
+    if(w->buf_len == 0){
+      break;
+    }
+    //같은 fdatasync를 함께 쓰도록 다른 writer들의 기록을 잠시 더 모은다
+    if(w->commit_us > 0 && !w->stop){
+      pthread_mutex_unlock(&w->lock);
+      struct timespec ts = {w->commit_us / 1000000, (long)(w->commit_us % 1000000) * 1000};
+      nanosleep(&ts, NULL);
+      pthread_mutex_lock(&w->lock);
+    }
+    //기다리는 동안 압축이 버퍼를 비웠을 수 있다
+    if(w->buf_len == 0){
+      continue;
+    }
+
+    wal_record *batch = w->buf;
+    const size_t n = w->buf_len, cap = w->buf_cap;
+    w->buf = w->spare;
+    w->buf_cap = w->spare_cap;
+    w->buf_len = 0;
+    const uint64_t target = w->appended;
+    const int fd = w->fd;
+    w->flushing = 1;
+    pthread_mutex_unlock(&w->lock);
+
+    int ok = write_all(fd, batch, n * sizeof(wal_record)) == 0 && fdatasync(fd) == 0;
+
+    pthread_mutex_lock(&w->lock);
+    w->spare = batch;
+    w->spare_cap = cap;
+    w->flushing = 0;
+    if(ok){
+      w->durable = target;
+    }
+    else fail_log(w, batch, n);
+    pthread_cond_broadcast(&w->done);
+    maybe_compact(w);
+  }
+  pthread_mutex_unlock(&w->lock);
+  return NULL;
+}
+
+//세대 g의 로그를 마저 쓰고 닫은 뒤 세대 g + 1의 로그로 바꾸고, 그 시점의 key들을 세대 g + 1의 스냅샷으로 쓰는 함수.
+//key를 복사하는 동안만 lock을 잡고, 스냅샷은 lock 없이 쓰므로 그동안에도 변경은 새 로그에 기록된다.
+//도중에 멈추면 세대 g의 스냅샷과 g, g + 1의 로그가 남으므로 다시 열 때 둘 다 재생한다.
+//호출하기 전에 compacting을 1로 만들어야 한다. 실패하면 -1 반환
+static int compact(rbtree_wal *w) {
+  pthread_mutex_lock(&w->lock);
+  while(w->flushing){
+    pthread_cond_wait(&w->done, &w->lock);
+  }
+  int ok = !w->failed;
+  if(ok && w->buf_len > 0){
+    ok = write_all(w->fd, w->buf, w->buf_len * sizeof(wal_record)) == 0 && fdatasync(w->fd) == 0;
+    if(ok){
+      w->buf_len = 0;
+      w->durable = w->appended;
+    }
+    else fail_log(w, NULL, 0);
+    pthread_cond_broadcast(&w->done);
+  }
+
+  const size_t n = w->count;
+  key_t *keys = ok ? (key_t *)malloc((n ? n : 1) * sizeof(key_t)) : NULL;
+  int fd = keys != NULL ? create_log(w, w->log_gen + 1) : -1;
+  uint64_t gen = 0;
+  if(fd >= 0){
+    rbtree_to_array(w->tree, keys, n);
+    close(w->fd);
+    w->fd = fd;
+    w->log_gen++;
+    w->log_records = 0;
+    gen = w->log_gen;
+  }
+  pthread_mutex_unlock(&w->lock);
+
+  int ret = fd >= 0 ? write_snapshot(w, gen, keys, n) : -1;
+  free(keys);
+
+  pthread_mutex_lock(&w->lock);
+  //스냅샷을 쓰지 못했으면 세대 gen - 1의 로그가 계속 필요하므로 다시 열 때까지 압축하지 않는다
+  if(ret == 0){
+    w->snap_gen = gen;
+  }
+  w->compacting = 0;
+  pthread_cond_broadcast(&w->done);
+  pthread_mutex_unlock(&w->lock);
+  return ret;
+}
+
+static void *compactor_main(void *arg) {
+  compact((rbtree_wal *)arg);
+  return NULL;
+}
+
+//지금 상태로 스냅샷을 새로 쓰고 로그를 비우는 함수. 완료될 때까지 기다린다. 실패하면 -1 반환
+int rbtree_wal_compact(rbtree_wal *w) {
+  pthread_mutex_lock(&w->lock);
+  while(w->compacting){
+    pthread_cond_wait(&w->done, &w->lock);
+  }
+  if(w->failed || w->snap_gen != w->log_gen){
+    pthread_mutex_unlock(&w->lock);
+    return -1;
+  }
+  w->compacting = 1;
+  pthread_mutex_unlock(&w->lock);
+  return compact(w);
+}
+
+//남은 기록을 모두 내려 쓰고 닫는 함수
+void rbtree_wal_close(rbtree_wal *w) {
+  if(w == NULL){
+    return;
+  }
+  pthread_mutex_lock(&w->lock);
+  w->stop = 1;
+  pthread_cond_signal(&w->work);
+  pthread_mutex_unlock(&w->lock);
+  pthread_join(w->flusher, NULL);
+  if(w->compactor_started){
+    pthread_join(w->compactor, NULL);
+  }
+
+  close(w->fd);
+  delete_rbtree(w->tree);
+  pthread_cond_destroy(&w->done);
+  pthread_cond_destroy(&w->work);
+  pthread_mutex_destroy(&w->lock);
+  free(w->spare);
+  free(w->buf);
+  free(w->path);
+  free(w);
+}
+
+//기록을 버퍼에 넣을 자리를 확보하는 함수. tree를 고치기 전에 호출해서 기록이 빠지지 않게 한다
+static int reserve_record(rbtree_wal *w) {
+  if(w->buf_len < w->buf_cap){
+    return 0;
+  }
+  wal_record *buf = (wal_record *)realloc(w->buf, 2 * w->buf_cap * sizeof(wal_record));
+  if(buf == NULL){
+    return -1;
+  }
+  w->buf = buf;
+  w->buf_cap *= 2;
+  return 0;
+}
+
+//기록을 버퍼에 넣고 flusher가 내려 쓸 때까지 기다리는 함수. lock을 잡은 채로 호출한다.
+//tree는 기록을 넣기 전에 고쳐 두고, 내려 쓰지 못하면 fail_log가 되돌린 뒤 -1을 반환한다
+static int append_and_wait(rbtree_wal *w, const uint32_t op, const key_t key) {
+  wal_record *rec = &w->buf[w->buf_len++];
+  rec->op = op;
+  rec->key = key;
+  rec->check = record_check(w->log_gen, w->log_records++, op, key);
+  const uint64_t lsn = ++w->appended;
+  pthread_cond_signal(&w->work);
+
+  while(w->durable < lsn && !w->failed){
+    pthread_cond_wait(&w->done, &w->lock);
+  }
+  return w->durable >= lsn ? 0 : -1;
+}
+
+//새 키를 삽입하고 로그가 디스크에 내려간 뒤 반환하는 함수. 메모리가 부족하거나 로그를 쓸 수 없으면 tree를 바꾸지 않고 -1 반환
+int rbtree_wal_insert(rbtree_wal *w, const key_t key) {
+  pthread_mutex_lock(&w->lock);
+  int ret = -1;
+  if(!w->failed && reserve_record(w) == 0 && rbtree_insert(w->tree, key) != NULL){
+    w->count++;
+    ret = append_and_wait(w, WAL_INSERT, key);
+  }
+  pthread_mutex_unlock(&w->lock);
+  return ret;
+}
+
+//키 하나를 삭제하고 로그가 디스크에 내려간 뒤 반환하는 함수. 키가 없거나 로그를 쓸 수 없으면 tree를 바꾸지 않고 -1 반환
+int rbtree_wal_erase(rbtree_wal *w, const key_t key) {
+  pthread_mutex_lock(&w->lock);
+  int ret = -1;
+  node_t *p = w->failed || reserve_record(w) != 0 ? NULL : rbtree_find(w->tree, key);
+  if(p != NULL){
+    rbtree_erase(w->tree, p);
+    w->count--;
+    ret = append_and_wait(w, WAL_ERASE, key);
+  }
+  pthread_mutex_unlock(&w->lock);
+  return ret;
+}
+
+//키가 있으면 1, 없으면 0 반환
+int rbtree_wal_find(rbtree_wal *w, const key_t key) {
+  pthread_mutex_lock(&w->lock);
+  int found = rbtree_find(w->tree, key) != NULL;
+  pthread_mutex_unlock(&w->lock);
+  return found;
+}
+
+//모든 키를 오름차순으로 최대 n개 arr에 복사하고 개수를 반환하는 함수
+size_t rbtree_wal_to_array(rbtree_wal *w, key_t *arr, const size_t n) {
+  pthread_mutex_lock(&w->lock);
+  size_t count = rbtree_to_array(w->tree, arr, n);
+  pthread_mutex_unlock(&w->lock);
+  return count;
+}
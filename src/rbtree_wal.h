@@ -0,0 +1,57 @@
+#ifndef _RBTREE_WAL_H_
+#define _RBTREE_WAL_H_
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "rbtree.h"
+
+// 변경마다 로그에 기록해서 재시작 후에도 남는 rbtree.
+// path.snap은 어떤 시점의 모든 key를, path.log0 / path.log1은 그 뒤의 삽입/삭제를 순서대로 가진다.
+// 파일마다 세대 번호가 있어서, 세대 g의 스냅샷 뒤에는 세대 g (와 압축 도중이었다면 g + 1)의 로그만 재생한다.
+// 여러 스레드의 기록은 commit_us 동안 모았다가 한 번의 fdatasync로 내려 쓴다 (group commit).
+typedef struct wal_record wal_record;
+
+typedef struct {
+  rbtree *tree;
+  char *path;
+
+  pthread_mutex_t lock;    // tree, 버퍼, 번호들을 보호
+  pthread_cond_t work;     // 버퍼에 기록이 생겼거나 종료할 때 flusher를 깨운다
+  pthread_cond_t done;     // durable이 늘었거나 flush가 끝났을 때 기다리는 스레드들을 깨운다
+  pthread_t flusher;
+  pthread_t compactor;
+  int compactor_started;
+
+  int fd;                  // 지금 기록하는 로그
+  uint64_t log_gen;        // 지금 로그의 세대
+  uint64_t snap_gen;       // 마지막으로 완성된 스냅샷의 세대
+  uint64_t log_records;    // 지금 로그에 있는 (버퍼 포함) 기록 수
+  size_t count;            // tree의 key 수
+
+  wal_record *buf;         // 아직 쓰지 않은 기록들
+  size_t buf_len, buf_cap;
+  wal_record *spare;       // flusher가 쓰는 동안 buf와 맞바꿔 쓰는 버퍼
+  size_t spare_cap;
+  uint64_t appended;       // 버퍼에 넣은 기록의 누적 번호
+  uint64_t durable;        // 디스크에 내려간 기록의 누적 번호
+  unsigned commit_us;
+
+  int flushing;            // flusher가 버퍼 밖에서 쓰는 중
+  int compacting;
+  int stop;
+  int failed;              // 로그 쓰기가 실패하면 이후의 변경은 -1
+} rbtree_wal;
+
+rbtree_wal *rbtree_wal_open(const char *, const unsigned);
+void rbtree_wal_close(rbtree_wal *);
+
+int rbtree_wal_insert(rbtree_wal *, const key_t);
+int rbtree_wal_erase(rbtree_wal *, const key_t);
+int rbtree_wal_find(rbtree_wal *, const key_t);
+size_t rbtree_wal_to_array(rbtree_wal *, key_t *, const size_t);
+
+int rbtree_wal_compact(rbtree_wal *);
+
+#endif  // _RBTREE_WAL_H_
@@ -1,8 +1,22 @@
 #include <assert.h>
 #include "../src/rbtree.h"
+#include "../src/rbtree_compact.h"
+#include "../src/rbtree_concurrent.h"
+#include "../src/rbtree_counted.h"
+#include "../src/rbtree_frozen.h"
+#include "../src/rbtree_generic.h"
+#include "../src/rbtree_persistent.h"
+#include "../src/rbtree_sharded.h"
+#include "../src/rbtree_wal.h"
+#include <fcntl.h>
+#include <pthread.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
 
 // new_rbtree should return rbtree struct with null root node
 void test_init(void) {
@@ -135,12 +149,39 @@ void test_to_array(rbtree *t, const key_t *arr, const size_t n) {
 
   key_t *res = calloc(n, sizeof(key_t));
   rbtree_to_array(t, res, n);
-  for (int i = 0; i < n; i++) {
+  for (size_t i = 0; i < n; i++) {
     assert(arr[i] == res[i]);
   }
   free(res);
 }
 
+// to_array should stop after n keys and report how many keys were written
+void test_to_array_bounded() {
+  rbtree *t = new_rbtree();
+  assert(t != NULL);
+
+  key_t entries[] = {10, 5, 8, 34, 67, 23, 156, 24, 2, 12, 24, 36, 990, 25};
+  const size_t n = sizeof(entries) / sizeof(entries[0]);
+  insert_arr(t, entries, n);
+  qsort((void *)entries, n, sizeof(key_t), comp);
+
+  key_t res[n + 1];
+  const key_t guard = -1;
+  for (size_t k = 0; k <= n; k++) {
+    for (size_t i = 0; i <= n; i++) {
+      res[i] = guard;
+    }
+    assert(rbtree_to_array(t, res, k) == k);
+    for (size_t i = 0; i < k; i++) {
+      assert(res[i] == entries[i]);
+    }
+    assert(res[k] == guard);
+  }
+  assert(rbtree_to_array(t, res, n + 1) == n);
+
+  delete_rbtree(t);
+}
+
 void test_multi_instance() {
   rbtree *t1 = new_rbtree();
   assert(t1 != NULL);
@@ -159,13 +200,13 @@ void test_multi_instance() {
 
   key_t *res1 = calloc(n1, sizeof(key_t));
   rbtree_to_array(t1, res1, n1);
-  for (int i = 0; i < n1; i++) {
+  for (size_t i = 0; i < n1; i++) {
     assert(arr1[i] == res1[i]);
   }
 
   key_t *res2 = calloc(n2, sizeof(key_t));
   rbtree_to_array(t2, res2, n2);
-  for (int i = 0; i < n2; i++) {
+  for (size_t i = 0; i < n2; i++) {
     assert(arr2[i] == res2[i]);
   }
 
@@ -311,12 +352,12 @@ void test_to_array_suite() {
 }
 
 void test_find_erase(rbtree *t, const key_t *arr, const size_t n) {
-  for (int i = 0; i < n; i++) {
+  for (size_t i = 0; i < n; i++) {
     node_t *p = rbtree_insert(t, arr[i]);
     assert(p != NULL);
   }
 
-  for (int i = 0; i < n; i++) {
+  for (size_t i = 0; i < n; i++) {
     node_t *p = rbtree_find(t, arr[i]);
     // printf("arr[%d] = %d\n", i, arr[i]);
     assert(p != NULL);
@@ -324,12 +365,12 @@ void test_find_erase(rbtree *t, const key_t *arr, const size_t n) {
     rbtree_erase(t, p);
   }
 
-  for (int i = 0; i < n; i++) {
+  for (size_t i = 0; i < n; i++) {
     node_t *p = rbtree_find(t, arr[i]);
     assert(p == NULL);
   }
 
-  for (int i = 0; i < n; i++) {
+  for (size_t i = 0; i < n; i++) {
     node_t *p = rbtree_insert(t, arr[i]);
     assert(p != NULL);
     node_t *q = rbtree_find(t, arr[i]);
@@ -357,7 +398,7 @@ void test_find_erase_rand(const size_t n, const unsigned int seed) {
   srand(seed);
   rbtree *t = new_rbtree();
   key_t *arr = calloc(n, sizeof(key_t));
-  for (int i = 0; i < n; i++) {
+  for (size_t i = 0; i < n; i++) {
     arr[i] = rand();
   }
 
@@ -367,17 +408,1994 @@ void test_find_erase_rand(const size_t n, const unsigned int seed) {
   delete_rbtree(t);
 }
 
-int main(void) {
-  test_init();
-  test_insert_single(1024);
-  test_find_single(512, 1024);
-  test_erase_root(128);
-  test_find_erase_fixed();
-  test_minmax_suite();
-  test_to_array_suite();
+// next/prev should visit every node in key order in both directions
+void test_next_prev(const key_t *arr, const size_t n) {
+  rbtree *t = new_rbtree();
+  assert(t != NULL);
+  insert_arr(t, arr, n);
+
+  key_t *sorted = calloc(n, sizeof(key_t));
+  for (size_t i = 0; i < n; i++) {
+    sorted[i] = arr[i];
+  }
+  qsort((void *)sorted, n, sizeof(key_t), comp);
+
+  size_t i = 0;
+  for (node_t *p = rbtree_min(t); p != NULL; p = rbtree_next(t, p)) {
+    assert(i < n);
+    assert(p->key == sorted[i++]);
+  }
+  assert(i == n);
+
+  for (node_t *p = rbtree_max(t); p != NULL; p = rbtree_prev(t, p)) {
+    assert(i > 0);
+    assert(p->key == sorted[--i]);
+  }
+  assert(i == 0);
+
+  free(sorted);
+  delete_rbtree(t);
+}
+
+// a cursor should return exactly the keys in [lo, hi) in order
+void test_range_cursor() {
+  const key_t entries[] = {10, 5, 5, 34, 6, 23, 12, 12, 6, 12, 40, 1};
+  const size_t n = sizeof(entries) / sizeof(entries[0]);
+  rbtree *t = new_rbtree();
+  insert_arr(t, entries, n);
+
+  key_t sorted[n];
+  for (size_t i = 0; i < n; i++) {
+    sorted[i] = entries[i];
+  }
+  qsort((void *)sorted, n, sizeof(key_t), comp);
+
+  for (key_t lo = 0; lo <= 42; lo++) {
+    for (key_t hi = lo - 1; hi <= 42; hi++) {
+      rbtree_cursor c;
+      rbtree_range(t, &c, lo, hi);
+      size_t i = 0;
+      while (i < n && sorted[i] < lo) {
+        i++;
+      }
+      node_t *p;
+      while ((p = rbtree_cursor_next(&c)) != NULL) {
+        assert(i < n && sorted[i] < hi);
+        assert(p->key == sorted[i++]);
+      }
+      assert(i == n || sorted[i] >= hi || lo >= hi);
+      assert(rbtree_cursor_next(&c) == NULL);
+    }
+  }
+
+  delete_rbtree(t);
+}
+
+// lower/upper bound and equal_range should agree with a sorted array
+// even for heavily duplicated keys
+void test_bounds(const size_t n, const key_t range, const unsigned int seed) {
+  rbtree *t = new_rbtree();
+  key_t *arr = calloc(n, sizeof(key_t));
+  srand(seed);
+  for (size_t i = 0; i < n; i++) {
+    arr[i] = rand() % range;
+  }
+  insert_arr(t, arr, n);
+  qsort((void *)arr, n, sizeof(key_t), comp);
+
+  for (key_t key = -1; key <= range; key++) {
+    size_t lo = 0, hi = 0;
+    while (lo < n && arr[lo] < key) {
+      lo++;
+    }
+    hi = lo;
+    while (hi < n && arr[hi] == key) {
+      hi++;
+    }
+
+    node_t *lb = rbtree_lower_bound(t, key);
+    node_t *ub = rbtree_upper_bound(t, key);
+    assert(lo == n ? lb == NULL : (lb != NULL && lb->key == arr[lo]));
+    assert(hi == n ? ub == NULL : (ub != NULL && ub->key == arr[hi]));
+    assert(lb == NULL || rbtree_prev(t, lb) == NULL ||
+           rbtree_prev(t, lb)->key < key);
+
+    node_t *first, *last;
+    rbtree_equal_range(t, key, &first, &last);
+    assert(first == lb);
+    assert(last == ub);
+
+    size_t count = 0;
+    for (node_t *p = first; p != last; p = rbtree_next(t, p)) {
+      assert(p->key == key);
+      count++;
+    }
+    assert(count == hi - lo);
+    assert(rbtree_count(t, key) == hi - lo);
+  }
+
+  free(arr);
+  delete_rbtree(t);
+}
+
+#if RBTREE_ORDER_STATS
+// every node's size should be the number of nodes in its subtree
+static size_t size_traverse(const node_t *p, const node_t *nil) {
+  if (p == nil) {
+    return 0;
+  }
+  size_t size =
+      size_traverse(p->left, nil) + size_traverse(p->right, nil) + 1;
+  assert(p->size == size);
+  return size;
+}
+
+// select/rank/size should agree with a sorted array while keys are
+// inserted and erased
+void test_order_statistics(const size_t n, const key_t range,
+                           const unsigned int seed) {
+  rbtree *t = new_rbtree();
+  key_t *arr = calloc(n, sizeof(key_t));
+  srand(seed);
+  for (size_t i = 0; i < n; i++) {
+    arr[i] = rand() % range;
+  }
+  insert_arr(t, arr, n);
+  assert(rbtree_size(t) == n);
+  assert(size_traverse(t->root, t->nil) == n);
+
+  // erase every third key to exercise delete fixups
+  size_t m = 0;
+  for (size_t i = 0; i < n; i++) {
+    if (i % 3 == 0) {
+      rbtree_erase(t, rbtree_find(t, arr[i]));
+    } else {
+      arr[m++] = arr[i];
+    }
+  }
+  assert(rbtree_size(t) == m);
+  assert(size_traverse(t->root, t->nil) == m);
+  test_color_constraint(t);
+
+  qsort((void *)arr, m, sizeof(key_t), comp);
+  for (size_t k = 0; k < m; k++) {
+    node_t *p = rbtree_select(t, k);
+    assert(p != NULL);
+    assert(p->key == arr[k]);
+  }
+  assert(rbtree_select(t, m) == NULL);
+
+  size_t lo = 0;
+  for (key_t key = -1; key <= range; key++) {
+    while (lo < m && arr[lo] < key) {
+      lo++;
+    }
+    assert(rbtree_rank(t, key) == lo);
+  }
+
+  free(arr);
+  delete_rbtree(t);
+  rbtree *empty = new_rbtree();
+  assert(rbtree_size(empty) == 0);
+  assert(rbtree_select(empty, 0) == NULL);
+  assert(rbtree_rank(empty, 0) == 0);
+  delete_rbtree(empty);
+}
+#endif
+
+void test_iterator_suite() {
+  const key_t entries[] = {10, 5, 8, 34, 67, 23, 156, 24, 2, 12, 24, 36, 990, 25};
+  const size_t n = sizeof(entries) / sizeof(entries[0]);
+  test_next_prev(entries, n);
+
+  const size_t rn = 1000;
+  key_t *arr = calloc(rn, sizeof(key_t));
+  srand(7);
+  for (size_t i = 0; i < rn; i++) {
+    arr[i] = rand() % 300;
+  }
+  test_next_prev(arr, rn);
+  free(arr);
+
+  test_range_cursor();
+  test_bounds(1000, 20, 3);
+  test_bounds(1000, 1000, 5);
+}
+
+// a tree built from a sorted array should be a valid rbtree that can be
+// modified afterwards
+void test_from_sorted_array(const size_t n) {
+  key_t *arr = calloc(n + 1, sizeof(key_t));
+  for (size_t i = 0; i < n; i++) {
+    arr[i] = (key_t)(i / 2);
+  }
+
+  rbtree *t = rbtree_from_sorted_array(arr, n);
+  assert(t != NULL);
+  test_color_constraint(t);
+  test_search_constraint(t);
+#if RBTREE_ORDER_STATS
+  assert(rbtree_size(t) == n);
+  assert(size_traverse(t->root, t->nil) == n);
+#endif
+
+  key_t *res = calloc(n + 1, sizeof(key_t));
+  assert(rbtree_to_array(t, res, n + 1) == n);
+  for (size_t i = 0; i < n; i++) {
+    assert(res[i] == arr[i]);
+  }
+
+  // the built tree should keep working as a regular tree
+  insert_arr(t, arr, n);
+  test_color_constraint(t);
+  for (size_t i = 0; i < 2 * n; i++) {
+    node_t *p = rbtree_find(t, arr[i / 2]);
+    assert(p != NULL);
+    rbtree_erase(t, p);
+  }
+  assert(t->root == t->nil);
+
+  free(res);
+  free(arr);
+  delete_rbtree(t);
+}
+
+void test_from_sorted_array_suite() {
+  for (size_t n = 0; n <= 70; n++) {
+    test_from_sorted_array(n);
+  }
+  test_from_sorted_array(10000);
+
+  const key_t unsorted[] = {1, 3, 2};
+  assert(rbtree_from_sorted_array(unsorted, 3) == NULL);
+}
+
+// batch insert should produce the same multiset as one-by-one inserts
+// for sorted, unsorted and duplicated batches on top of existing keys
+void test_insert_batch(const size_t base, const size_t n, const key_t range,
+                       const int sorted, const unsigned int seed) {
+  rbtree *t = new_rbtree();
+  key_t *arr = calloc(base + n, sizeof(key_t));
+  srand(seed);
+  for (size_t i = 0; i < base + n; i++) {
+    arr[i] = rand() % range;
+  }
+  insert_arr(t, arr, base);
+  if (sorted) {
+    qsort((void *)(arr + base), n, sizeof(key_t), comp);
+  }
+  assert(rbtree_insert_batch(t, arr + base, n) == 0);
+
+  test_color_constraint(t);
+  test_search_constraint(t);
+#if RBTREE_ORDER_STATS
+  assert(size_traverse(t->root, t->nil) == base + n);
+#endif
+
+  qsort((void *)arr, base + n, sizeof(key_t), comp);
+  key_t *res = calloc(base + n, sizeof(key_t));
+  assert(rbtree_to_array(t, res, base + n) == base + n);
+  for (size_t i = 0; i < base + n; i++) {
+    assert(res[i] == arr[i]);
+  }
+
+  free(res);
+  free(arr);
+  delete_rbtree(t);
+}
+
+void test_insert_batch_suite() {
+  test_insert_batch(0, 0, 10, 1, 1);
+  test_insert_batch(0, 1, 10, 1, 1);
+  test_insert_batch(0, 1000, 100000, 1, 2);
+  test_insert_batch(1000, 1000, 100000, 1, 3);
+  test_insert_batch(1000, 1000, 30, 1, 4);
+  test_insert_batch(1000, 1000, 100000, 0, 5);
+  test_insert_batch(10, 2000, 7, 0, 6);
+}
+
+RBTREE_DEFINE(u64map, uint64_t, size_t, RBTREE_CMP_NUM)
+RBTREE_DEFINE(strmap, const char *, int, strcmp)
+
+// a generated tree should keep 64-bit keys with inline values in order
+void test_generic_u64(const size_t n) {
+  u64map *t = u64map_new();
+  assert(t != NULL);
+  assert(u64map_min(t) == NULL);
+
+  uint64_t *keys = calloc(n, sizeof(uint64_t));
+  uint64_t x = 0x9e3779b97f4a7c15ull;
+  for (size_t i = 0; i < n; i++) {
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    keys[i] = x;
+    assert(u64map_insert(t, keys[i], i) != NULL);
+  }
+  assert(u64map_size(t) == n);
+
+  for (size_t i = 0; i < n; i++) {
+    u64map_node *p = u64map_find(t, keys[i]);
+    assert(p != NULL);
+    assert(p->key == keys[i] && p->value == i);
+  }
+
+  // erase every other key and check the rest is still in order
+  for (size_t i = 0; i < n; i += 2) {
+    u64map_erase(t, u64map_find(t, keys[i]));
+  }
+  assert(u64map_size(t) == n / 2);
+  size_t seen = 0;
+  for (u64map_node *p = u64map_min(t); p != NULL; p = u64map_next(t, p)) {
+    u64map_node *q = u64map_next(t, p);
+    assert(q == NULL || p->key <= q->key);
+    assert(p->value % 2 == 1);
+    assert(u64map_lower_bound(t, p->key) == p);
+    seen++;
+  }
+  assert(seen == n / 2);
+  assert(u64map_prev(t, u64map_min(t)) == NULL);
+
+  free(keys);
+  u64map_delete(t);
+}
+
+// string keys should be ordered by the supplied comparator
+void test_generic_str() {
+  const char *words[] = {"pear", "apple", "fig", "kiwi", "banana", "apple"};
+  const size_t n = sizeof(words) / sizeof(words[0]);
+  strmap *t = strmap_new();
+  for (size_t i = 0; i < n; i++) {
+    strmap_insert(t, words[i], (int)i);
+  }
+  const char *sorted[] = {"apple", "apple", "banana", "fig", "kiwi", "pear"};
+  size_t i = 0;
+  for (strmap_node *p = strmap_min(t); p != NULL; p = strmap_next(t, p)) {
+    assert(strcmp(p->key, sorted[i++]) == 0);
+  }
+  assert(i == n);
+  assert(strmap_find(t, "fig")->value == 2);
+  assert(strmap_find(t, "grape") == NULL);
+  assert(strcmp(strmap_lower_bound(t, "grape")->key, "kiwi") == 0);
+  strmap_delete(t);
+}
+
+// compact tree: parent links, colors and black heights should be valid
+static int compact_traverse(const rbtree_compact *t, node_idx_t i,
+                            node_idx_t parent, int parent_red) {
+  if (i == RBTREE_COMPACT_NIL) {
+    return 0;
+  }
+  const compact_node_t *p = &t->nodes[i];
+  const int red = rbtree_compact_color(t, i) == RBTREE_RED;
+  assert((p->parent_color & 0x7fffffff) == parent);
+  assert(!(red && parent_red));
+  assert(p->left == RBTREE_COMPACT_NIL || t->nodes[p->left].key <= p->key);
+  assert(p->right == RBTREE_COMPACT_NIL || t->nodes[p->right].key >= p->key);
+  int lh = compact_traverse(t, p->left, i, red);
+  int rh = compact_traverse(t, p->right, i, red);
+  assert(lh == rh);
+  return lh + !red;
+}
+
+// the compact layout should behave like the pointer tree
+void test_compact(const size_t n, const key_t range, const unsigned int seed) {
+  assert(sizeof(compact_node_t) <= 16);
+  rbtree_compact *t = new_rbtree_compact();
+  assert(t != NULL);
+  assert(rbtree_compact_min(t) == RBTREE_COMPACT_NIL);
+
+  key_t *arr = calloc(n, sizeof(key_t));
+  srand(seed);
+  for (size_t i = 0; i < n; i++) {
+    arr[i] = rand() % range;
+    node_idx_t p = rbtree_compact_insert(t, arr[i]);
+    assert(p != RBTREE_COMPACT_NIL);
+    assert(rbtree_compact_key(t, p) == arr[i]);
+  }
+  assert(rbtree_compact_color(t, t->root) == RBTREE_BLACK);
+  compact_traverse(t, t->root, RBTREE_COMPACT_NIL, 0);
+
+  // erase half, then insert them again to reuse freed slots
+  for (size_t i = 0; i < n; i += 2) {
+    node_idx_t p = rbtree_compact_find(t, arr[i]);
+    assert(p != RBTREE_COMPACT_NIL);
+    assert(rbtree_compact_key(t, p) == arr[i]);
+    rbtree_compact_erase(t, p);
+  }
+  assert(t->count == n / 2);
+  compact_traverse(t, t->root, RBTREE_COMPACT_NIL, 0);
+  const uint32_t used = t->used;
+  for (size_t i = 0; i < n; i += 2) {
+    rbtree_compact_insert(t, arr[i]);
+  }
+  assert(t->used == used);
+  compact_traverse(t, t->root, RBTREE_COMPACT_NIL, 0);
+
+  qsort((void *)arr, n, sizeof(key_t), comp);
+  key_t *res = calloc(n, sizeof(key_t));
+  assert(rbtree_compact_to_array(t, res, n) == n);
+  size_t i = 0;
+  for (node_idx_t p = rbtree_compact_min(t); p != RBTREE_COMPACT_NIL;
+       p = rbtree_compact_next(t, p)) {
+    assert(res[i] == arr[i]);
+    assert(rbtree_compact_key(t, p) == arr[i++]);
+  }
+  assert(i == n);
+  for (node_idx_t p = rbtree_compact_max(t); p != RBTREE_COMPACT_NIL;
+       p = rbtree_compact_prev(t, p)) {
+    assert(rbtree_compact_key(t, p) == arr[--i]);
+  }
+  node_idx_t lb = rbtree_compact_lower_bound(t, arr[n / 2]);
+  assert(lb != RBTREE_COMPACT_NIL && rbtree_compact_key(t, lb) == arr[n / 2]);
+  assert(rbtree_compact_lower_bound(t, arr[n - 1] + 1) == RBTREE_COMPACT_NIL);
+
+  // erase everything
+  for (size_t k = 0; k < n; k++) {
+    rbtree_compact_erase(t, rbtree_compact_find(t, arr[k]));
+  }
+  assert(t->root == RBTREE_COMPACT_NIL && t->count == 0);
+
+  free(res);
+  free(arr);
+  delete_rbtree_compact(t);
+}
+
+// the keys of a compact tree in order should match the sorted arr
+static void check_compact_keys(const rbtree_compact *t, const key_t *arr,
+                               const size_t n) {
+  assert(t->count == n);
+  assert(rbtree_compact_color(t, t->root) == RBTREE_BLACK);
+  compact_traverse(t, t->root, RBTREE_COMPACT_NIL, 0);
+  size_t i = 0;
+  for (node_idx_t p = rbtree_compact_min(t); p != RBTREE_COMPACT_NIL;
+       p = rbtree_compact_next(t, p)) {
+    assert(rbtree_compact_key(t, p) == arr[i++]);
+  }
+  assert(i == n);
+}
+
+// a saved tree should be searchable straight from the mapped file, accept
+// writes without touching the file, and reject damaged files
+void test_compact_mmap(const size_t n, const key_t range,
+                       const unsigned int seed) {
+  char path[] = "/tmp/test-rbtree-XXXXXX";
+  int fd = mkstemp(path);
+  assert(fd >= 0);
+  close(fd);
+
+  rbtree *t = new_rbtree();
+  rbtree_compact *c = new_rbtree_compact();
+  key_t *arr = calloc(n + 1, sizeof(key_t));
+  srand(seed);
+  for (size_t i = 0; i < n; i++) {
+    arr[i] = rand() % range;
+    rbtree_insert(t, arr[i]);
+    rbtree_compact_insert(c, arr[i]);
+  }
+  // leave some freed slots in the compact array
+  for (size_t i = 0; i < n; i += 3) {
+    rbtree_compact_erase(c, rbtree_compact_find(c, arr[i]));
+    rbtree_compact_insert(c, arr[i]);
+  }
+  qsort((void *)arr, n, sizeof(key_t), comp);
+
+  // a pointer tree is saved as a balanced compact tree
+  assert(rbtree_save(t, path) == 0);
+  rbtree_compact *m = rbtree_compact_open_mmap(path, 1);
+  assert(m != NULL && m->map != NULL);
+  check_compact_keys(m, arr, n);
+  if (n > 0) {
+    assert(rbtree_compact_find(m, arr[n / 2]) != RBTREE_COMPACT_NIL);
+    assert(rbtree_compact_key(m, rbtree_compact_min(m)) == arr[0]);
+    assert(rbtree_compact_key(m, rbtree_compact_max(m)) == arr[n - 1]);
+  }
+  delete_rbtree_compact(m);
+
+  assert(rbtree_compact_save(c, path) == 0);
+  m = rbtree_compact_open_mmap(path, 1);
+  assert(m != NULL);
+  check_compact_keys(m, arr, n);
+
+  // erasing changes only the private mapping, and growing moves the array
+  // to the heap
+  if (n > 0) {
+    rbtree_compact_erase(m, rbtree_compact_find(m, arr[0]));
+    check_compact_keys(m, arr + 1, n - 1);
+  }
+  for (size_t i = 0; i < n + 10; i++) {
+    assert(rbtree_compact_insert(m, range + i) != RBTREE_COMPACT_NIL);
+  }
+  assert(m->map == NULL);
+  assert(m->count == (n > 0 ? n - 1 : 0) + n + 10);
+  compact_traverse(m, m->root, RBTREE_COMPACT_NIL, 0);
+  delete_rbtree_compact(m);
+
+  m = rbtree_compact_open_mmap(path, 1);
+  assert(m != NULL);
+  check_compact_keys(m, arr, n);
+  delete_rbtree_compact(m);
+
+  // files with a valid checksum but a broken tree are rejected by
+  // verification; without it a cycle must not overrun to_array's stack
+  if (n > 1) {
+    const node_idx_t lo = rbtree_compact_min(c), hi = rbtree_compact_max(c);
+    compact_node_t saved_lo = c->nodes[lo], saved_hi = c->nodes[hi];
+    const size_t saved_count = c->count;
+    for (int broken = 0; broken < 5; broken++) {
+      if (broken == 0) {
+        c->nodes[lo].left = c->root;  // cycle back to the root
+      } else if (broken == 1) {
+        c->nodes[lo].parent_color ^= 0x80000000u;  // recolor a leaf
+      } else if (broken == 2) {
+        c->nodes[lo].key = c->nodes[hi].key + 1;  // out of order
+      } else if (broken == 3) {
+        c->nodes[hi].parent_color ^= 1;  // wrong parent link
+      } else {
+        c->count++;
+      }
+      assert(rbtree_compact_save(c, path) == 0);
+      assert(rbtree_compact_open_mmap(path, 1) == NULL);
+      if (broken == 0) {
+        m = rbtree_compact_open_mmap(path, 0);
+        assert(m != NULL);
+        key_t *out = calloc(n, sizeof(key_t));
+        assert(rbtree_compact_to_array(m, out, n) < n);
+        free(out);
+        delete_rbtree_compact(m);
+      }
+      c->nodes[lo] = saved_lo;
+      c->nodes[hi] = saved_hi;
+      c->count = saved_count;
+    }
+    assert(rbtree_compact_save(c, path) == 0);
+    m = rbtree_compact_open_mmap(path, 1);
+    assert(m != NULL);
+    check_compact_keys(m, arr, n);
+    delete_rbtree_compact(m);
+  }
+
+  // a flipped byte in the nodes fails the checksum, one in the header
+  // fails even without verification
+  FILE *f = fopen(path, "r+b");
+  assert(f != NULL);
+  fseek(f, 64 + 16, SEEK_SET);
+  fputc(0x5a ^ fgetc(f), f);
+  fclose(f);
+  if (n > 0) {
+    assert(rbtree_compact_open_mmap(path, 1) == NULL);
+  }
+  f = fopen(path, "r+b");
+  fseek(f, 8, SEEK_SET);
+  fputc(2, f);
+  fclose(f);
+  assert(rbtree_compact_open_mmap(path, 0) == NULL);
+  assert(rbtree_compact_open_mmap("/nonexistent/rbtree", 0) == NULL);
+
+  remove(path);
+  free(arr);
+  delete_rbtree_compact(c);
+  delete_rbtree(t);
+}
+
+// a frozen snapshot should answer find/lower_bound/range like the tree
+void test_frozen(const size_t n, const key_t range, const unsigned int seed) {
+  rbtree *t = new_rbtree();
+  key_t *arr = calloc(n + 1, sizeof(key_t));
+  srand(seed);
+  for (size_t i = 0; i < n; i++) {
+    arr[i] = rand() % range;
+  }
+  insert_arr(t, arr, n);
+
+  rbtree_frozen *f = rbtree_freeze(t);
+  assert(f != NULL);
+  assert(f->n == n);
+
+  // the snapshot is independent of later writes
+  rbtree_insert(t, 2 * range + 100);
+
+  for (key_t key = -1; key <= range; key++) {
+    node_t *lb = rbtree_lower_bound(t, key);
+    size_t pos = rbtree_frozen_lower_bound(f, key);
+    if (lb == NULL || lb->key > range) {
+      assert(pos == 0);
+    } else {
+      assert(pos != 0 && rbtree_frozen_key(f, pos) == lb->key);
+    }
+    size_t found = rbtree_frozen_find(f, key);
+    assert((found != 0) == (rbtree_find(t, key) != NULL));
+    assert(found == 0 || rbtree_frozen_key(f, found) == key);
+  }
+
+  // range scans should match a cursor over the same bounds
+  key_t *out = calloc(n + 1, sizeof(key_t));
+  for (key_t lo = -1; lo <= range; lo += range / 7 + 1) {
+    const key_t hi = lo + range / 3;
+    size_t got = rbtree_frozen_range(f, lo, hi, out, n + 1);
+    rbtree_cursor c;
+    rbtree_range(t, &c, lo, hi);
+    size_t i = 0;
+    for (node_t *p; (p = rbtree_cursor_next(&c)) != NULL; i++) {
+      assert(i < got && out[i] == p->key);
+    }
+    assert(i == got);
+    if (got > 1) {
+      assert(rbtree_frozen_range(f, lo, hi, out, 1) == 1);
+    }
+  }
+
+  // walking the snapshot in order should visit every key sorted
+  qsort((void *)arr, n, sizeof(key_t), comp);
+  size_t i = 0;
+  for (size_t pos = rbtree_frozen_lower_bound(f, -1); pos != 0;
+       pos = rbtree_frozen_next(f, pos)) {
+    assert(rbtree_frozen_key(f, pos) == arr[i++]);
+  }
+  assert(i == n);
+
+  free(out);
+  free(arr);
+  delete_rbtree_frozen(f);
+  delete_rbtree(t);
+}
+
+void test_frozen_suite() {
+  for (size_t n = 0; n < 40; n++) {
+    test_frozen(n, 50, (unsigned int)n);
+  }
+  test_frozen(5000, 1000, 29);
+  test_frozen(5000, 100000, 31);
+}
+
+// batched lookups should return exactly what one-at-a-time lookups return,
+// for every batch length including the ones that leave a partial group
+void test_find_many(const size_t n, const key_t range, const unsigned int seed) {
+  rbtree *t = new_rbtree();
+  srand(seed);
+  for (size_t i = 0; i < n; i++) {
+    rbtree_insert(t, rand() % range);
+  }
+  rbtree_frozen *f = rbtree_freeze(t);
+  assert(f != NULL);
+
+  const size_t m = 3 * range + 37;
+  key_t *keys = calloc(m, sizeof(key_t));
+  node_t **nodes = calloc(m, sizeof(node_t *));
+  size_t *pos = calloc(m, sizeof(size_t));
+  for (size_t i = 0; i < m; i++) {
+    keys[i] = rand() % (range + 2) - 1;
+  }
+
+  for (size_t len = 0; len <= m; len += len < 70 ? 1 : m / 5 + 1) {
+    rbtree_find_many(t, keys, len, nodes);
+    rbtree_frozen_find_many(f, keys, len, pos);
+    for (size_t i = 0; i < len; i++) {
+      assert(nodes[i] == rbtree_find(t, keys[i]));
+      assert(pos[i] == rbtree_frozen_find(f, keys[i]));
+    }
+  }
+
+  free(pos);
+  free(nodes);
+  free(keys);
+  delete_rbtree_frozen(f);
+  delete_rbtree(t);
+}
+
+void test_find_many_suite() {
+  for (size_t n = 0; n < 20; n++) {
+    test_find_many(n, 30, (unsigned int)n);
+  }
+  test_find_many(5000, 1000, 37);
+  test_find_many(5000, 100000, 41);
+}
+
+// concurrent stress: the even keys below 2 * CONCURRENT_KEYS stay in the
+// tree the whole time while writers toggle odd keys around them, so every
+// reader can check its answers without knowing what the writers did
+#define CONCURRENT_KEYS 2000
+#define CONCURRENT_WRITERS 2
+#define CONCURRENT_READERS 4
+#define CONCURRENT_OPS 20000
+
+typedef struct {
+  rbtree_concurrent *c;
+  int id;
+  unsigned int seed;
+  bool present[CONCURRENT_KEYS];
+} concurrent_worker;
+
+// writer w owns the odd keys 2 * i + 1 with i % CONCURRENT_WRITERS == w
+static void *concurrent_writer(void *arg) {
+  concurrent_worker *w = (concurrent_worker *)arg;
+  for (int op = 0; op < CONCURRENT_OPS; op++) {
+    const int i = rand_r(&w->seed) % ((CONCURRENT_KEYS - 1) / CONCURRENT_WRITERS) *
+                      CONCURRENT_WRITERS + w->id;
+    if (w->present[i]) {
+      assert(rbtree_concurrent_erase(w->c, 2 * i + 1) == 0);
+    } else {
+      assert(rbtree_concurrent_insert(w->c, 2 * i + 1) == 0);
+    }
+    w->present[i] = !w->present[i];
+  }
+  return NULL;
+}
+
+static void *concurrent_reader(void *arg) {
+  concurrent_worker *w = (concurrent_worker *)arg;
+  key_t out[64];
+  for (int op = 0; op < CONCURRENT_OPS; op++) {
+    const key_t even = 2 * (rand_r(&w->seed) % CONCURRENT_KEYS);
+    key_t key;
+    assert(rbtree_concurrent_find(w->c, even) == 1);
+    assert(rbtree_concurrent_min(w->c, &key) == 1 && key == 0);
+    assert(rbtree_concurrent_max(w->c, &key) == 1 &&
+           key == 2 * (CONCURRENT_KEYS - 1));
+    if (even < 2 * (CONCURRENT_KEYS - 1)) {
+      assert(rbtree_concurrent_next(w->c, even, &key) == 1);
+      assert(key == even + 1 || key == even + 2);
+    }
+
+    // a range is one consistent snapshot: sorted, in bounds, no even key missing
+    const key_t hi = even + 40;
+    size_t got = rbtree_concurrent_range(w->c, even, hi, out, 64);
+    const key_t end = hi < 2 * CONCURRENT_KEYS ? hi : 2 * CONCURRENT_KEYS;
+    size_t evens = 0;
+    for (size_t i = 0; i < got; i++) {
+      assert(out[i] >= even && out[i] < hi);
+      assert(i == 0 || out[i - 1] < out[i]);
+      evens += out[i] % 2 == 0;
+    }
+    assert(evens == (size_t)(end - even) / 2);
+  }
+  return NULL;
+}
+
+void test_concurrent() {
+  rbtree_concurrent *c = new_rbtree_concurrent();
+  assert(c != NULL);
+  for (key_t i = 0; i < CONCURRENT_KEYS; i++) {
+    assert(rbtree_concurrent_insert(c, 2 * i) == 0);
+  }
+
+  static concurrent_worker workers[CONCURRENT_WRITERS + CONCURRENT_READERS];
+  pthread_t threads[CONCURRENT_WRITERS + CONCURRENT_READERS];
+  for (int i = 0; i < CONCURRENT_WRITERS + CONCURRENT_READERS; i++) {
+    memset(&workers[i], 0, sizeof(workers[i]));
+    workers[i].c = c;
+    workers[i].id = i;
+    workers[i].seed = (unsigned int)i;
+    void *(*fn)(void *) =
+        i < CONCURRENT_WRITERS ? concurrent_writer : concurrent_reader;
+    assert(pthread_create(&threads[i], NULL, fn, &workers[i]) == 0);
+  }
+  for (int i = 0; i < CONCURRENT_WRITERS + CONCURRENT_READERS; i++) {
+    pthread_join(threads[i], NULL);
+  }
+
+  // the tree should hold exactly the evens plus what each writer left behind
+  test_color_constraint(c->tree);
+  test_search_constraint(c->tree);
+  for (int i = 0; i < CONCURRENT_KEYS - 1; i++) {
+    const bool present = workers[i % CONCURRENT_WRITERS].present[i];
+    assert(rbtree_concurrent_find(c, 2 * i + 1) == present);
+  }
+  delete_rbtree_concurrent(c);
+}
+
+// every shard should be a valid tree holding only keys inside its split range
+static void check_shards(const rbtree_sharded *s) {
+  for (size_t i = 0; i < s->k; i++) {
+    const rbtree *t = s->shards[i].tree;
+    test_color_constraint(t);
+    test_search_constraint(t);
+    node_t *lo = rbtree_min(t), *hi = rbtree_max(t);
+    if (lo != NULL && i > 0) {
+      assert(lo->key >= s->splits[i - 1]);
+    }
+    if (hi != NULL && i + 1 < s->k) {
+      assert(hi->key < s->splits[i]);
+    }
+  }
+}
+
+// a sharded tree should behave like one multiset, even when most keys land
+// in one shard and force the split points to move
+void test_sharded(const size_t n, const key_t range, const unsigned int seed) {
+  rbtree_sharded *s = new_rbtree_sharded(8, 0, range);
+  assert(s != NULL);
+  key_t *arr = calloc(n, sizeof(key_t));
+  srand(seed);
+  for (size_t i = 0; i < n; i++) {
+    arr[i] = i % 2 ? rand() % range : rand() % (range / 50 + 1);
+    assert(rbtree_sharded_insert(s, arr[i]) == 0);
+  }
+  check_shards(s);
+
+  // the skewed half should have been spread out again
+  for (size_t i = 0; i < s->k; i++) {
+    assert(s->shards[i].count <= s->shards[i].limit);
+  }
+
+  // erase the first quarter, then compare against the sorted survivors
+  for (size_t i = 0; i < n / 4; i++) {
+    assert(rbtree_sharded_erase(s, arr[i]) == 0);
+  }
+  assert(rbtree_sharded_erase(s, range + 1) == -1);
+  const size_t m = n - n / 4;
+  key_t *rest = arr + n / 4;
+  qsort((void *)rest, m, sizeof(key_t), comp);
+  assert(rbtree_sharded_size(s) == m);
+
+  key_t *res = calloc(m + 1, sizeof(key_t));
+  assert(rbtree_sharded_to_array(s, res, m + 1) == m);
+  assert(memcmp(res, rest, m * sizeof(key_t)) == 0);
+
+  key_t key;
+  assert(rbtree_sharded_min(s, &key) == (m > 0));
+  assert(m == 0 || key == rest[0]);
+  assert(rbtree_sharded_max(s, &key) == (m > 0));
+  assert(m == 0 || key == rest[m - 1]);
+  for (size_t i = 0; i < m; i++) {
+    assert(rbtree_sharded_find(s, rest[i]));
+  }
+
+  // walking with next visits each distinct key once, in order
+  size_t i = 0;
+  for (int more = rbtree_sharded_min(s, &key); more;
+       more = rbtree_sharded_next(s, key, &key)) {
+    assert(i < m && key == rest[i]);
+    while (i < m && rest[i] == key) {
+      i++;
+    }
+  }
+  assert(i == m);
+
+  assert(rbtree_sharded_rebalance(s) == 0);
+  check_shards(s);
+  assert(rbtree_sharded_to_array(s, res, m + 1) == m);
+  assert(memcmp(res, rest, m * sizeof(key_t)) == 0);
+
+  free(res);
+  free(arr);
+  delete_rbtree_sharded(s);
+}
+
+// writer threads own disjoint ascending keys, which keeps pushing every
+// insert into the last shard and rebalancing while the others write
+#define SHARDED_THREADS 4
+#define SHARDED_KEYS 20000
+
+typedef struct {
+  rbtree_sharded *s;
+  int id;
+} sharded_worker;
+
+static void *sharded_writer(void *arg) {
+  sharded_worker *w = (sharded_worker *)arg;
+  for (key_t key = w->id; key < SHARDED_KEYS; key += SHARDED_THREADS) {
+    assert(rbtree_sharded_insert(w->s, key) == 0);
+    if (key % 3 == 0) {
+      assert(rbtree_sharded_erase(w->s, key) == 0);
+    }
+  }
+  return NULL;
+}
+
+void test_sharded_threads() {
+  rbtree_sharded *s = new_rbtree_sharded(4, 0, 100);
+  assert(s != NULL);
+  pthread_t threads[SHARDED_THREADS];
+  sharded_worker workers[SHARDED_THREADS];
+  for (int i = 0; i < SHARDED_THREADS; i++) {
+    workers[i] = (sharded_worker){s, i};
+    assert(pthread_create(&threads[i], NULL, sharded_writer, &workers[i]) == 0);
+  }
+  for (int i = 0; i < SHARDED_THREADS; i++) {
+    pthread_join(threads[i], NULL);
+  }
+
+  check_shards(s);
+  key_t *res = calloc(SHARDED_KEYS, sizeof(key_t));
+  size_t got = rbtree_sharded_to_array(s, res, SHARDED_KEYS);
+  size_t i = 0;
+  for (key_t key = 0; key < SHARDED_KEYS; key++) {
+    if (key % 3 != 0) {
+      assert(i < got && res[i++] == key);
+    }
+  }
+  assert(i == got);
+  free(res);
+  delete_rbtree_sharded(s);
+}
+
+// black height of a persistent subtree, asserting the red-black and search
+// properties along the way
+static int persistent_check(const persistent_node_t *p, const key_t *lo,
+                            const key_t *hi) {
+  if (p == NULL) {
+    return 1;
+  }
+  assert(p->refs >= 1);
+  assert(lo == NULL || *lo <= p->key);
+  assert(hi == NULL || p->key <= *hi);
+  if (p->color == RBTREE_RED) {
+    assert(p->link[0] == NULL || p->link[0]->color == RBTREE_BLACK);
+    assert(p->link[1] == NULL || p->link[1]->color == RBTREE_BLACK);
+  }
+  int left = persistent_check(p->link[0], lo, &p->key);
+  int right = persistent_check(p->link[1], &p->key, hi);
+  assert(left == right);
+  return left + (p->color == RBTREE_BLACK);
+}
+
+static void persistent_check_snapshot(const rbtree_snapshot *s,
+                                      const key_t *expect, const size_t n) {
+  assert(s->count == n);
+  assert(s->root == NULL || s->root->color == RBTREE_BLACK);
+  persistent_check(s->root, NULL, NULL);
+  key_t *res = calloc(n + 1, sizeof(key_t));
+  assert(rbtree_snapshot_to_array(s, res, n + 1) == n);
+  assert(memcmp(res, expect, n * sizeof(key_t)) == 0);
+  free(res);
+}
+
+// each snapshot should keep the contents it was taken with while the tree
+// keeps changing, and releasing them in any order should free everything
+void test_persistent(const size_t n, const key_t range, const unsigned int seed) {
+  enum { SNAPSHOTS = 8 };
+  rbtree_persistent *t = new_rbtree_persistent();
+  assert(t != NULL);
+  rbtree_snapshot snaps[SNAPSHOTS];
+  key_t *expect[SNAPSHOTS];
+  size_t sizes[SNAPSHOTS];
+  key_t *model = calloc(n + 1, sizeof(key_t));
+  size_t m = 0;
+
+  srand(seed);
+  for (int v = 0; v < SNAPSHOTS; v++) {
+    // half inserts, then erase some present and some absent keys
+    for (size_t i = 0; i < n / SNAPSHOTS; i++) {
+      key_t key = rand() % range;
+      assert(rbtree_persistent_insert(t, key) == 0);
+      model[m++] = key;
+    }
+    for (size_t i = 0; i < n / (2 * SNAPSHOTS) && m > 0; i++) {
+      size_t j = rand() % m;
+      assert(rbtree_persistent_erase(t, model[j]) == 0);
+      model[j] = model[--m];
+    }
+    assert(rbtree_persistent_erase(t, range + 1) == -1);
+
+    qsort((void *)model, m, sizeof(key_t), comp);
+    expect[v] = calloc(m + 1, sizeof(key_t));
+    memcpy(expect[v], model, m * sizeof(key_t));
+    sizes[v] = m;
+    rbtree_persistent_snapshot(t, &snaps[v]);
+    persistent_check_snapshot(&snaps[v], model, m);
+  }
+
+  // older versions are untouched by everything written after them
+  for (int v = 0; v < SNAPSHOTS; v++) {
+    persistent_check_snapshot(&snaps[v], expect[v], sizes[v]);
+    if (sizes[v] > 0) {
+      const key_t *e = expect[v];
+      assert(rbtree_snapshot_min(&snaps[v])->key == e[0]);
+      assert(rbtree_snapshot_max(&snaps[v])->key == e[sizes[v] - 1]);
+      const persistent_node_t *p = rbtree_snapshot_find(&snaps[v], e[sizes[v] / 2]);
+      assert(p != NULL && p->key == e[sizes[v] / 2]);
+      p = rbtree_snapshot_lower_bound(&snaps[v], e[0]);
+      assert(p != NULL && p->key == e[0]);
+      key_t out[4];
+      size_t got = rbtree_snapshot_range(&snaps[v], e[0], e[sizes[v] - 1], out, 4);
+      assert(got <= 4 && (got == 0 || out[0] == e[0]));
+    }
+    assert(rbtree_snapshot_lower_bound(&snaps[v], range) == NULL);
+  }
+
+  // erase everything that is left, checking the live version as it shrinks
+  for (size_t i = 0; m > 0; i++) {
+    size_t j = rand() % m;
+    assert(rbtree_persistent_erase(t, model[j]) == 0);
+    model[j] = model[--m];
+    if (i % 97 == 0 || m == 0) {
+      rbtree_snapshot s;
+      rbtree_persistent_snapshot(t, &s);
+      qsort((void *)model, m, sizeof(key_t), comp);
+      persistent_check_snapshot(&s, model, m);
+      rbtree_snapshot_release(&s);
+    }
+  }
+
+  // drop the tree first; the snapshots still own their nodes
+  delete_rbtree_persistent(t);
+  for (int v = 0; v < SNAPSHOTS; v += 2) {
+    rbtree_snapshot_release(&snaps[v]);
+  }
+  for (int v = 1; v < SNAPSHOTS; v += 2) {
+    persistent_check_snapshot(&snaps[v], expect[v], sizes[v]);
+    rbtree_snapshot_release(&snaps[v]);
+  }
+  for (int v = 0; v < SNAPSHOTS; v++) {
+    free(expect[v]);
+  }
+  free(model);
+}
+
+// a writer appends ascending keys while readers take snapshots, so every
+// snapshot must be exactly 0, 1, ..., count - 1
+#define PERSISTENT_READERS 3
+#define PERSISTENT_KEYS 20000
+
+static void *persistent_reader(void *arg) {
+  rbtree_persistent *t = (rbtree_persistent *)arg;
+  key_t *res = calloc(PERSISTENT_KEYS, sizeof(key_t));
+  size_t last = 0;
+  while (last < PERSISTENT_KEYS) {
+    rbtree_snapshot s;
+    rbtree_persistent_snapshot(t, &s);
+    assert(s.count >= last);
+    assert(rbtree_snapshot_to_array(&s, res, PERSISTENT_KEYS) == s.count);
+    for (size_t i = 0; i < s.count; i++) {
+      assert(res[i] == (key_t)i);
+    }
+    last = s.count;
+    rbtree_snapshot_release(&s);
+  }
+  free(res);
+  return NULL;
+}
+
+void test_persistent_threads() {
+  rbtree_persistent *t = new_rbtree_persistent();
+  assert(t != NULL);
+  pthread_t threads[PERSISTENT_READERS];
+  for (int i = 0; i < PERSISTENT_READERS; i++) {
+    assert(pthread_create(&threads[i], NULL, persistent_reader, t) == 0);
+  }
+  for (key_t key = 0; key < PERSISTENT_KEYS; key++) {
+    assert(rbtree_persistent_insert(t, key) == 0);
+  }
+  for (int i = 0; i < PERSISTENT_READERS; i++) {
+    pthread_join(threads[i], NULL);
+  }
+  delete_rbtree_persistent(t);
+}
+
+// t should be a valid rbtree holding exactly the sorted keys in arr
+// the cached leftmost/rightmost nodes should be the ends of the spines
+static void check_extremes(const rbtree *t) {
+  node_t *min = NULL, *max = NULL;
+  for (node_t *p = t->root; p != t->nil; p = p->left) {
+    min = p;
+  }
+  for (node_t *p = t->root; p != t->nil; p = p->right) {
+    max = p;
+  }
+  assert(rbtree_min(t) == min);
+  assert(rbtree_max(t) == max);
+}
+
+static void check_tree_keys(const rbtree *t, const key_t *arr, const size_t n) {
+  test_color_constraint(t);
+  check_extremes(t);
+  test_search_constraint(t);
+#if RBTREE_ORDER_STATS
+  assert(size_traverse(t->root, t->nil) == n);
+#endif
+  key_t *res = calloc(n + 1, sizeof(key_t));
+  assert(rbtree_to_array(t, res, n + 1) == n);
+  for (size_t i = 0; i < n; i++) {
+    assert(res[i] == arr[i]);
+  }
+  free(res);
+}
+
+// splitting at a key and joining back with that key should keep both
+// halves valid, and join should also work across separate pools
+void test_join_split(const size_t n, const key_t range,
+                     const unsigned int seed) {
+  rbtree *t = new_rbtree();
+  key_t *arr = calloc(n + 301, sizeof(key_t));
+  srand(seed);
+  for (size_t i = 0; i < n; i++) {
+    arr[i] = rand() % range;
+  }
+  insert_arr(t, arr, n);
+  qsort((void *)arr, n, sizeof(key_t), comp);
+
+  for (int round = 0; round < 20; round++) {
+    const key_t key = rand() % (range + 2) - 1;
+    size_t cut = 0;
+    while (cut < n && arr[cut] < key) {
+      cut++;
+    }
+
+    rbtree *lo, *hi;
+    assert(rbtree_split(t, key, &lo, &hi) == 0);
+    assert(lo == t);
+    check_tree_keys(lo, arr, cut);
+    check_tree_keys(hi, arr + cut, n - cut);
+
+    // the middle key must not be smaller than the left tree or larger than
+    // the right tree
+    if (cut > 0) {
+      assert(rbtree_join(lo, arr[cut - 1] - 1, hi) == -1);
+    }
+    if (cut < n) {
+      assert(rbtree_join(lo, arr[cut] + 1, hi) == -1);
+    }
+    assert(rbtree_join(lo, key, hi) == 0);
+    node_t *p = rbtree_find(t, key);
+    assert(p != NULL);
+    rbtree_erase(t, p);
+    check_tree_keys(t, arr, n);
+  }
+
+  // a tree with its own pool is moved into the other tree's pool
+  rbtree *other = new_rbtree();
+  arr[n] = range - 1;
+  for (key_t k = 0; k < 300; k++) {
+    arr[n + 1 + k] = range + k;
+    rbtree_insert(other, range + k);
+  }
+  assert(rbtree_join(t, range - 1, other) == 0);
+  check_tree_keys(t, arr, n + 301);
+
+  free(arr);
+  delete_rbtree(t);
+}
+
+static bool sorted_contains(const key_t *arr, const size_t n, const key_t key) {
+  return bsearch(&key, arr, n, sizeof(key_t), comp) != NULL;
+}
+
+// union should keep every key of both trees, and intersection/difference
+// should keep the keys of the first tree that are / are not in the second
+void test_set_ops(const size_t n1, const size_t n2, const key_t range,
+                  const int shared, const unsigned int seed) {
+  node_pool_t *pool = shared ? new_node_pool(0) : NULL;
+  key_t *a = calloc(n1 + 1, sizeof(key_t));
+  key_t *b = calloc(n2 + 1, sizeof(key_t));
+  key_t *expected = calloc(n1 + n2 + 1, sizeof(key_t));
+  srand(seed);
+  for (size_t i = 0; i < n1; i++) {
+    a[i] = rand() % range;
+  }
+  for (size_t i = 0; i < n2; i++) {
+    b[i] = rand() % range;
+  }
+
+  for (int op = 0; op < 3; op++) {
+    rbtree *t1 = new_rbtree_with_allocator(pool);
+    rbtree *t2 = new_rbtree_with_allocator(pool);
+    insert_arr(t1, a, n1);
+    insert_arr(t2, b, n2);
+    qsort((void *)a, n1, sizeof(key_t), comp);
+    qsort((void *)b, n2, sizeof(key_t), comp);
+
+    size_t m = 0;
+    if (op == 0) {
+      memcpy(expected, a, n1 * sizeof(key_t));
+      memcpy(expected + n1, b, n2 * sizeof(key_t));
+      m = n1 + n2;
+      qsort((void *)expected, m, sizeof(key_t), comp);
+      assert(rbtree_union(t1, t2) == 0);
+    } else {
+      for (size_t i = 0; i < n1; i++) {
+        if (sorted_contains(b, n2, a[i]) == (op == 1)) {
+          expected[m++] = a[i];
+        }
+      }
+      if (op == 1) {
+        rbtree_intersection(t1, t2);
+      } else {
+        rbtree_difference(t1, t2);
+      }
+      check_tree_keys(t2, b, n2);
+      delete_rbtree(t2);
+    }
+    check_tree_keys(t1, expected, m);
+
+    // the freed nodes should be reusable
+    insert_arr(t1, a, n1);
+    test_color_constraint(t1);
+    delete_rbtree(t1);
+  }
+
+  delete_node_pool(pool);
+  free(expected);
+  free(b);
+  free(a);
+}
+
+// trees that share a pool keep their node addresses through join and union,
+// while the smaller of two trees with separate pools is copied into the other
+// pool, so pointers into it no longer name nodes of the result
+void test_join_node_pointers() {
+  node_pool_t *pool = new_node_pool(0);
+  for (int shared = 0; shared < 2; shared++) {
+    for (int op = 0; op < 2; op++) {
+      rbtree *big = new_rbtree_with_allocator(shared ? pool : NULL);
+      rbtree *small = new_rbtree_with_allocator(shared ? pool : NULL);
+      for (key_t k = 0; k < 1000; k++) {
+        rbtree_insert(big, k);
+      }
+      for (key_t k = 0; k < 10; k++) {
+        rbtree_insert(small, 2000 + k);
+      }
+      node_t *held_big = rbtree_find(big, 500);
+      node_t *held_small = rbtree_find(small, 2005);
+
+      if (op == 0) {
+        assert(rbtree_join(big, 1500, small) == 0);
+      } else {
+        assert(rbtree_union(big, small) == 0);
+      }
+      assert(rbtree_find(big, 500) == held_big);
+      if (shared) {
+        assert(rbtree_find(big, 2005) == held_small);
+      } else {
+        assert(rbtree_find(big, 2005) != held_small);
+      }
+      delete_rbtree(big);
+    }
+  }
+  delete_node_pool(pool);
+}
+
+void test_set_ops_suite() {
+  test_join_split(0, 10, 73);
+  test_join_split(1, 10, 79);
+  test_join_split(3000, 100000, 83);
+  test_join_split(3000, 40, 89);
+  test_set_ops(0, 0, 10, 1, 97);
+  test_set_ops(0, 100, 1000, 0, 101);
+  test_set_ops(100, 0, 1000, 1, 103);
+  test_set_ops(5000, 5000, 10000, 1, 107);
+  test_set_ops(20000, 300, 100000, 0, 109);
+  test_set_ops(300, 20000, 100000, 1, 113);
+  test_set_ops(5000, 5000, 50, 0, 127);
+  // large enough that the top subproblems reach SET_OP_FORK_BH, so a build
+  // with -DRBTREE_SET_OP_THREADS > 1 runs the fork-join path
+  test_set_ops(1 << 17, 1 << 16, 1 << 30, 1, 131);
+  test_set_ops(1 << 17, 1 << 16, 1 << 30, 0, 137);
+  test_join_node_pointers();
+}
+
+// the state rebuilt from the snapshot and logs should match arr
+static void check_wal_keys(rbtree_wal *w, key_t *arr, const size_t n) {
+  qsort((void *)arr, n, sizeof(key_t), comp);
+  key_t *res = calloc(n + 1, sizeof(key_t));
+  assert(rbtree_wal_to_array(w, res, n + 1) == n);
+  for (size_t i = 0; i < n; i++) {
+    assert(res[i] == arr[i]);
+  }
+  test_color_constraint(w->tree);
+  test_search_constraint(w->tree);
+  free(res);
+}
+
+typedef struct {
+  rbtree_wal *w;
+  key_t base;
+  size_t n;
+} wal_writer_arg;
+
+static void *wal_writer(void *arg) {
+  wal_writer_arg *a = (wal_writer_arg *)arg;
+  for (size_t i = 0; i < a->n; i++) {
+    assert(rbtree_wal_insert(a->w, a->base + (key_t)i) == 0);
+  }
+  return NULL;
+}
+
+// every acknowledged insert/erase should survive a reopen, a crash, a torn
+// log tail and a compaction that stopped before its snapshot was written
+void test_wal() {
+  char dir[] = "/tmp/test-rbtree-wal-XXXXXX";
+  assert(mkdtemp(dir) != NULL);
+  char path[64], file[80];
+  snprintf(path, sizeof(path), "%s/tree", dir);
+
+  const size_t n = 3000;
+  key_t *arr = calloc(4 * n, sizeof(key_t));
+  size_t m = 0;
+  rbtree_wal *w = rbtree_wal_open(path, 0);
+  assert(w != NULL);
+  srand(149);
+  for (size_t i = 0; i < n; i++) {
+    arr[m] = rand() % 500;
+    assert(rbtree_wal_insert(w, arr[m++]) == 0);
+  }
+  for (size_t i = 0; i < n; i += 3) {
+    key_t key = rand() % 500;
+    if (rbtree_wal_find(w, key)) {
+      assert(rbtree_wal_erase(w, key) == 0);
+      qsort((void *)arr, m, sizeof(key_t), comp);
+      key_t *p = bsearch(&key, arr, m, sizeof(key_t), comp);
+      *p = arr[--m];
+    } else {
+      assert(rbtree_wal_erase(w, key) == -1);
+    }
+  }
+  rbtree_wal_close(w);
+
+  // replay from the log alone
+  w = rbtree_wal_open(path, 0);
+  assert(w != NULL);
+  check_wal_keys(w, arr, m);
+
+  // compact, then keep logging on top of the snapshot
+  assert(rbtree_wal_compact(w) == 0);
+  assert(w->snap_gen == 1 && w->log_gen == 1);
+  for (size_t i = 0; i < n; i++) {
+    arr[m] = 1000 + (key_t)i;
+    assert(rbtree_wal_insert(w, arr[m++]) == 0);
+  }
+  rbtree_wal_close(w);
+  w = rbtree_wal_open(path, 0);
+  assert(w != NULL);
+  check_wal_keys(w, arr, m);
+  rbtree_wal_close(w);
+
+  // without the newer snapshot both generations of the log are replayed,
+  // as after a crash in the middle of a compaction
+  snprintf(file, sizeof(file), "%s.snap", path);
+  assert(remove(file) == 0);
+  w = rbtree_wal_open(path, 0);
+  assert(w != NULL);
+  check_wal_keys(w, arr, m);
+  assert(w->snap_gen == 1 && w->log_gen == 1);
+
+  // concurrent writers share group commits
+  pthread_t tid[4];
+  wal_writer_arg args[4];
+  for (int i = 0; i < 4; i++) {
+    args[i] = (wal_writer_arg){w, 10000 + 1000 * i, 200};
+    pthread_create(&tid[i], NULL, wal_writer, &args[i]);
+  }
+  for (int i = 0; i < 4; i++) {
+    pthread_join(tid[i], NULL);
+    for (size_t k = 0; k < 200; k++) {
+      arr[m++] = args[i].base + (key_t)k;
+    }
+  }
+  rbtree_wal_close(w);
+
+  // a writer that dies without closing loses nothing it was told was
+  // durable
+  pid_t pid = fork();
+  assert(pid >= 0);
+  if (pid == 0) {
+    rbtree_wal *c = rbtree_wal_open(path, 1000);
+    for (key_t k = 0; k < 100; k++) {
+      if (rbtree_wal_insert(c, 20000 + k) != 0) {
+        _exit(1);
+      }
+    }
+    _exit(0);
+  }
+  int status;
+  waitpid(pid, &status, 0);
+  assert(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+  for (key_t k = 0; k < 100; k++) {
+    arr[m++] = 20000 + k;
+  }
+
+  // a half-written record at the end of the log is dropped
+  snprintf(file, sizeof(file), "%s.log1", path);
+  FILE *f = fopen(file, "ab");
+  assert(f != NULL);
+  fwrite("torn", 1, 4, f);
+  fclose(f);
+  w = rbtree_wal_open(path, 0);
+  assert(w != NULL);
+  check_wal_keys(w, arr, m);
+  assert(rbtree_wal_insert(w, 30000) == 0);
+  arr[m++] = 30000;
+  rbtree_wal_close(w);
+  w = rbtree_wal_open(path, 0);
+  assert(w != NULL);
+  check_wal_keys(w, arr, m);
+  rbtree_wal_close(w);
+
+  // a failed log write leaves the tree and count as they were, which is
+  // also what a replay of the log gives
+  for (int op = 0; op < 2; op++) {
+    w = rbtree_wal_open(path, 0);
+    assert(w != NULL);
+    const size_t count = w->count;
+    int null_fd = open("/dev/null", O_RDONLY);
+    assert(null_fd >= 0 && dup2(null_fd, w->fd) == w->fd);
+    close(null_fd);
+    if (op == 0) {
+      assert(rbtree_wal_insert(w, 40000) == -1);
+    } else {
+      assert(rbtree_wal_erase(w, arr[0]) == -1);
+    }
+    assert(w->failed && w->count == count);
+    check_wal_keys(w, arr, m);
+    assert(rbtree_wal_insert(w, 40001) == -1);
+    rbtree_wal_close(w);
+    w = rbtree_wal_open(path, 0);
+    assert(w != NULL && w->count == count);
+    check_wal_keys(w, arr, m);
+    rbtree_wal_close(w);
+  }
+
+  // a damaged snapshot is refused instead of silently losing keys
+  snprintf(file, sizeof(file), "%s.snap", path);
+  f = fopen(file, "r+b");
+  assert(f != NULL);
+  fseek(f, 60, SEEK_SET);
+  fputc(0x7f ^ fgetc(f), f);
+  fclose(f);
+  assert(rbtree_wal_open(path, 0) == NULL);
+
+  const char *suffixes[] = {".snap", ".log0", ".log1"};
+  for (int i = 0; i < 3; i++) {
+    snprintf(file, sizeof(file), "%s%s", path, suffixes[i]);
+    remove(file);
+  }
+  assert(rmdir(dir) == 0);
+  free(arr);
+}
+
+#if RBTREE_STATS
+// the fixup, rotation and depth counters should agree with each other and
+// with the shape of the tree
+void test_stats(const size_t n) {
+  rbtree *t = new_rbtree();
+  rbtree_stats_t st;
+  rbtree_stats(t, &st);
+  assert(st.inserts == 0 && st.finds == 0 && st.black_height == 0);
+
+  // ascending keys always go right, so only the mirrored cases occur and
+  // every fixup rotation is a left rotation
+  for (size_t i = 0; i < n; i++) {
+    rbtree_insert(t, (key_t)i);
+  }
+  rbtree_stats(t, &st);
+  assert(st.inserts == n);
+  for (int c = 0; c < 3; c++) {
+    assert(st.insert_fixup[0][c] == 0);
+  }
+  assert(st.insert_fixup[1][1] == 0);
+  assert(st.insert_fixup[1][2] > 0);
+  assert(st.right_rotations == 0);
+  assert(st.left_rotations == st.insert_fixup[1][2]);
+  assert(st.black_height > 0);
+
+  size_t depth_total = 0;
+  for (int d = 0; d < RBTREE_STATS_DEPTHS; d++) {
+    depth_total += st.insert_depth[d];
+  }
+  assert(depth_total == n);
+  assert(st.insert_depth[0] == 1);  // only the first insert sees an empty tree
+
+  // a find visits at least black_height and at most 2 * black_height nodes
+  for (size_t i = 0; i < n; i++) {
+    assert(rbtree_find(t, (key_t)i) != NULL);
+  }
+  assert(rbtree_find(t, -1) == NULL);
+  rbtree_stats(t, &st);
+  assert(st.finds == n + 1);
+  depth_total = 0;
+  for (int d = 0; d < RBTREE_STATS_DEPTHS; d++) {
+    depth_total += st.find_depth[d];
+    if (st.find_depth[d] > 0) {
+      assert(d >= 1 && d <= 2 * st.black_height);
+    }
+  }
+  assert(depth_total == n + 1);
+
+  // erasing everything goes through the delete fixup; each of its rotations
+  // is counted once by the rotation counters
+  rbtree_stats_reset(t);
+  srand(151);
+  key_t *arr = calloc(n, sizeof(key_t));
+  for (size_t i = 0; i < n; i++) {
+    arr[i] = (key_t)i;
+  }
+  for (size_t i = n; i > 1; i--) {
+    size_t j = rand() % i;
+    key_t tmp = arr[i - 1];
+    arr[i - 1] = arr[j];
+    arr[j] = tmp;
+  }
+  for (size_t i = 0; i < n; i++) {
+    rbtree_erase(t, rbtree_find(t, arr[i]));
+  }
+  rbtree_stats(t, &st);
+  assert(st.inserts == 0 && st.finds == n && st.black_height == 0);
+  size_t rotations = 0, cases = 0;
+  for (int side = 0; side < 2; side++) {
+    rotations += st.delete_fixup[side][0] + st.delete_fixup[side][2] +
+                 st.delete_fixup[side][3];
+    cases += st.delete_fixup[side][1];
+  }
+  assert(rotations > 0 && cases > 0);
+  assert(st.left_rotations + st.right_rotations == rotations);
+
+  // union rotates inside a working copy of the first tree; those rotations
+  // and fixups must still land in the first tree's counters
+  node_pool_t *pool = new_node_pool(0);
+  rbtree *a = new_rbtree_with_allocator(pool);
+  rbtree *b = new_rbtree_with_allocator(pool);
+  for (size_t i = 0; i < n; i++) {
+    rbtree_insert(a, (key_t)(2 * i));
+    rbtree_insert(b, (key_t)(2 * i + 1));
+  }
+  rbtree_stats_reset(a);
+  assert(rbtree_union(a, b) == 0);
+  rbtree_stats(a, &st);
+  assert(st.inserts == 0);
+  assert(st.left_rotations + st.right_rotations > 0);
+  size_t fixups = 0;
+  for (int side = 0; side < 2; side++) {
+    for (int c = 0; c < 3; c++) {
+      fixups += st.insert_fixup[side][c];
+    }
+  }
+  assert(fixups > 0);
+  delete_rbtree(a);
+  delete_node_pool(pool);
+
+  free(arr);
+  delete_rbtree(t);
+}
+#endif
+
+// records embedding their node should be linked in place: the tree never
+// allocates or frees them, and container_of leads back to the record
+typedef struct {
+  int id;
+  node_t node;
+  double payload;
+} intrusive_record;
+
+void test_intrusive(const size_t n) {
+  intrusive_record *recs = calloc(n, sizeof(intrusive_record));
+  rbtree *t = new_rbtree_intrusive();
+  assert(t != NULL);
+  srand(157);
+  for (size_t i = 0; i < n; i++) {
+    recs[i].id = (int)i;
+    recs[i].payload = i * 0.5;
+    recs[i].node.key = rand() % (n / 2 + 1);
+    assert(rbtree_insert_node(t, &recs[i].node) == 0);
+  }
+  test_color_constraint(t);
+  test_search_constraint(t);
+#if RBTREE_ORDER_STATS
+  assert(rbtree_size(t) == n);
+#endif
+
+  // the tree has no nodes of its own to hand out
+  assert(rbtree_insert(t, 1) == NULL);
+  key_t one = 1;
+  assert(rbtree_insert_batch(t, &one, 1) != 0);
+
+  for (size_t i = 0; i < n; i++) {
+    node_t *p = rbtree_find(t, recs[i].node.key);
+    assert(p != NULL);
+    intrusive_record *r = rbtree_container_of(p, intrusive_record, node);
+    assert(r >= recs && r < recs + n);
+    assert(r->node.key == recs[i].node.key);
+    assert(r->payload == r->id * 0.5);
+  }
+
+  // erasing unlinks the record's own node, even when it has two children
+  for (size_t i = 0; i < n; i += 2) {
+    rbtree_erase(t, &recs[i].node);
+  }
+  test_color_constraint(t);
+  test_search_constraint(t);
+  key_t *res = calloc(n, sizeof(key_t));
+  size_t m = rbtree_to_array(t, res, n);
+  assert(m == n / 2);
+  key_t *expected = calloc(n, sizeof(key_t));
+  for (size_t i = 1; i < n; i += 2) {
+    expected[i / 2] = recs[i].node.key;
+  }
+  qsort(expected, m, sizeof(key_t), comp);
+  assert(memcmp(res, expected, m * sizeof(key_t)) == 0);
+
+  // erased records can be reinserted
+  for (size_t i = 0; i < n; i += 2) {
+    assert(rbtree_insert_node(t, &recs[i].node) == 0);
+  }
+
+  // a pool-backed tree does not take caller nodes
+  rbtree *other = new_rbtree();
+  node_t stray = {.key = 1};
+  assert(rbtree_insert_node(other, &stray) == -1);
+  assert(other->root == other->nil);
+
+  // operations that would move caller nodes into a pool are refused and
+  // leave both trees as they were
+  for (key_t k = 0; k < 5000; k++) {
+    rbtree_insert(other, (key_t)n + k);
+  }
+  rbtree *small = new_rbtree_intrusive();
+  intrusive_record four[4];
+  for (int i = 0; i < 4; i++) {
+    four[i].node.key = i;
+    assert(rbtree_insert_node(small, &four[i].node) == 0);
+  }
+  assert(rbtree_join(small, (key_t)n - 1, other) == -1);
+  assert(rbtree_join(other, (key_t)n + 5000, small) == -1);
+  assert(rbtree_union(small, other) == -1);
+  assert(rbtree_union(other, small) == -1);
+  assert(rbtree_intersection(small, other) == -1);
+  assert(rbtree_difference(small, other) == -1);
+  assert(rbtree_intersection(other, small) == -1);
+  assert(rbtree_difference(other, small) == -1);
+  rbtree *lo, *hi;
+  assert(rbtree_split(small, 2, &lo, &hi) == -1);
+  assert(rbtree_split(t, (key_t)(n / 4), &lo, &hi) == -1);
+  for (int i = 0; i < 4; i++) {
+    assert(rbtree_find(small, i) == &four[i].node);
+  }
+  test_color_constraint(small);
+#if RBTREE_ORDER_STATS
+  assert(rbtree_size(other) == 5000 && rbtree_size(t) == n);
+#endif
+  delete_rbtree(small);
+  delete_rbtree(other);
+  for (size_t i = 0; i < n; i++) {
+    node_t *p = rbtree_find(t, recs[i].node.key);
+    assert(rbtree_container_of(p, intrusive_record, node) >= recs);
+  }
+  delete_rbtree(t);
+
+  // the records outlive the trees
+  for (size_t i = 0; i < n; i++) {
+    assert(recs[i].id == (int)i && recs[i].payload == i * 0.5);
+  }
+  free(expected);
+  free(res);
+  free(recs);
+}
+
+// popping from both ends should drain the keys in order while inserts keep
+// moving the cached extremes
+void test_pop_minmax(const size_t n, const key_t range,
+                     const unsigned int seed) {
+  rbtree *t = new_rbtree();
+  key_t *arr = calloc(2 * n + 1, sizeof(key_t));
+  key_t key;
+  assert(rbtree_pop_min(t, &key) == 0);
+  assert(rbtree_pop_max(t, &key) == 0);
+
+  srand(seed);
+  size_t m = 0;
+  for (size_t i = 0; i < n; i++) {
+    arr[m] = rand() % range;
+    rbtree_insert(t, arr[m++]);
+  }
+  qsort((void *)arr, m, sizeof(key_t), comp);
+  check_tree_keys(t, arr, m);
+
+  // scheduler-like use: take the earliest and push a later one
+  size_t lo = 0;
+  for (size_t i = 0; i < n; i++) {
+    assert(rbtree_pop_min(t, &key) == 1);
+    assert(key == arr[lo++]);
+    arr[m] = arr[m - 1] + rand() % 3;
+    rbtree_insert(t, arr[m++]);
+    check_extremes(t);
+  }
+  check_tree_keys(t, arr + lo, m - lo);
+
+  // alternate ends until empty
+  size_t hi = m;
+  while (lo < hi) {
+    if ((lo + hi) % 2) {
+      assert(rbtree_pop_max(t, &key) == 1);
+      assert(key == arr[--hi]);
+    } else {
+      assert(rbtree_pop_min(t, &key) == 1);
+      assert(key == arr[lo++]);
+    }
+    if (hi - lo < 50 || (hi - lo) % 97 == 0) {
+      check_tree_keys(t, arr + lo, hi - lo);
+    }
+  }
+  assert(t->root == t->nil && rbtree_min(t) == NULL && rbtree_max(t) == NULL);
+  assert(rbtree_pop_min(t, &key) == 0);
+
+  // bulk builds reset the cache as well
+  rbtree *u = rbtree_from_sorted_array(arr, m);
+  check_extremes(u);
+  assert(rbtree_min(u)->key == arr[0] && rbtree_max(u)->key == arr[m - 1]);
+  rbtree_insert_batch(t, arr, m);
+  check_extremes(t);
+  delete_rbtree(u);
+  free(arr);
+  delete_rbtree(t);
+}
+
+// hinted inserts should give the same tree contents as plain inserts
+// whether the hint is the right neighbour, the left one or unrelated
+void test_insert_hint(const size_t n, const key_t range,
+                      const unsigned int seed) {
+  rbtree *t = new_rbtree();
+  key_t *arr = calloc(4 * n + 1, sizeof(key_t));
+  size_t m = 0;
+
+  // ascending keys with the last node as the hint, duplicates included
+  node_t *last = NULL;
+  for (size_t i = 0; i < n; i++) {
+    arr[m] = (key_t)(i / 3);
+    last = rbtree_insert_hint(t, last, arr[m++]);
+    assert(last != NULL && last->key == (key_t)(i / 3));
+    assert(rbtree_max(t) == last);
+  }
+  check_tree_keys(t, arr, m);
+
+  // descending keys hinted with the current minimum
+  for (size_t i = 0; i < n; i++) {
+    arr[m] = -1 - (key_t)i;
+    node_t *p = rbtree_insert_hint(t, rbtree_min(t), arr[m++]);
+    assert(rbtree_min(t) == p);
+  }
+  qsort((void *)arr, m, sizeof(key_t), comp);
+  check_tree_keys(t, arr, m);
+
+  // random keys with a neighbour as the hint, or with an arbitrary node
+  srand(seed);
+  for (size_t i = 0; i < 2 * n; i++) {
+    key_t key = rand() % range - range / 2;
+    node_t *hint;
+    switch (i % 4) {
+      case 0:
+        hint = rbtree_lower_bound(t, key);
+        break;
+      case 1:
+        hint = rbtree_upper_bound(t, key);
+        hint = hint != NULL ? rbtree_prev(t, hint) : rbtree_max(t);
+        break;
+      case 2:
+        hint = rbtree_find(t, arr[rand() % m]);
+        break;
+      default:
+        hint = NULL;
+    }
+    arr[m++] = key;
+    node_t *p = rbtree_insert_hint(t, hint, key);
+    assert(p != NULL && p->key == key);
+    if (i % 257 == 0) {
+      qsort((void *)arr, m, sizeof(key_t), comp);
+      check_tree_keys(t, arr, m);
+    }
+  }
+  qsort((void *)arr, m, sizeof(key_t), comp);
+  check_tree_keys(t, arr, m);
+  free(arr);
+  delete_rbtree(t);
+}
+
+// erasing a key range or a prefix should remove exactly those keys and
+// leave a valid tree with the remaining ones
+void test_erase_range(const size_t n, const key_t range,
+                      const unsigned int seed) {
+  rbtree *t = new_rbtree();
+  key_t *arr = calloc(n + 101, sizeof(key_t));
+  key_t *rest = calloc(n + 1, sizeof(key_t));
+  srand(seed);
+  for (size_t i = 0; i < n; i++) {
+    arr[i] = rand() % range;
+  }
+  insert_arr(t, arr, n);
+  qsort((void *)arr, n, sizeof(key_t), comp);
+  size_t m = n;
+
+  // empty and non-overlapping ranges remove nothing
+  assert(rbtree_erase_range(t, 5, 5) == 0);
+  assert(rbtree_erase_range(t, 7, 3) == 0);
+  assert(rbtree_erase_range(t, range, range + 10) == 0);
+  assert(rbtree_erase_range(t, -10, 0) == 0);
+  assert(rbtree_truncate_below(t, 0) == 0);
+  check_tree_keys(t, arr, m);
+
+  for (int round = 0; round < 40 && m > 0; round++) {
+    key_t lo = rand() % range, hi = lo + rand() % (range / 8 + 1);
+    size_t k = 0;
+    for (size_t i = 0; i < m; i++) {
+      if (arr[i] < lo || !(arr[i] < hi)) {
+        rest[k++] = arr[i];
+      }
+    }
+    assert(rbtree_erase_range(t, lo, hi) == m - k);
+    memcpy(arr, rest, k * sizeof(key_t));
+    m = k;
+    check_tree_keys(t, arr, m);
+
+    // expire a prefix every few rounds
+    if (round % 4 == 3) {
+      key_t cut = arr[m / 10];
+      size_t first = 0;
+      while (first < m && arr[first] < cut) {
+        first++;
+      }
+      assert(rbtree_truncate_below(t, cut) == first);
+      memmove(arr, arr + first, (m - first) * sizeof(key_t));
+      m -= first;
+      check_tree_keys(t, arr, m);
+    }
+  }
+
+  // the tree keeps working after bulk removal, and removing all empties it
+  for (size_t i = 0; i < 100; i++) {
+    arr[m++] = rand() % range;
+    rbtree_insert(t, arr[m - 1]);
+  }
+  qsort((void *)arr, m, sizeof(key_t), comp);
+  check_tree_keys(t, arr, m);
+  assert(rbtree_erase_range(t, arr[0], arr[m - 1] + 1) == m);
+  assert(t->root == t->nil && rbtree_min(t) == NULL);
+  free(rest);
+  free(arr);
+  delete_rbtree(t);
+}
+
+// a counted multiset should hold one node per distinct key and agree with
+// a plain rbtree holding every copy
+void test_counted(const size_t n, const key_t range, const unsigned int seed) {
+  rbtree_counted *c = new_rbtree_counted();
+  rbtree *t = new_rbtree();
+  key_t key;
+  assert(c != NULL && rbtree_counted_size(c) == 0);
+  assert(rbtree_counted_min(c, &key) == 0 && rbtree_counted_max(c, &key) == 0);
+  assert(rbtree_counted_erase(c, 1) == -1);
+
+  // skewed keys: small values repeat far more often
+  srand(seed);
+  for (size_t i = 0; i < n; i++) {
+    key_t k = (key_t)((long long)(rand() % range) * (rand() % range) / range);
+    assert(rbtree_counted_insert(c, k) == 0);
+    rbtree_insert(t, k);
+  }
+  assert(rbtree_counted_insert_n(c, range, 1000) == 0);
+  assert(rbtree_counted_insert_n(c, range + 1, 0) == 0);
+  for (int i = 0; i < 1000; i++) {
+    rbtree_insert(t, range);
+  }
+
+  const size_t total = n + 1000;
+  key_t *expected = calloc(total, sizeof(key_t));
+  key_t *res = calloc(total + 1, sizeof(key_t));
+  size_t distinct = 0;
+  assert(rbtree_to_array(t, expected, total) == total);
+  for (size_t i = 0; i < total; i++) {
+    distinct += i == 0 || expected[i] != expected[i - 1];
+  }
+  assert(rbtree_counted_size(c) == total);
+  assert(rbtree_counted_distinct(c) == distinct);
+  assert(distinct < total / 4);
+  assert(rbtree_counted_to_array(c, res, total + 1) == total);
+  assert(memcmp(res, expected, total * sizeof(key_t)) == 0);
+  assert(rbtree_counted_to_array(c, res, 10) == 10);
+  assert(rbtree_counted_min(c, &key) == 1 && key == expected[0]);
+  assert(rbtree_counted_max(c, &key) == 1 && key == range);
+  for (key_t k = -1; k <= range + 1; k++) {
+    assert(rbtree_counted_count(c, k) == rbtree_count(t, k));
+  }
+
+  // erase decrements, and the node goes away with the last copy
+  for (size_t i = 0; i < n; i += 2) {
+    key_t k = expected[i];
+    assert(rbtree_counted_erase(c, k) == 0);
+    rbtree_erase(t, rbtree_find(t, k));
+  }
+  assert(rbtree_counted_erase_all(c, range) == 1000);
+  assert(rbtree_counted_erase_all(c, range) == 0);
+  assert(rbtree_counted_erase(c, range) == -1);
+  while (rbtree_find(t, range) != NULL) {
+    rbtree_erase(t, rbtree_find(t, range));
+  }
+  size_t m = rbtree_to_array(t, expected, total);
+  assert(rbtree_counted_size(c) == m);
+  assert(rbtree_counted_to_array(c, res, total) == m);
+  assert(memcmp(res, expected, m * sizeof(key_t)) == 0);
+  distinct = 0;
+  for (size_t i = 0; i < m; i++) {
+    distinct += i == 0 || expected[i] != expected[i - 1];
+  }
+  assert(rbtree_counted_distinct(c) == distinct);
+
+  free(res);
+  free(expected);
+  delete_rbtree(t);
+  delete_rbtree_counted(c);
+}
+
+// trees sharing one node pool should keep their contents separate
+// and the pool should outlive the caller's reference
+void test_shared_pool() {
+  node_pool_t *pool = new_node_pool(4);
+  assert(pool != NULL);
+  rbtree *t1 = new_rbtree_with_allocator(pool);
+  rbtree *t2 = new_rbtree_with_allocator(pool);
+  assert(t1 != NULL && t2 != NULL);
+  delete_node_pool(pool);
+
+  const key_t arr[] = {10, 5, 8, 34, 67, 23, 156, 24, 2, 12, 24, 36, 990, 25};
+  const size_t n = sizeof(arr) / sizeof(arr[0]);
+  test_find_erase(t1, arr, n);
+  insert_arr(t1, arr, n);
+  insert_arr(t2, arr, n);
+  test_color_constraint(t1);
+  test_search_constraint(t2);
+
+  delete_rbtree(t1);
+  for (size_t i = 0; i < n; i++) {
+    node_t *p = rbtree_find(t2, arr[i]);
+    assert(p != NULL);
+    assert(p->key == arr[i]);
+  }
+  delete_rbtree(t2);
+}
+
+int main(void) {
+  test_init();
+  test_insert_single(1024);
+  test_find_single(512, 1024);
+  test_erase_root(128);
+  test_find_erase_fixed();
+  test_minmax_suite();
+  test_pop_minmax(1, 10, 163);
+  test_pop_minmax(5000, 100, 167);
+  test_pop_minmax(5000, 1000000, 173);
+  test_insert_hint(3000, 50, 179);
+  test_insert_hint(3000, 1000000, 181);
+  test_erase_range(1, 10, 191);
+  test_erase_range(5000, 200, 193);
+  test_erase_range(20000, 1000000, 197);
+  test_to_array_suite();
+  test_to_array_bounded();
+  test_iterator_suite();
+#if RBTREE_ORDER_STATS
+  test_order_statistics(2000, 50, 11);
+  test_order_statistics(2000, 100000, 13);
+#endif
+#if RBTREE_STATS
+  test_stats(5000);
+#endif
   test_distinct_values();
   test_duplicate_values();
   test_multi_instance();
   test_find_erase_rand(10000, 17);
+  test_shared_pool();
+  test_intrusive(5000);
+  test_from_sorted_array_suite();
+  test_insert_batch_suite();
+  test_generic_u64(5000);
+  test_generic_str();
+  test_counted(1, 10, 199);
+  test_counted(20000, 100, 211);
+  test_counted(20000, 5000, 223);
+  test_compact(5000, 100000, 19);
+  test_compact(5000, 40, 23);
+  test_compact_mmap(0, 10, 131);
+  test_compact_mmap(1, 10, 137);
+  test_compact_mmap(20000, 100000, 139);
+  test_frozen_suite();
+  test_find_many_suite();
+  test_concurrent();
+  test_sharded(0, 100, 43);
+  test_sharded(100, 1000, 47);
+  test_sharded(20000, 100000, 53);
+  test_sharded(20000, 50, 59);
+  test_sharded_threads();
+  test_persistent(0, 10, 61);
+  test_persistent(200, 50, 67);
+  test_persistent(20000, 100000, 71);
+  test_persistent_threads();
+  test_set_ops_suite();
+  test_wal();
   printf("Passed all tests!\n");
 }